@@ -0,0 +1,261 @@
+#include "../src/common/config.h"
+#include "../src/compiler/bytecode/bytecode_generator.h"
+#include "../src/compiler/bytecode/peephole_optimization.h"
+#include "../src/compiler/compiler.h"
+#include "../src/compiler/ir/cfg.h"
+#include "../src/compiler/ir/ir_generator.h"
+#include "../src/compiler/parser.h"
+#include "../src/core/vm_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Usage: cyx2_bench [benchmark name]...
+// runs every benchmark if no name is given.
+
+class CYXBench
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    // run `func` `rounds` times, report the median in microseconds.
+    static double measure(int rounds, const std::function<void()> &func)
+    {
+        std::vector<double> samples;
+        for (int i = 0; i < rounds; i++)
+        {
+            auto start = Clock::now();
+            func();
+            samples.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        }
+        std::sort(samples.begin(), samples.end());
+        return samples[samples.size() / 2];
+    }
+
+    // same as above, `setup` runs before each round and isn't timed.
+    static double measure(int rounds, const std::function<void()> &setup, const std::function<void()> &func)
+    {
+        std::vector<double> samples;
+        for (int i = 0; i < rounds; i++)
+        {
+            setup();
+            auto start = Clock::now();
+            func();
+            samples.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        }
+        std::sort(samples.begin(), samples.end());
+        return samples[samples.size() / 2];
+    }
+
+    static void report(const std::string &name, const std::string &param, double us)
+    {
+        std::cout << std::left << std::setw(24) << name << std::setw(20) << param << std::right << std::setw(14)
+                  << std::fixed << std::setprecision(1) << us << " us\n";
+    }
+
+    // a single function whose body repeats if / while / nested loop shapes `n` times,
+    // roughly 8 basic blocks per repetition.
+    static std::string branchySource(int n)
+    {
+        std::string src = "def main() {\n    a = 0;\n";
+        for (int i = 0; i < n; i++)
+        {
+            src += "    for (i = 0; i < 10; i++) {\n"
+                   "        if (a > i) { a = a + 1; } else { a = a - 1; }\n"
+                   "        while (a > 100) { a = a - 3; }\n"
+                   "    }\n";
+        }
+        return src + "    println(a);\n}\n";
+    }
+
+    // a long generated function, every statement comes with a comment line
+    static std::string generatedSource(int n)
+    {
+        std::string src = "def main() {\n    total = 0;\n";
+        for (int i = 0; i < n; i++)
+        {
+            src += "        // generated entry " + std::to_string(i) + " of the table\n" +
+                   "        total = total + element_value_" + std::to_string(i) + ";\n";
+        }
+        return src + "    println(total);\n}\n";
+    }
+
+    static std::vector<COMPILER::IRFunction *> buildIR(const std::string &src)
+    {
+        COMPILER::Parser parser(src);
+        auto *ast = parser.parse();
+        auto *ir_generator = new COMPILER::IRGenerator;
+        ir_generator->visitTree(ast);
+        COMPILER::CFG cfg;
+        cfg.funcs = ir_generator->funcs;
+        cfg.simplifyCFG();
+        return cfg.funcs;
+    }
+};
+
+static void benchDominator()
+{
+    for (int n : { 100, 1000, 4000 })
+    {
+        auto funcs = CYXBench::buildIR(CYXBench::branchySource(n));
+        COMPILER::CFG cfg;
+        cfg.funcs = funcs;
+        int blocks = 0;
+        for (auto *func : funcs)
+        {
+            blocks += func->blocks.size();
+        }
+        double us = CYXBench::measure(9, [&] {
+            for (auto *func : funcs)
+            {
+                cfg.buildDominateTree(func);
+            }
+        });
+        CYXBench::report("dominator", std::to_string(blocks) + " blocks", us);
+    }
+}
+
+static void benchPeephole()
+{
+    for (int n : { 100, 1000, 4000 })
+    {
+        auto funcs = CYXBench::buildIR(CYXBench::branchySource(n));
+        COMPILER::BasicBlock global_vars("global_var_decl");
+        std::unique_ptr<COMPILER::BytecodeGenerator> generator;
+        // the generator doesn't own its blocks, a program takes their instructions over
+        auto release = [&generator] {
+            if (generator == nullptr) return;
+            for (auto *block : generator->bytecode_basicblocks)
+            {
+                for (auto *inst : block->vm_insts)
+                {
+                    delete inst;
+                }
+                delete block;
+            }
+            generator.reset();
+        };
+        int insts = 0;
+        double us = CYXBench::measure(
+            5,
+            [&] {
+                release();
+                generator              = std::make_unique<COMPILER::BytecodeGenerator>();
+                generator->funcs       = funcs;
+                generator->global_vars = &global_vars;
+                generator->ir2VmInst();
+                insts = 0;
+                for (auto *block : generator->bytecode_basicblocks)
+                {
+                    insts += block->vm_insts.size();
+                }
+            },
+            [&] {
+                COMPILER::PeepholeOptimization peephole;
+                peephole.block_list = &generator->bytecode_basicblocks;
+                peephole.doPeepholeOptimization();
+            });
+        // baseline: touch every instruction once, the passes scale with this rather than with
+        // anything quadratic, past a few 10k instructions both are bound by cache misses.
+        volatile long sink = 0;
+        double walk_us     = CYXBench::measure(5, [&] {
+            long sum = 0;
+            for (auto *block : generator->bytecode_basicblocks)
+            {
+                for (auto *inst : block->vm_insts)
+                {
+                    sum += static_cast<int>(inst->opcode);
+                }
+            }
+            sink = sum;
+        });
+        release();
+        CYXBench::report("peephole", std::to_string(insts) + " insts", us);
+        CYXBench::report("peephole walk", std::to_string(insts) + " insts", walk_us);
+    }
+}
+
+static void benchLexer()
+{
+    for (int n : { 10000, 100000, 400000 })
+    {
+        const std::string src = CYXBench::generatedSource(n);
+        double us             = CYXBench::measure(5, [&] {
+            COMPILER::Lexer lexer(src);
+            while (lexer.nextToken().keyword != COMPILER::Keyword::INVALID)
+            {
+            }
+        });
+        CYXBench::report("lexer", std::to_string(src.size() / 1024) + " KiB", us);
+    }
+}
+
+static void benchParser()
+{
+    for (int n : { 1000, 10000, 40000 })
+    {
+        const std::string src = CYXBench::branchySource(n);
+        double us             = CYXBench::measure(5, [&] {
+            COMPILER::Parser parser(src);
+            parser.parse();
+        });
+        CYXBench::report("parser", std::to_string(src.size() / 1024) + " KiB", us);
+    }
+}
+
+static void benchPool()
+{
+    // many short independent calls, from 1 worker up to one per core
+    const std::string src = "def job(n) {\n"
+                            "    s = 0\n"
+                            "    for (i = 0; i < n; i++) { s = s + i }\n"
+                            "    return s\n"
+                            "}\n"
+                            "def main() { println(job(10)) }\n";
+    auto program          = COMPILER::Compiler::compile(src, CompileOptions());
+    const int jobs        = 20000;
+    const int cores       = std::max(1u, std::thread::hardware_concurrency());
+    for (int workers = 1;; workers = std::min(workers * 2, cores))
+    {
+        CVM::VMPool pool(workers);
+        double us = CYXBench::measure(5, [&] {
+            std::vector<std::future<CYX::Value>> results;
+            results.reserve(jobs);
+            for (int i = 0; i < jobs; i++)
+            {
+                results.push_back(pool.submit(program, "job", { CYX::Value(10) }));
+            }
+            for (auto &result : results)
+            {
+                result.get();
+            }
+        });
+        CYXBench::report("pool", std::to_string(workers) + " workers", us);
+        if (workers == cores) break;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const std::vector<std::pair<std::string, std::function<void()>>> benches = {
+        { "dominator", benchDominator }, //
+        { "peephole", benchPeephole },   //
+        { "lexer", benchLexer },         //
+        { "parser", benchParser },       //
+        { "pool", benchPool },           //
+    };
+    std::vector<std::string> selected(argv + 1, argv + argc);
+    for (const auto &[name, func] : benches)
+    {
+        if (selected.empty() || std::find(selected.begin(), selected.end(), name) != selected.end()) func();
+    }
+    return 0;
+}
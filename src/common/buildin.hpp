@@ -59,6 +59,24 @@ static CYX::Value *buildin_len(CYX::Value *target)
     return new CYX::Value(size);
 }
 
+// `yield a` stops the VM and hands `a` to the host, `VM::callBuildin()` does that itself
+static CYX::Value *buildin_yield(CYX::Value *target)
+{
+    return nullptr;
+}
+
+// `parallel_map("f", arr)` calls `f` on every element of `arr` on several threads and returns the results in an
+// array, `VM::parallelMap()` does that
+static CYX::Value *buildin_parallel_map(CYX::Value *target)
+{
+    return nullptr;
+}
+
+// the VM runs these itself, `read()` and `yield` may suspend it
+static constexpr int BUILDIN_READ         = 3;
+static constexpr int BUILDIN_YIELD        = 8;
+static constexpr int BUILDIN_PARALLEL_MAP = 9;
+
 #define BUILDIN_NAME(IDX, X)                                                                                           \
     {                                                                                                                  \
         #X,                                                                                                            \
@@ -73,23 +91,27 @@ static CYX::Value *buildin_len(CYX::Value *target)
     }
 
 static const std::unordered_map<std::string, std::pair<CYX::Value *(*) (CYX::Value *), int>> buildin_functions = {
-    BUILDIN_NAME(1, buildin_print),   //
-    BUILDIN_NAME(2, buildin_println), //
-    BUILDIN_NAME(3, buildin_read),    //
-    BUILDIN_NAME(4, buildin_int),     //
-    BUILDIN_NAME(5, buildin_double),  //
-    BUILDIN_NAME(6, buildin_string),  //
-    BUILDIN_NAME(7, buildin_len),     //
+    BUILDIN_NAME(1, buildin_print),                           //
+    BUILDIN_NAME(2, buildin_println),                         //
+    BUILDIN_NAME(BUILDIN_READ, buildin_read),                 //
+    BUILDIN_NAME(4, buildin_int),                             //
+    BUILDIN_NAME(5, buildin_double),                          //
+    BUILDIN_NAME(6, buildin_string),                          //
+    BUILDIN_NAME(7, buildin_len),                             //
+    BUILDIN_NAME(BUILDIN_YIELD, buildin_yield),               //
+    BUILDIN_NAME(BUILDIN_PARALLEL_MAP, buildin_parallel_map), //
 };
 
 static const std::unordered_map<int, CYX::Value *(*) (CYX::Value *)> buildin_functions_index = {
-    BUILDIN_IDX(1, buildin_print),   //
-    BUILDIN_IDX(2, buildin_println), //
-    BUILDIN_IDX(3, buildin_read),    //
-    BUILDIN_IDX(4, buildin_int),     //
-    BUILDIN_IDX(5, buildin_double),  //
-    BUILDIN_IDX(6, buildin_string),  //
-    BUILDIN_IDX(7, buildin_len),     //
+    BUILDIN_IDX(1, buildin_print),                           //
+    BUILDIN_IDX(2, buildin_println),                         //
+    BUILDIN_IDX(BUILDIN_READ, buildin_read),                 //
+    BUILDIN_IDX(4, buildin_int),                             //
+    BUILDIN_IDX(5, buildin_double),                          //
+    BUILDIN_IDX(6, buildin_string),                          //
+    BUILDIN_IDX(7, buildin_len),                             //
+    BUILDIN_IDX(BUILDIN_YIELD, buildin_yield),               //
+    BUILDIN_IDX(BUILDIN_PARALLEL_MAP, buildin_parallel_map), //
 };
 
 #undef BUILDIN_IDX
@@ -4,20 +4,33 @@
 #include <string>
 
 extern const std::string ENTRY_FUNC;
-extern bool NO_SSA;
-extern bool NO_CODE_SIMPLIFY;
-extern bool NO_CFG_SIMPLIFY;
-extern bool CONSTANT_FOLDING;
-extern bool CONSTANT_PROPAGATION;
-extern bool REMOVE_UNUSED_DEFINE;
-extern bool DEAD_CODE_ELIMINATION;
-extern bool PEEPHOLE;
 //
 extern const int STATE_REGISTER;
-// debug output
-extern bool DUMP_AST_STR;
-extern bool DUMP_CFG_STR;
-extern bool DUMP_IR_STR;
-extern bool DUMP_VM_INST_STR;
+
+// The switches of one compilation. Every compiler stage keeps a copy of its own, so compilations with different
+// options can run on several threads at the same time.
+struct CompileOptions
+{
+    bool ssa{ false };
+    bool pruned_ssa{ false };
+    bool no_code_simplify{ false };
+    bool no_cfg_simplify{ false };
+    bool inline_function{ false };
+    bool ipcp{ false };
+    bool memoize{ false };
+    bool constant_folding{ false };
+    bool constant_propagation{ false };
+    bool sccp{ false };
+    bool gvn{ false };
+    bool licm{ false };
+    bool induction_variable{ false };
+    bool remove_unused_define{ false };
+    bool dead_code_elimination{ false };
+    bool dead_store_elimination{ false };
+    bool peephole{ false };
+    bool superinstruction{ false };
+    bool block_layout{ false };
+    int jobs{ 1 }; // threads for SSA construction and bytecode emission
+};
 
 #endif // CVM_CONFIG_H
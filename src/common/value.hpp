@@ -355,6 +355,23 @@ namespace CYX
         {
             _value = std::monostate();
         }
+        // appends an exact encoding of a scalar to `key`, arrays and empty values have none
+        bool appendKey(std::string &key)
+        {
+            if (is<long long>())
+                key += "i" + std::to_string(value<long long>());
+            else if (is<double>())
+            {
+                const double bits = value<double>();
+                key += "d";
+                key.append(reinterpret_cast<const char *>(&bits), sizeof(bits));
+            }
+            else if (is<std::string>())
+                key += "s" + std::to_string(valuePtr<std::string>()->size()) + ":" + *valuePtr<std::string>();
+            else
+                return false;
+            return true;
+        }
 
       private:
         std::string asString()
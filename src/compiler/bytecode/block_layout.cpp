@@ -0,0 +1,161 @@
+#include "block_layout.h"
+
+void COMPILER::BlockLayout::layoutBlocks()
+{
+    auto isFunc = [](BytecodeBasicBlock *block)
+    { return !block->vm_insts.empty() && block->vm_insts.front()->opcode == CVM::Opcode::FUNC; };
+    // the first block declares global variables, every function starts with a `FUNC` block
+    int begin = 1;
+    while (begin < block_list->size())
+    {
+        int end = begin + 1;
+        while (end < block_list->size() && !isFunc((*block_list)[end]))
+        {
+            end++;
+        }
+        rotateLoops(begin, end);
+        chainBlocks(begin, end);
+        begin = end;
+    }
+}
+
+void COMPILER::BlockLayout::rotateLoops(int begin, int end)
+{
+    // 3 LT %1 %2      (header)
+    // 4 JIF 5 9
+    // ...
+    // 8 JMP 3         -> LT %1 %2
+    //                    JIF 5 9
+    block_pos.clear();
+    for (int i = begin; i < end; i++)
+    {
+        block_pos[(*block_list)[i]->name] = i;
+    }
+    for (int i = begin; i < end; i++)
+    {
+        auto &insts = (*block_list)[i]->vm_insts;
+        if (insts.empty() || insts.back()->opcode != CVM::Opcode::JMP) continue;
+        // back edges only, a forward jump is dropped by `chainBlocks()` if its target can follow it
+        auto it = block_pos.find(static_cast<CVM::Jmp *>(insts.back())->basic_block_name);
+        if (it == block_pos.end() || it->second >= i) continue;
+        const auto &header = (*block_list)[it->second]->vm_insts;
+        if (header.empty() || header.size() > ROTATE_LIMIT || header.back()->opcode != CVM::Opcode::JIF) continue;
+
+        std::vector<CVM::VMInstruction *> copy;
+        for (auto *inst : header)
+        {
+            auto *clone = cloneInst(inst);
+            if (clone == nullptr) break;
+            copy.push_back(clone);
+        }
+        if (copy.size() != header.size())
+        {
+            for (auto *inst : copy)
+            {
+                delete inst;
+            }
+            continue;
+        }
+        delete insts.back();
+        insts.pop_back();
+        insts.insert(insts.end(), copy.begin(), copy.end());
+    }
+}
+
+void COMPILER::BlockLayout::chainBlocks(int begin, int end)
+{
+    // blocks linked by falling through stay together
+    std::vector<std::vector<BytecodeBasicBlock *>> chains;
+    std::unordered_map<std::string, int> chain_of; // first block of a chain -> chain
+    for (int i = begin; i < end; i++)
+    {
+        auto *block = (*block_list)[i];
+        if (i == begin || !fallsThrough((*block_list)[i - 1]))
+        {
+            chain_of[block->name] = chains.size();
+            chains.emplace_back();
+        }
+        chains.back().push_back(block);
+    }
+
+    // the first chain starts with `FUNC`, the last one ends the function and stays at the end.
+    // a chain is followed by the chain its jump goes to if that one isn't placed yet, else by the next one in order.
+    const int last = chains.size() - 1;
+    std::vector<bool> placed(chains.size(), false);
+    auto placeable = [&chain_of, &placed, last](const std::string &name)
+    {
+        auto it = chain_of.find(name);
+        return it != chain_of.end() && !placed[it->second] && it->second != last ? it->second : -1;
+    };
+    std::vector<BytecodeBasicBlock *> order;
+    int scan = 1;
+    for (int cur = 0; cur != -1;)
+    {
+        placed[cur] = true;
+        order.insert(order.end(), chains[cur].begin(), chains[cur].end());
+        auto &insts = chains[cur].back()->vm_insts;
+        int next    = -1;
+        if (!insts.empty() && insts.back()->opcode == CVM::Opcode::JMP)
+        {
+            next = placeable(static_cast<CVM::Jmp *>(insts.back())->basic_block_name);
+        }
+        else if (!insts.empty() && insts.back()->opcode == CVM::Opcode::JIF)
+        {
+            // the true side of a loop condition is the body, it ends with the rotated condition again
+            next = placeable(static_cast<CVM::Jif *>(insts.back())->basic_block_name1);
+            if (next == -1) next = placeable(static_cast<CVM::Jif *>(insts.back())->basic_block_name2);
+        }
+        while (scan < chains.size() && (placed[scan] || scan == last))
+        {
+            scan++;
+        }
+        if (next == -1 && scan < chains.size()) next = scan;
+        if (next == -1 && !placed[last]) next = last;
+        cur = next;
+    }
+    std::copy(order.begin(), order.end(), block_list->begin() + begin);
+
+    // a jump to the next block
+    for (int i = 0; i + 1 < order.size(); i++)
+    {
+        auto &insts = order[i]->vm_insts;
+        if (insts.empty() || insts.back()->opcode != CVM::Opcode::JMP ||
+            static_cast<CVM::Jmp *>(insts.back())->basic_block_name != order[i + 1]->name)
+            continue;
+        delete insts.back();
+        insts.pop_back();
+    }
+}
+
+bool COMPILER::BlockLayout::fallsThrough(COMPILER::BytecodeBasicBlock *block)
+{
+    return block->vm_insts.empty() ||
+           !inOr(block->vm_insts.back()->opcode, CVM::Opcode::JMP, CVM::Opcode::JIF, CVM::Opcode::JTABLE,
+                 CVM::Opcode::JLOOKUP, CVM::Opcode::RET);
+}
+
+CVM::VMInstruction *COMPILER::BlockLayout::cloneInst(CVM::VMInstruction *inst)
+{
+    switch (inst->opcode)
+    {
+        case CVM::Opcode::LOADI: return new CVM::LoadI(*static_cast<CVM::LoadI *>(inst));
+        case CVM::Opcode::LOADD: return new CVM::LoadD(*static_cast<CVM::LoadD *>(inst));
+        case CVM::Opcode::LOADS: return new CVM::LoadS(*static_cast<CVM::LoadS *>(inst));
+        case CVM::Opcode::LOADX: return new CVM::LoadX(*static_cast<CVM::LoadX *>(inst));
+        case CVM::Opcode::LOADXU: return new CVM::LoadXU(*static_cast<CVM::LoadXU *>(inst));
+        case CVM::Opcode::STOREX: return new CVM::StoreX(*static_cast<CVM::StoreX *>(inst));
+        case CVM::Opcode::STOREXU: return new CVM::StoreXU(*static_cast<CVM::StoreXU *>(inst));
+        case CVM::Opcode::ADDI: return new CVM::AddI(*static_cast<CVM::AddI *>(inst));
+        case CVM::Opcode::BINXX:
+        case CVM::Opcode::BINXI: return new CVM::BinaryX(*static_cast<CVM::BinaryX *>(inst));
+        case CVM::Opcode::JIF: return new CVM::Jif(*static_cast<CVM::Jif *>(inst));
+        default:
+        {
+            auto *binary = CVM::newBinary(inst->opcode);
+            if (binary == nullptr) return nullptr;
+            binary->reg_idx1 = static_cast<CVM::Binary *>(inst)->reg_idx1;
+            binary->reg_idx2 = static_cast<CVM::Binary *>(inst)->reg_idx2;
+            return binary;
+        }
+    }
+}
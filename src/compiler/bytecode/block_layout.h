@@ -0,0 +1,41 @@
+#ifndef CVM_BLOCK_LAYOUT_H
+#define CVM_BLOCK_LAYOUT_H
+
+#include "../../core/vm_instruction.hpp"
+#include "../../utility/utility.hpp"
+#include "bytecode_basicblock.hpp"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace COMPILER
+{
+    // Orders the bytecode blocks of every function before `BytecodeGenerator::relocation()`.
+    // A `JMP` back to a small loop header becomes a copy of the header (loop rotation), so a loop runs one
+    // `JIF` per iteration instead of a `JIF` and a `JMP`. Then the blocks are chained so that a `JMP` goes to
+    // the block right after it as often as possible, and those jumps are dropped.
+    class BlockLayout
+    {
+      public:
+        void layoutBlocks();
+
+      public:
+        std::vector<BytecodeBasicBlock *> *block_list;
+
+      private:
+        void rotateLoops(int begin, int end);
+        void chainBlocks(int begin, int end);
+        // the block after it runs next, unless it ends with a jump or return
+        static bool fallsThrough(BytecodeBasicBlock *block);
+        // nullptr if the instruction can't be copied
+        static CVM::VMInstruction *cloneInst(CVM::VMInstruction *inst);
+
+      private:
+        // a header is copied if it is at most this many instructions
+        static constexpr int ROTATE_LIMIT = 8;
+        std::unordered_map<std::string, int> block_pos;
+    };
+} // namespace COMPILER
+
+#endif // CVM_BLOCK_LAYOUT_H
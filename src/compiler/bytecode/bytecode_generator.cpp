@@ -21,57 +21,101 @@ void COMPILER::BytecodeGenerator::ir2VmInst()
     global_var_len = bytecode_basicblocks.back()->vm_insts.size();
     for (auto *func : funcs)
     {
-        bytecode_basicblocks.push_back(new BytecodeBasicBlock(func->name));
-        block_table.clear();
-        genFunc(func);
-        for (auto *block : func->blocks)
+        if (func->name == ENTRY_FUNC) entry_end_block_name = func->blocks.back()->name;
+    }
+    if (options.jobs <= 1 || funcs.size() <= 1)
+    {
+        for (auto *func : funcs)
+        {
+            genFuncBody(func);
+        }
+        return;
+    }
+    // every worker emits into its own blocks, they are appended in function order afterwards
+    ThreadPool pool(options.jobs);
+    std::vector<BytecodeGenerator> workers(pool.size());
+    std::vector<std::vector<BytecodeBasicBlock *>> emitted(funcs.size());
+    pool.parallelFor(funcs.size(),
+                     [this, &workers, &emitted](int i, int worker)
+                     {
+                         workers[worker].genFuncBody(funcs[i]);
+                         emitted[i].swap(workers[worker].bytecode_basicblocks);
+                     });
+    for (auto &blocks : emitted)
+    {
+        bytecode_basicblocks.insert(bytecode_basicblocks.end(), blocks.begin(), blocks.end());
+    }
+}
+
+void COMPILER::BytecodeGenerator::genFuncBody(COMPILER::IRFunction *func)
+{
+    bytecode_basicblocks.push_back(new BytecodeBasicBlock(func->name));
+    genFunc(func);
+    for (auto *block : func->blocks)
+    {
+        bytecode_basicblocks.push_back(new BytecodeBasicBlock(block->name));
+        for (auto *inst : block->insts)
         {
-            bytecode_basicblocks.push_back(new BytecodeBasicBlock(block->name));
-            for (auto *inst : block->insts)
+            if (auto *ptr = as<IRAssign, IR::Tag::ASSIGN>(inst); ptr != nullptr)
             {
-                if (auto *ptr = as<IRAssign, IR::Tag::ASSIGN>(inst); ptr != nullptr)
-                {
-                    genAssign(ptr);
-                }
-                else if (auto *ptr = as<IRBinary, IR::Tag::BINARY>(inst); ptr != nullptr)
-                {
-                    genBinary(ptr);
-                }
-                else if (auto *ptr = as<IRReturn, IR::Tag::RETURN>(inst); ptr != nullptr)
-                {
-                    genReturn(ptr);
-                }
-                else if (auto *ptr = as<IRJump, IR::Tag::JMP>(inst); ptr != nullptr)
-                {
-                    genJump(ptr);
-                }
-                else if (auto *ptr = as<IRCall, IR::Tag::CALL>(inst); ptr != nullptr)
-                {
-                    genCall(ptr);
-                }
-                else if (auto *ptr = as<IRBranch, IR::Tag::BRANCH>(inst); ptr != nullptr)
-                {
-                    genBranch(ptr);
-                }
-                else
-                {
-                    UNREACHABLE();
-                }
+                genAssign(ptr);
+            }
+            else if (auto *ptr = as<IRBinary, IR::Tag::BINARY>(inst); ptr != nullptr)
+            {
+                genBinary(ptr);
+            }
+            else if (auto *ptr = as<IRReturn, IR::Tag::RETURN>(inst); ptr != nullptr)
+            {
+                genReturn(ptr);
+            }
+            else if (auto *ptr = as<IRJump, IR::Tag::JMP>(inst); ptr != nullptr)
+            {
+                genJump(ptr);
+            }
+            else if (auto *ptr = as<IRCall, IR::Tag::CALL>(inst); ptr != nullptr)
+            {
+                genCall(ptr);
+            }
+            else if (auto *ptr = as<IRBranch, IR::Tag::BRANCH>(inst); ptr != nullptr)
+            {
+                genBranch(ptr);
+            }
+            else if (auto *ptr = as<IRSwitch, IR::Tag::SWITCH>(inst); ptr != nullptr)
+            {
+                genSwitch(ptr);
+            }
+            else
+            {
+                THROW("can't generate bytecode for `" + inst->toString() + "`");
             }
         }
-        if (func->name == ENTRY_FUNC) entry_end_block_name = func->blocks.back()->name;
     }
 }
 
 void COMPILER::BytecodeGenerator::genBinary(COMPILER::IRBinary *ptr)
 {
+    // i = i + 1, an integer induction variable
+    auto *step = as<IRConstant, IR::Tag::CONST>(ptr->rhs);
+    if (ptr->is_int && inOr(ptr->opcode, IROpcode::IR_ADD, IROpcode::IR_SUB) && step != nullptr &&
+        step->value.is<long long>() && as<IRVar, IR::Tag::VAR>(ptr->lhs) != nullptr)
+    {
+        auto *lhs = as<IRVar, IR::Tag::VAR>(ptr->lhs);
+        std::vector<CVM::ArrIdx> arr_idx;
+        parseVarArr(lhs, arr_idx);
+        genLoadX(1, lhs->ssaName(), arr_idx);
+        auto *inst    = new CVM::AddI;
+        inst->reg_idx = 1;
+        inst->val     = ptr->opcode == IROpcode::IR_ADD ? step->value.as<long long>() : -step->value.as<long long>();
+        addInst(inst);
+        return;
+    }
     // a = b + c
     // load b to register %?
     if (auto *lhs = as<IRVar, IR::Tag::VAR>(ptr->lhs); lhs != nullptr)
     {
         std::vector<CVM::ArrIdx> arr_idx;
         parseVarArr(lhs, arr_idx);
-        genLoadX(1, lhs->ssaName(), arr_idx);
+        genLoadX(1, lhs->ssaName(), arr_idx, lhs->in_bounds);
         // self add / sub
         if (ptr->rhs == nullptr) return;
     }
@@ -106,7 +150,7 @@ void COMPILER::BytecodeGenerator::genBinary(COMPILER::IRBinary *ptr)
         {
             std::vector<CVM::ArrIdx> arr_idx;
             parseVarArr(rhs, arr_idx);
-            genLoadX(2, rhs->ssaName(), arr_idx);
+            genLoadX(2, rhs->ssaName(), arr_idx, rhs->in_bounds);
         }
     }
     else if (auto *rhs = as<IRConstant, IR::Tag::CONST>(ptr->rhs); rhs != nullptr)
@@ -115,7 +159,7 @@ void COMPILER::BytecodeGenerator::genBinary(COMPILER::IRBinary *ptr)
     }
     else
     {
-        UNREACHABLE();
+        THROW("can't generate bytecode for `" + ptr->toString() + "`");
     }
     //
 #define CASE_OPCODE(VM_OPCODE, IR_OPCODE)                                                                              \
@@ -174,7 +218,7 @@ void COMPILER::BytecodeGenerator::genStoreConst(CYX::Value &val, const std::stri
     else if (val.is<std::string>())
         genStore(name, val.as<std::string>());
     else
-        UNREACHABLE();
+        THROW("can't store a constant of this type in `" + name + "`");
 }
 
 void COMPILER::BytecodeGenerator::genReturn(COMPILER::IRReturn *ptr)
@@ -248,9 +292,11 @@ void COMPILER::BytecodeGenerator::genCall(COMPILER::IRCall *ptr)
 
 void COMPILER::BytecodeGenerator::genFunc(COMPILER::IRFunction *ptr)
 {
-    auto *func_inst        = new CVM::Func();
-    func_inst->name        = ptr->name;
-    func_inst->param_count = ptr->params.size();
+    auto *func_inst           = new CVM::Func();
+    func_inst->name           = ptr->name;
+    func_inst->param_count    = ptr->params.size();
+    func_inst->memoize        = ptr->memoize;
+    func_inst->writes_globals = ptr->writes_globals;
     addInst(func_inst);
     // Param
     for (auto param : ptr->params)
@@ -267,6 +313,58 @@ void COMPILER::BytecodeGenerator::genBranch(COMPILER::IRBranch *ptr)
     genJif(ptr->true_block, ptr->false_block);
 }
 
+void COMPILER::BytecodeGenerator::genSwitch(COMPILER::IRSwitch *ptr)
+{
+    genLoadX(1, ptr->cond->ssaName());
+    std::vector<std::pair<long long, BasicBlock *>> int_cases;
+    std::vector<std::pair<std::string, BasicBlock *>> str_cases;
+    for (auto &[value, block] : ptr->cases)
+    {
+        if (value.is<long long>())
+            int_cases.emplace_back(value.value<long long>(), block);
+        else
+            str_cases.emplace_back(value.value<std::string>(), block);
+    }
+    std::sort(int_cases.begin(), int_cases.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+    // (1) => ..., (2) => ..., (4) => ...
+    // JTABLE %1 1 @case1 @case2 @out @case4 @out
+    if (str_cases.empty() && !int_cases.empty())
+    {
+        const auto span = static_cast<unsigned long long>(int_cases.back().first) - int_cases.front().first;
+        if (span < int_cases.size() * JTABLE_SLOTS_PER_CASE)
+        {
+            auto *inst    = new CVM::JTable;
+            inst->reg_idx = 1;
+            inst->base    = int_cases.front().first;
+            inst->basic_block_names.assign(span + 1, ptr->default_block->name);
+            for (auto &[key, block] : int_cases)
+            {
+                inst->basic_block_names[static_cast<unsigned long long>(key) - inst->base] = block->name;
+            }
+            inst->default_block_name = ptr->default_block->name;
+            addInst(inst);
+            return;
+        }
+    }
+    // (1) => ..., (1000) => ..., ("a") => ...
+    // JLOOKUP %1 1:@case1 1000:@case2 "a":@case3 @out
+    auto *inst    = new CVM::JLookup;
+    inst->reg_idx = 1;
+    for (auto &[key, block] : int_cases)
+    {
+        inst->int_keys.push_back(key);
+        inst->basic_block_names.push_back(block->name);
+    }
+    for (auto &[key, block] : str_cases)
+    {
+        inst->str_keys.push_back(key);
+        inst->basic_block_names.push_back(block->name);
+    }
+    inst->default_block_name = ptr->default_block->name;
+    inst->indexKeys();
+    addInst(inst);
+}
+
 void COMPILER::BytecodeGenerator::genAssign(COMPILER::IRAssign *ptr)
 {
     /*
@@ -277,7 +375,8 @@ void COMPILER::BytecodeGenerator::genAssign(COMPILER::IRAssign *ptr)
      * add 1 2
      * storex a 1
      * */
-    std::string lhs = ptr->dest()->ssaName();
+    std::string lhs      = ptr->dest()->ssaName();
+    const bool in_bounds = ptr->dest()->in_bounds;
 
     std::vector<CVM::ArrIdx> arr_idx;
     parseVarArr(ptr->dest(), arr_idx); // handle array index start
@@ -286,14 +385,14 @@ void COMPILER::BytecodeGenerator::genAssign(COMPILER::IRAssign *ptr)
         genBinary(binary);
         if (inOr(binary->opcode, IROpcode::IR_LE, IROpcode::IR_LT, IROpcode::IR_GE, IROpcode::IR_GT, IROpcode::IR_LAND,
                  IROpcode::IR_LOR, IROpcode::IR_EQ, IROpcode::IR_NE))
-            genStoreX(lhs, 0, arr_idx);
+            genStoreX(lhs, 0, arr_idx, in_bounds);
         else
-            genStoreX(lhs, 1, arr_idx);
+            genStoreX(lhs, 1, arr_idx, in_bounds);
     }
     else if (auto *constant = as<IRConstant, IR::Tag::CONST>(ptr->src()); constant != nullptr)
     {
         if (ptr->dest()->is_array)
-            genStoreA(lhs, constant->value, arr_idx);
+            genStoreA(lhs, constant->value, arr_idx, in_bounds);
         else
             genStoreConst(constant->value, lhs);
     }
@@ -302,8 +401,8 @@ void COMPILER::BytecodeGenerator::genAssign(COMPILER::IRAssign *ptr)
         std::vector<CVM::ArrIdx> src_idx;
         parseVarArr(var, src_idx);
 
-        genLoadX(1, var->ssaName(), src_idx);
-        genStoreX(lhs, 1, arr_idx);
+        genLoadX(1, var->ssaName(), src_idx, var->in_bounds);
+        genStoreX(lhs, 1, arr_idx, in_bounds);
     }
     else if (auto *arr = as<IRArray, IR::Tag::ARRAY>(ptr->src()); arr != nullptr)
     {
@@ -327,21 +426,21 @@ void COMPILER::BytecodeGenerator::genAssign(COMPILER::IRAssign *ptr)
             }
             else
             {
-                UNREACHABLE();
+                THROW("can't generate bytecode for the array element `" + arr->content[i]->toString() + "`");
             }
         }
         genLoadA(2, value);
         genLoadXA(2, idx);
-        genStoreX(lhs, 2, arr_idx);
+        genStoreX(lhs, 2, arr_idx, in_bounds);
     }
     else if (auto *call = as<IRCall, IR::Tag::CALL>(ptr->src()); call != nullptr)
     {
         genCall(call);
-        genStoreX(lhs, 1, arr_idx);
+        genStoreX(lhs, 1, arr_idx, in_bounds);
     }
     else
     {
-        UNREACHABLE();
+        THROW("can't generate bytecode for `" + ptr->toString() + "`");
     }
 }
 
@@ -371,7 +470,7 @@ void COMPILER::BytecodeGenerator::genLoad(int reg_idx, T val)
     }
     else
     {
-        UNREACHABLE();
+        THROW("can't load a constant of this type");
     }
 }
 
@@ -383,8 +482,18 @@ void COMPILER::BytecodeGenerator::genLoadX(int reg_idx, const std::string &name)
     addInst(load_x);
 }
 
-void COMPILER::BytecodeGenerator::genLoadX(int reg_idx, const std::string &name, const std::vector<CVM::ArrIdx> &idx)
+void COMPILER::BytecodeGenerator::genLoadX(int reg_idx, const std::string &name, const std::vector<CVM::ArrIdx> &idx,
+                                           bool in_bounds)
 {
+    if (in_bounds && !idx.empty())
+    {
+        auto *load_xu    = new CVM::LoadXU;
+        load_xu->name    = name;
+        load_xu->reg_idx = reg_idx;
+        load_xu->index   = idx;
+        addInst(load_xu);
+        return;
+    }
     genLoadX(reg_idx, name);
     if (idx.empty()) return;
     auto *inst  = static_cast<CVM::LoadX *>(bytecode_basicblocks.back()->vm_insts.back());
@@ -412,9 +521,9 @@ void COMPILER::BytecodeGenerator::genLoadA(int reg_idx, const std::vector<CYX::V
 }
 
 void COMPILER::BytecodeGenerator::genStoreA(const std::string &name, CYX::Value &val,
-                                            const std::vector<CVM::ArrIdx> &idx)
+                                            const std::vector<CVM::ArrIdx> &idx, bool in_bounds)
 {
-    auto *store_a  = new CVM::StoreA;
+    auto *store_a  = in_bounds ? new CVM::StoreAU : new CVM::StoreA;
     store_a->name  = name;
     store_a->value = val;
     store_a->index = idx;
@@ -447,7 +556,7 @@ void COMPILER::BytecodeGenerator::genStore(const std::string &name, T val)
     }
     else
     {
-        UNREACHABLE();
+        THROW("can't store a constant of this type in `" + name + "`");
     }
 }
 
@@ -459,8 +568,18 @@ void COMPILER::BytecodeGenerator::genStoreX(const std::string &name, int reg_idx
     addInst(store_x);
 }
 
-void COMPILER::BytecodeGenerator::genStoreX(const std::string &name, int reg_idx, const std::vector<CVM::ArrIdx> &idx)
+void COMPILER::BytecodeGenerator::genStoreX(const std::string &name, int reg_idx, const std::vector<CVM::ArrIdx> &idx,
+                                            bool in_bounds)
 {
+    if (in_bounds && !idx.empty())
+    {
+        auto *store_xu    = new CVM::StoreXU;
+        store_xu->name    = name;
+        store_xu->reg_idx = reg_idx;
+        store_xu->index   = idx;
+        addInst(store_xu);
+        return;
+    }
     genStoreX(name, reg_idx);
     if (idx.empty()) return;
     auto *inst  = static_cast<CVM::StoreX *>(bytecode_basicblocks.back()->vm_insts.back());
@@ -472,7 +591,12 @@ void COMPILER::BytecodeGenerator::collectBlockMap()
     int cnt = bytecode_basicblocks[0]->vm_insts.size();
     for (int i = 1; i < bytecode_basicblocks.size(); i++)
     {
-        if (bytecode_basicblocks[i]->vm_insts.empty()) continue;
+        // an empty block falls through, jumping to it means jumping to the next instruction
+        if (bytecode_basicblocks[i]->vm_insts.empty())
+        {
+            block_table[bytecode_basicblocks[i]->name] = cnt;
+            continue;
+        }
         bool is_func = bytecode_basicblocks[i]->vm_insts.front()->opcode == CVM::Opcode::FUNC;
         if (is_func)
             funcs_table[bytecode_basicblocks[i]->name] = cnt;
@@ -489,7 +613,9 @@ void COMPILER::BytecodeGenerator::fixJmp()
     {
         for (auto inst : bytecode_basicblocks[i]->vm_insts)
         {
-            if (!inOr(inst->opcode, CVM::Opcode::JMP, CVM::Opcode::JIF, CVM::Opcode::CALL)) continue;
+            if (!inOr(inst->opcode, CVM::Opcode::JMP, CVM::Opcode::JIF, CVM::Opcode::JTABLE, CVM::Opcode::JLOOKUP,
+                      CVM::Opcode::CALL))
+                continue;
             if (inst->opcode == CVM::Opcode::JMP)
             {
                 auto *tmp   = static_cast<CVM::Jmp *>(inst);
@@ -501,6 +627,26 @@ void COMPILER::BytecodeGenerator::fixJmp()
                 tmp->target1 = block_table[tmp->basic_block_name1];
                 tmp->target2 = block_table[tmp->basic_block_name2];
             }
+            else if (inst->opcode == CVM::Opcode::JTABLE)
+            {
+                auto *tmp = static_cast<CVM::JTable *>(inst);
+                tmp->targets.clear();
+                for (const auto &name : tmp->basic_block_names)
+                {
+                    tmp->targets.push_back(block_table[name]);
+                }
+                tmp->default_target = block_table[tmp->default_block_name];
+            }
+            else if (inst->opcode == CVM::Opcode::JLOOKUP)
+            {
+                auto *tmp = static_cast<CVM::JLookup *>(inst);
+                tmp->targets.clear();
+                for (const auto &name : tmp->basic_block_names)
+                {
+                    tmp->targets.push_back(block_table[name]);
+                }
+                tmp->default_target = block_table[tmp->default_block_name];
+            }
         }
     }
 }
@@ -568,7 +714,7 @@ void COMPILER::BytecodeGenerator::parseVarArr(COMPILER::IRVar *var, std::vector<
             arr_idx.emplace_back(idx_var->ssaName());
         }
         else
-            UNREACHABLE();
+            THROW("can't generate bytecode for the index `" + x->toString() + "`");
     }
 }
 
@@ -5,10 +5,12 @@
 #include "../../common/config.h"
 #include "../../core/opcode.hpp"
 #include "../../core/vm_instruction.hpp"
+#include "../../utility/thread_pool.hpp"
 #include "../../utility/utility.hpp"
 #include "../ir/ir_instruction.hpp"
 #include "bytecode_basicblock.hpp"
 
+#include <algorithm>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -38,21 +40,27 @@ namespace COMPILER
         void genJif(BasicBlock *target1, BasicBlock *target2);
         void genCall(IRCall *ptr);
         void genFunc(IRFunction *ptr);
+        // the blocks of a function, appended to `bytecode_basicblocks`
+        void genFuncBody(IRFunction *func);
         void genBranch(IRBranch *ptr);
+        void genSwitch(IRSwitch *ptr);
         void genAssign(IRAssign *ptr);
         //
         template<typename T>
         void genLoad(int reg_idx, T val);
         void genLoadX(int reg_idx, const std::string &name);
-        void genLoadX(int reg_idx, const std::string &name, const std::vector<CVM::ArrIdx> &idx);
+        void genLoadX(int reg_idx, const std::string &name, const std::vector<CVM::ArrIdx> &idx,
+                      bool in_bounds = false);
         void genLoadXA(int reg_idx, const std::vector<std::pair<std::string, int>> &idx);
         void genLoadA(int reg_idx, const std::vector<CYX::Value> &index);
         //
         template<typename T>
         void genStore(const std::string &name, T val);
-        void genStoreA(const std::string &name, CYX::Value &value, const std::vector<CVM::ArrIdx> &idx);
+        void genStoreA(const std::string &name, CYX::Value &value, const std::vector<CVM::ArrIdx> &idx,
+                       bool in_bounds = false);
         void genStoreX(const std::string &name, int reg_idx);
-        void genStoreX(const std::string &name, int reg_idx, const std::vector<CVM::ArrIdx> &idx);
+        void genStoreX(const std::string &name, int reg_idx, const std::vector<CVM::ArrIdx> &idx,
+                       bool in_bounds = false);
         //
         void parseVarArr(IRVar *var, std::vector<CVM::ArrIdx> &arr_idx);
         //
@@ -66,8 +74,11 @@ namespace COMPILER
         std::vector<CVM::VMInstruction *> vm_insts;
         std::vector<BytecodeBasicBlock *> bytecode_basicblocks;
         BasicBlock *global_vars{ nullptr };
+        CompileOptions options;
 
       private:
+        // int cases get a jump table if it has at most this many slots per case, they are looked up otherwise
+        static constexpr int JTABLE_SLOTS_PER_CASE = 2;
         std::string entry_end_block_name;
         std::unordered_map<std::string, int> block_table;
         std::unordered_map<std::string, int> funcs_table;
@@ -5,7 +5,8 @@ void COMPILER::BytecodeWriter::writeInsts()
     writeHeader();
     for (auto *inst : vm_insts)
     {
-        writeOpcode(inst->opcode);
+        // a file doesn't carry the proof of the compiler, `BytecodeReader` only takes checked array accesses
+        writeOpcode(CVM::checkedOpcode(inst->opcode));
         cur_inst = inst;
         switch (inst->opcode)
         {
@@ -38,9 +39,15 @@ void COMPILER::BytecodeWriter::writeInsts()
             case CVM::Opcode::STORED: writeStore<double>(); break;
             case CVM::Opcode::LOADS: writeLoad<std::string>(); break;
             case CVM::Opcode::STORES: writeStore<std::string>(); break;
-            case CVM::Opcode::STOREA: writeStoreA(); break;
-            case CVM::Opcode::LOADX: writeLoadX(); break;
-            case CVM::Opcode::STOREX: writeStoreX(); break;
+            case CVM::Opcode::STOREA:
+            case CVM::Opcode::STOREAU: writeStoreA(); break;
+            case CVM::Opcode::LOADX:
+            case CVM::Opcode::LOADXU: writeLoadX(); break;
+            case CVM::Opcode::STOREX:
+            case CVM::Opcode::STOREXU: writeStoreX(); break;
+            case CVM::Opcode::ADDI: writeAddI(); break;
+            case CVM::Opcode::BINXX:
+            case CVM::Opcode::BINXI: writeBinaryX(); break;
             case CVM::Opcode::CALL: writeCall(); break;
             case CVM::Opcode::FUNC: writeFunc(); break;
             case CVM::Opcode::ARG: writeArg(); break;
@@ -48,7 +55,9 @@ void COMPILER::BytecodeWriter::writeInsts()
             case CVM::Opcode::RET: writeRet(); break;
             case CVM::Opcode::JMP: writeJmp(); break;
             case CVM::Opcode::JIF: writeJif(); break;
-            default: CERR("unsupported instruction");
+            case CVM::Opcode::JTABLE: writeJTable(); break;
+            case CVM::Opcode::JLOOKUP: writeJLookup(); break;
+            default: THROW(std::string("can't write the instruction ") + CVM::opcode2Str(inst->opcode));
         }
     }
 }
@@ -56,10 +65,11 @@ void COMPILER::BytecodeWriter::writeInsts()
 void COMPILER::BytecodeWriter::writeHeader()
 {
     out.open(filename, std::ios::out | std::ios::binary);
+    if (!out.is_open()) THROW("can't open bytecode file `" + filename + "`");
     // magic number
     writeByte(0xc2);
     // version
-    writeByte(0x01);
+    writeByte(0x03);
     // entry point
     writeInt(entry);
     // main end
@@ -106,6 +116,27 @@ void COMPILER::BytecodeWriter::writeBinary()
     writeByte(tmp->reg_idx2);
 }
 
+void COMPILER::BytecodeWriter::writeAddI()
+{
+    auto *tmp = static_cast<CVM::AddI *>(cur_inst);
+    writeByte(tmp->reg_idx);
+    writeInt(tmp->val);
+}
+
+void COMPILER::BytecodeWriter::writeBinaryX()
+{
+    auto *tmp = static_cast<CVM::BinaryX *>(cur_inst);
+    writeOpcode(tmp->op);
+    writeByte(tmp->reg_idx1);
+    writeByte(tmp->reg_idx2);
+    writeString(tmp->lhs);
+    if (tmp->opcode == CVM::Opcode::BINXX)
+        writeString(tmp->rhs);
+    else
+        writeInt(tmp->val);
+    writeString(tmp->dest);
+}
+
 void COMPILER::BytecodeWriter::writeUnary()
 {
     auto *tmp = static_cast<CVM::Unary *>(cur_inst);
@@ -193,7 +224,7 @@ void COMPILER::BytecodeWriter::writeLoad()
         writeString(tmp->val);
     }
     else
-        UNREACHABLE();
+        THROW("can't write a constant of this type");
 }
 
 void COMPILER::BytecodeWriter::writeStoreX()
@@ -265,7 +296,7 @@ void COMPILER::BytecodeWriter::writeStore()
         writeString(tmp->val);
     }
     else
-        UNREACHABLE();
+        THROW("can't write a constant of this type");
 }
 
 void COMPILER::BytecodeWriter::writeArg()
@@ -310,6 +341,9 @@ void COMPILER::BytecodeWriter::writeFunc()
 {
     auto *tmp = static_cast<CVM::Func *>(cur_inst);
     writeByte(tmp->param_count); // argument count
+    writeByte(tmp->memoize);
+    // looked up by name by `parallel_map()` and the library
+    writeString(tmp->name);
 }
 
 void COMPILER::BytecodeWriter::writeParam()
@@ -336,6 +370,40 @@ void COMPILER::BytecodeWriter::writeJif()
     writeInt(tmp->target2);
 }
 
+void COMPILER::BytecodeWriter::writeJTable()
+{
+    auto *tmp = static_cast<CVM::JTable *>(cur_inst);
+    writeByte(tmp->reg_idx);
+    writeInt(tmp->base);
+    writeInt(tmp->targets.size());
+    for (auto target : tmp->targets)
+    {
+        writeInt(target);
+    }
+    writeInt(tmp->default_target);
+}
+
+void COMPILER::BytecodeWriter::writeJLookup()
+{
+    auto *tmp = static_cast<CVM::JLookup *>(cur_inst);
+    writeByte(tmp->reg_idx);
+    writeInt(tmp->int_keys.size());
+    for (auto key : tmp->int_keys)
+    {
+        writeInt(key);
+    }
+    writeInt(tmp->str_keys.size());
+    for (const auto &key : tmp->str_keys)
+    {
+        writeString(key);
+    }
+    for (auto target : tmp->targets)
+    {
+        writeInt(target);
+    }
+    writeInt(tmp->default_target);
+}
+
 void COMPILER::BytecodeWriter::writeIntTag()
 {
     writeByte(0);
@@ -29,6 +29,8 @@ namespace COMPILER
         void writeOpcode(CVM::Opcode opcode);
         //
         void writeBinary();
+        void writeAddI();
+        void writeBinaryX();
         //
         void writeLoadX();
         void writeLoadA();
@@ -48,6 +50,8 @@ namespace COMPILER
         void writeRet();
         void writeJmp();
         void writeJif();
+        void writeJTable();
+        void writeJLookup();
         //
         void writeIntTag();
         void writeDoubleTag();
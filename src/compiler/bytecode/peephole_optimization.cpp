@@ -1,224 +1,330 @@
 #include "peephole_optimization.h"
 
+static const std::vector<CVM::Opcode> BINARY_OPS = {
+    CVM::Opcode::ADD, CVM::Opcode::SUB, CVM::Opcode::MUL, CVM::Opcode::DIV, CVM::Opcode::MOD,
+    CVM::Opcode::EXP, CVM::Opcode::BAND, CVM::Opcode::BOR, CVM::Opcode::BXOR, CVM::Opcode::SHL,
+    CVM::Opcode::SHR, CVM::Opcode::LOR, CVM::Opcode::NE, CVM::Opcode::EQ, CVM::Opcode::LT,
+    CVM::Opcode::LE, CVM::Opcode::GT, CVM::Opcode::GE, CVM::Opcode::LAND,
+};
+
+static void removeBack(std::vector<CVM::VMInstruction *> &insts, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        delete insts.back();
+        insts.pop_back();
+    }
+}
+
+// storex a %1
+// loadx %1 a  (removed)
+static bool storeLoad(std::vector<CVM::VMInstruction *> &insts, int begin)
+{
+    auto *store = static_cast<CVM::StoreX *>(insts[begin]);
+    auto *load  = static_cast<CVM::LoadX *>(insts[begin + 1]);
+    if (store->name != load->name || store->reg_idx != load->reg_idx || !store->index.empty() ||
+        !load->index.empty())
+        return false;
+    removeBack(insts, 1);
+    return true;
+}
+
+// storex a %1
+// storex a %1 (removed)
+static bool storeStore(std::vector<CVM::VMInstruction *> &insts, int begin)
+{
+    auto *store  = static_cast<CVM::StoreX *>(insts[begin]);
+    auto *store2 = static_cast<CVM::StoreX *>(insts[begin + 1]);
+    if (store->name != store2->name || store->reg_idx != store2->reg_idx || !store->index.empty() ||
+        !store2->index.empty())
+        return false;
+    removeBack(insts, 1);
+    return true;
+}
+
+// LT %1 %2
+// STORE t0 %0 (removed, after `storeLoad` removed the LOAD %0 t0)
+// JIF ... ...
+static bool storeJif(std::vector<CVM::VMInstruction *> &insts, int begin)
+{
+    auto *store = static_cast<CVM::StoreX *>(insts[begin]);
+    if (store->reg_idx != 0 || !store->index.empty()) return false;
+    delete store;
+    insts.erase(insts.begin() + begin);
+    return true;
+}
+
+// jmp 666
+// jmp 777 (removed, nothing falls through to it)
+static bool jmpJmp(std::vector<CVM::VMInstruction *> &insts, int begin)
+{
+    removeBack(insts, 1);
+    return true;
+}
+
+// jif 666 666
+// becomes jmp 666
+static bool jifSame(std::vector<CVM::VMInstruction *> &insts, int begin)
+{
+    auto *jif = static_cast<CVM::Jif *>(insts[begin]);
+    if (jif->basic_block_name1 != jif->basic_block_name2) return false;
+    auto *jmp             = new CVM::Jmp;
+    jmp->basic_block_name = jif->basic_block_name1;
+    delete jif;
+    insts[begin] = jmp;
+    return true;
+}
+
+// LOADX %1 a
+// LOADX %2 b (or LOADI %2 1)
+// ADD %1 %2
+// becomes
+// BINXX ADD %1 a %2 b
+static bool binaryX(std::vector<CVM::VMInstruction *> &insts, int begin)
+{
+    auto *lhs = static_cast<CVM::LoadX *>(insts[begin]);
+    auto *op  = static_cast<CVM::Binary *>(insts[begin + 2]);
+    // element loads keep their own instruction, they may index by a variable
+    if (!lhs->index.empty() || op->reg_idx1 != lhs->reg_idx) return false;
+    auto *load = static_cast<CVM::Load *>(insts[begin + 1]);
+    auto *rhs  = load->opcode == CVM::Opcode::LOADX ? static_cast<CVM::LoadX *>(load) : nullptr;
+    if ((rhs != nullptr && !rhs->index.empty()) || op->reg_idx2 != load->reg_idx || load->reg_idx == lhs->reg_idx)
+        return false;
+
+    auto *fused     = new CVM::BinaryX(rhs != nullptr ? CVM::Opcode::BINXX : CVM::Opcode::BINXI);
+    fused->op       = op->opcode;
+    fused->reg_idx1 = lhs->reg_idx;
+    fused->reg_idx2 = load->reg_idx;
+    fused->lhs      = lhs->name;
+    if (rhs != nullptr)
+        fused->rhs = rhs->name;
+    else
+        fused->val = static_cast<CVM::LoadI *>(load)->val;
+    removeBack(insts, 3);
+    insts.push_back(fused);
+    return true;
+}
+
+// BINXI ADD %1 i %2 1
+// STOREX i %1
+// becomes
+// BINXI ADD %1 i %2 1 => i
+static bool binaryXStore(std::vector<CVM::VMInstruction *> &insts, int begin)
+{
+    auto *fused = static_cast<CVM::BinaryX *>(insts[begin]);
+    auto *store = static_cast<CVM::StoreX *>(insts[begin + 1]);
+    if (!fused->dest.empty() || !store->index.empty() || store->reg_idx != fused->resultReg()) return false;
+    fused->dest = store->name;
+    removeBack(insts, 1);
+    return true;
+}
+
+static const std::vector<COMPILER::PeepholeRule> PEEPHOLE_RULES = {
+    { "store-load", { { CVM::Opcode::STOREX }, { CVM::Opcode::LOADX } }, storeLoad },
+    { "store-store", { { CVM::Opcode::STOREX }, { CVM::Opcode::STOREX } }, storeStore },
+    { "store-jif", { { CVM::Opcode::STOREX }, { CVM::Opcode::JIF } }, storeJif },
+    { "jmp-jmp", { { CVM::Opcode::JMP }, { CVM::Opcode::JMP } }, jmpJmp },
+    { "jif-same", { { CVM::Opcode::JIF } }, jifSame },
+};
+
+// the most frequent sequences in `-profile-ngrams` output, e.g. `i++` and loop conditions
+static const std::vector<COMPILER::PeepholeRule> SUPERINSTRUCTION_RULES = {
+    { "binary-xx", { { CVM::Opcode::LOADX }, { CVM::Opcode::LOADX }, BINARY_OPS }, binaryX },
+    { "binary-xi", { { CVM::Opcode::LOADX }, { CVM::Opcode::LOADI }, BINARY_OPS }, binaryX },
+    { "binary-x-store", { { CVM::Opcode::BINXX, CVM::Opcode::BINXI }, { CVM::Opcode::STOREX } }, binaryXStore },
+};
+
 void COMPILER::PeepholeOptimization::doPeepholeOptimization()
 {
     collectJumpTarget();
-    traversal();
+    applyRules(PEEPHOLE_RULES);
+    threadJumps();
+}
+
+void COMPILER::PeepholeOptimization::fuseSuperinstructions()
+{
+    collectJumpTarget();
+    applyRules(SUPERINSTRUCTION_RULES);
 }
 
 void COMPILER::PeepholeOptimization::collectJumpTarget()
 {
+    jump_map.clear();
+    jump_map.reserve(block_list->size());
     for (int i = 0; i < block_list->size(); i++)
     {
         jump_map[(*block_list)[i]->name] = i;
     }
-}
-
-void COMPILER::PeepholeOptimization::traversal()
-{
-    // remove some instructions like following code
-    // store? c %1
-    // load? %1 c  (remove this line)
-    // store %1 c  (remove this line too)
-    std::deque<std::pair<std::list<CVM::VMInstruction *> *, std::list<CVM::VMInstruction *>::iterator>> window;
-    while (changed)
+    jump_targets.assign(block_list->size(), false);
+    auto markTarget = [this](const std::string &name)
+    {
+        if (auto it = jump_map.find(name); it != jump_map.end()) jump_targets[it->second] = true;
+    };
+    for (auto *block : *block_list)
     {
-        changed = false;
-        for (auto &block : *block_list)
+        for (auto *inst : block->vm_insts)
         {
-            for (auto it = block->vm_insts.begin(); it != block->vm_insts.end();)
+            if (inst->opcode == CVM::Opcode::JMP)
+            {
+                markTarget(static_cast<CVM::Jmp *>(inst)->basic_block_name);
+            }
+            else if (inst->opcode == CVM::Opcode::JIF)
+            {
+                markTarget(static_cast<CVM::Jif *>(inst)->basic_block_name1);
+                markTarget(static_cast<CVM::Jif *>(inst)->basic_block_name2);
+            }
+            else if (inst->opcode == CVM::Opcode::JTABLE)
+            {
+                for (const auto &name : static_cast<CVM::JTable *>(inst)->basic_block_names)
+                {
+                    markTarget(name);
+                }
+                markTarget(static_cast<CVM::JTable *>(inst)->default_block_name);
+            }
+            else if (inst->opcode == CVM::Opcode::JLOOKUP)
             {
-                auto inst = *it;
-                if (inst == nullptr ||
-                    !inOr(inst->opcode, CVM::Opcode::STOREA, CVM::Opcode::STORED, CVM::Opcode::STOREI,
-                          CVM::Opcode::STORES, CVM::Opcode::STOREX, //
-                          CVM::Opcode::LOADA, CVM::Opcode::LOADD, CVM::Opcode::LOADI, CVM::Opcode::LOADS,
-                          CVM::Opcode::LOADX, //
-                          CVM::Opcode::JMP, CVM::Opcode::JIF))
+                for (const auto &name : static_cast<CVM::JLookup *>(inst)->basic_block_names)
                 {
-                    if (inst == nullptr) window.clear();
-                    it++;
-                    continue;
+                    markTarget(name);
                 }
-                window.emplace_back(&block->vm_insts, it);
-                pass(window, it);
+                markTarget(static_cast<CVM::JLookup *>(inst)->default_block_name);
             }
         }
     }
 }
 
-void COMPILER::PeepholeOptimization::pass(
-    std::deque<std::pair<std::list<CVM::VMInstruction *> *, std::list<CVM::VMInstruction *>::iterator>> &window,
-    std::list<CVM::VMInstruction *>::iterator &cur_it)
+void COMPILER::PeepholeOptimization::applyRules(const std::vector<PeepholeRule> &rules)
 {
-    // if removed some code, `cur_it` will do nothing at the end of this function
-    // else `cur_it++`
-    auto remove_code = false;
-    const auto len   = window.size();
-    auto checkTarget = [this](const std::string &target_name)
+    // rules by the opcode they end with
+    std::array<std::vector<const PeepholeRule *>, 256> candidates;
+    for (const auto &rule : rules)
     {
-        // check whether the front instruction of the target block is a jmp instruction
-        auto tmp = (*block_list)[jump_map[target_name]]->vm_insts.front();
-        if (tmp->opcode == CVM::Opcode::JMP) return static_cast<CVM::Jmp *>(tmp)->basic_block_name;
-        return target_name;
-    };
-    auto loadStorePass = [&window, &cur_it, &len]()
-    {
-        // storex a %1
-        // loadx %1 a
-        // or
-        // storex a %1
-        // storex a %1
-        if (window.size() <= 1) return false;
-
-        auto storex  = dynamic_cast<CVM::StoreX *>(*window[len - 2].second);
-        auto storex2 = dynamic_cast<CVM::StoreX *>(*window[len - 1].second);
-        auto loadx   = dynamic_cast<CVM::LoadX *>(*window[len - 1].second);
-        if (storex == nullptr || (loadx == nullptr && storex2 == nullptr)) return false;
-        if ((loadx != nullptr && storex->name == loadx->name && storex->reg_idx == loadx->reg_idx &&
-             storex->index.empty() && loadx->index.empty()) ||
-            (storex2 != nullptr && storex->name == storex2->name && storex->reg_idx == storex2->reg_idx &&
-             storex->index.empty() && storex2->index.empty()))
+        for (auto opcode : rule.pattern.back())
         {
-            delete *window[len - 1].second;
-            *window[len - 1].second = nullptr;
-            if (cur_it == window[len - 1].second)
-            {
-                cur_it = window[len - 1].first->erase(cur_it);
-            }
-            window.pop_back();
-            return true;
+            candidates[opcode2UChar(opcode)].push_back(&rule);
         }
-        return false;
-    };
-    auto jmpJmpPass = [&window, &cur_it, &len]()
+    }
+    size_t total = 0;
+    for (auto *block : *block_list)
     {
-        // jmp 666
-        // jmp 777 (no code jump to this line) or jmp 666
-        if (window.size() <= 1) return false;
-        auto jmp  = dynamic_cast<CVM::Jmp *>(*window[len - 2].second);
-        auto jmp2 = dynamic_cast<CVM::Jmp *>(*window[len - 1].second);
-        if (jmp == nullptr || jmp2 == nullptr) return false;
-        if (jmp->target == jmp2->target)
+        total += block->vm_insts.size();
+    }
+    insts.clear();
+    owner.clear();
+    insts.reserve(total);
+    owner.reserve(total);
+    dirty.assign(block_list->size(), false);
+    // every instruction is appended once and the rules only look at the end of `insts`,
+    // a rewrite may expose another match which is tried right away.
+    int window_begin = 0;
+    for (int i = 0; i < block_list->size(); i++)
+    {
+        // the registers are unknown when another block jumps here
+        if (jump_targets[i]) window_begin = insts.size();
+        for (auto *inst : (*block_list)[i]->vm_insts)
         {
-            delete *window[len - 1].second;
-            *window[len - 1].second = nullptr;
-            if (cur_it == window[len - 1].second)
+            insts.push_back(inst);
+            owner.push_back(i);
+            bool rewritten = true;
+            while (rewritten && insts.size() > window_begin)
             {
-                cur_it = window[len - 1].first->erase(cur_it);
+                rewritten = applyRule(candidates[opcode2UChar(insts.back()->opcode)], window_begin);
             }
-            window.pop_back();
-            return true;
         }
-        return false;
-    };
-    auto jmpToJmpPass = [&window, checkTarget]()
+    }
+    // a rewritten sequence stays in the block of its first instruction
+    for (int i = 0; i < block_list->size(); i++)
     {
-        // 1 jmp 6
-        // 6 jmp 666
-        // 1 jmp `6` will replace with `666`
-        if (window.empty()) return;
-        auto verifyTarget = [checkTarget](CVM::VMInstruction *inst)
-        {
-            if (auto jmp = dynamic_cast<CVM::Jmp *>(inst); jmp != nullptr)
-            {
-                const auto new_target = checkTarget(jmp->basic_block_name);
-                jmp->basic_block_name = new_target;
-            }
-        };
-        for (auto x : window)
+        if (dirty[i]) (*block_list)[i]->vm_insts.clear();
+    }
+    for (int i = 0; i < insts.size(); i++)
+    {
+        if (dirty[owner[i]]) (*block_list)[owner[i]]->vm_insts.push_back(insts[i]);
+    }
+}
+
+bool COMPILER::PeepholeOptimization::applyRule(const std::vector<const PeepholeRule *> &candidates,
+                                               int window_begin)
+{
+    for (const auto *rule : candidates)
+    {
+        const int len   = rule->pattern.size();
+        const int begin = static_cast<int>(insts.size()) - len;
+        if (begin < window_begin) continue;
+        bool fits = true;
+        for (int i = 0; i < len - 1 && fits; i++)
         {
-            verifyTarget(*x.second);
+            fits = std::find(rule->pattern[i].begin(), rule->pattern[i].end(), insts[begin + i]->opcode) !=
+                   rule->pattern[i].end();
         }
-    };
-    auto jifSamePass = [&window, &cur_it]()
+        if (!fits) continue;
+        const int first = owner[begin];
+        const int last  = owner.back();
+        if (!rule->rewrite(insts, begin)) continue;
+        owner.resize(insts.size());
+        std::fill(dirty.begin() + first, dirty.begin() + last + 1, true);
+        return true;
+    }
+    return false;
+}
+
+void COMPILER::PeepholeOptimization::threadJumps()
+{
+    // 1 jmp 6
+    // 6 jmp 666
+    // 1 jmp `6` will replace with `666`
+    for (auto *block : *block_list)
     {
-        // jif 666 666
-        // replace it with jmp 666
-        if (window.empty()) return false;
-        bool retval = false;
-        for (auto w_it = window.begin(); w_it != window.end();)
+        for (auto &inst : block->vm_insts)
         {
-            auto &[vm_inst, it] = *w_it;
-            auto *jif           = dynamic_cast<CVM::Jif *>(*it);
-            if (jif == nullptr || jif->basic_block_name1 != jif->basic_block_name2)
-                return false;
-            else
-                w_it++;
-            // otherwise replace it.
-            retval |= true;
-            auto *jmp             = new CVM::Jmp;
-            jmp->basic_block_name = jif->basic_block_name1;
-            if (it == cur_it)
+            if (inst->opcode == CVM::Opcode::JMP)
             {
-                cur_it = vm_inst->erase(cur_it);
-                cur_it = vm_inst->insert(cur_it, jmp);
+                auto *jmp             = static_cast<CVM::Jmp *>(inst);
+                jmp->basic_block_name = finalTarget(jmp->basic_block_name);
             }
-            else
+            else if (inst->opcode == CVM::Opcode::JIF)
             {
-                it = vm_inst->erase(it);
-                it = vm_inst->insert(it, jmp);
+                auto *jif              = static_cast<CVM::Jif *>(inst);
+                jif->basic_block_name1 = finalTarget(jif->basic_block_name1);
+                jif->basic_block_name2 = finalTarget(jif->basic_block_name2);
+                if (jif->basic_block_name1 != jif->basic_block_name2) continue;
+                auto *jmp             = new CVM::Jmp;
+                jmp->basic_block_name = jif->basic_block_name1;
+                delete jif;
+                inst = jmp;
             }
-            w_it = window.erase(w_it);
-        }
-        return retval;
-    };
-    auto jifPass = [&window, checkTarget]()
-    {
-        // 111 jif 666 777
-        // 666 jmp ....
-        // 777 jmp ....
-        if (window.empty()) return;
-        auto verifyTarget = [checkTarget](CVM::VMInstruction *inst)
-        {
-            if (auto jif = dynamic_cast<CVM::Jif *>(inst); jif != nullptr)
+            else if (inst->opcode == CVM::Opcode::JTABLE)
             {
-                const auto new_target1 = checkTarget(jif->basic_block_name1);
-                const auto new_target2 = checkTarget(jif->basic_block_name2);
-                jif->basic_block_name1 = new_target1;
-                jif->basic_block_name2 = new_target2;
-            }
-        };
-        for (auto x : window)
-        {
-            verifyTarget(*x.second);
-        }
-    };
-    auto storeJifPass = [&window, &cur_it, &len]()
-    {
-        // LT %1 %2
-        // LOAD %0 t0  -> will be removed
-        // STORE t0 %0 -> will be removed
-        // JIF ... ...
-        if (len < 2) return false;
-        auto storex = dynamic_cast<CVM::StoreX *>(*window[len - 2].second);
-        auto jif    = dynamic_cast<CVM::Jif *>(*window[len - 1].second);
-        if (storex != nullptr && jif != nullptr)
-        {
-            if (storex->reg_idx != 0) return false;
-            delete *window[len - 2].second;
-            *window[len - 2].second = nullptr;
-            if (cur_it == window[len - 2].second)
-            {
-                cur_it = window[len - 2].first->erase(cur_it);
+                auto *table = static_cast<CVM::JTable *>(inst);
+                for (auto &name : table->basic_block_names)
+                {
+                    name = finalTarget(name);
+                }
+                table->default_block_name = finalTarget(table->default_block_name);
             }
-            else
+            else if (inst->opcode == CVM::Opcode::JLOOKUP)
             {
-                window[len - 2].second = window[len - 2].first->erase(window[len - 2].second);
-                cur_it++;
+                auto *lookup = static_cast<CVM::JLookup *>(inst);
+                for (auto &name : lookup->basic_block_names)
+                {
+                    name = finalTarget(name);
+                }
+                lookup->default_block_name = finalTarget(lookup->default_block_name);
             }
-            window.erase(window.end() - 2);
-            return true;
         }
-        return false;
-    };
+    }
+}
 
-    remove_code |= loadStorePass();
-    remove_code |= jmpJmpPass();
-    remove_code |= jifSamePass();
-    remove_code |= storeJifPass();
-    jmpToJmpPass();
-    jifPass();
-    changed |= remove_code;
-    if (!remove_code) cur_it++;
+const std::string &COMPILER::PeepholeOptimization::finalTarget(const std::string &name)
+{
+    const auto *target = &name;
+    for (int i = 0; i < MAX_JUMP_CHAIN; i++)
+    {
+        auto it = jump_map.find(*target);
+        if (it == jump_map.end()) break;
+        const auto &block = (*block_list)[it->second]->vm_insts;
+        if (block.empty() || block.front()->opcode != CVM::Opcode::JMP) break;
+        target = &static_cast<CVM::Jmp *>(block.front())->basic_block_name;
+    }
+    return *target;
 }
@@ -5,31 +5,51 @@
 #include "../../utility/utility.hpp"
 #include "bytecode_basicblock.hpp"
 
-#include <deque>
+#include <algorithm>
+#include <array>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
 namespace COMPILER
 {
+    // A rewrite of the last `pattern.size()` instructions, `pattern[i]` lists the opcodes accepted at position i.
+    // `rewrite` checks the operands of `insts[begin]...` and replaces them, it returns false if they don't fit.
+    // A rewrite never makes the instructions longer.
+    struct PeepholeRule
+    {
+        const char *name;
+        std::vector<std::vector<CVM::Opcode>> pattern;
+        bool (*rewrite)(std::vector<CVM::VMInstruction *> &insts, int begin);
+    };
+
     class PeepholeOptimization
     {
       public:
         void doPeepholeOptimization();
+        // replaces frequent instruction sequences with one superinstruction, run it after `doPeepholeOptimization()`
+        void fuseSuperinstructions();
 
       public:
         std::vector<BytecodeBasicBlock *> *block_list;
 
       private:
         void collectJumpTarget();
-        //
-        void traversal();
-        void pass(
-            std::deque<std::pair<std::list<CVM::VMInstruction *> *, std::list<CVM::VMInstruction *>::iterator>> &window,
-            std::list<CVM::VMInstruction *>::iterator &cur_it);
+        // one pass over the instructions of all blocks, laid out in one array
+        void applyRules(const std::vector<PeepholeRule> &rules);
+        bool applyRule(const std::vector<const PeepholeRule *> &candidates, int window_begin);
+        // jumps to a block which only jumps on go to its target directly
+        void threadJumps();
+        const std::string &finalTarget(const std::string &name);
 
       private:
-        bool changed = true;
+        // give up following a chain of jumps after this many blocks, e.g. in an empty infinite loop
+        static constexpr int MAX_JUMP_CHAIN = 16;
         std::unordered_map<std::string, int> jump_map;
+        std::vector<bool> jump_targets; // blocks which are entered by a jump, not only by falling through
+        std::vector<CVM::VMInstruction *> insts;
+        std::vector<int> owner;  // index of the block each instruction in `insts` belongs to
+        std::vector<bool> dirty; // blocks which lost or got an instruction
     };
 }; // namespace COMPILER
 
@@ -0,0 +1,110 @@
+#include "compiler.h"
+
+#include "../core/bytecode_verifier.h"
+#include "ast/ast_visualize.h"
+#include "bytecode/block_layout.h"
+#include "bytecode/peephole_optimization.h"
+#include "ir/inliner.h"
+#include "ir/interprocedural.h"
+#include "parser.h"
+
+CVM::Program COMPILER::Compiler::compile(std::string_view source, const CompileOptions &options)
+{
+    Compiler compiler;
+    compiler.options = options;
+    compiler.build(source);
+    auto program = compiler.program();
+    CVM::BytecodeVerifier::verify(program);
+    return program;
+}
+
+void COMPILER::Compiler::build(std::string_view source)
+{
+    // parse src
+    Parser parser(source);
+    ast = parser.parse();
+    // build ir
+    ir_generator.options = options;
+    ir_generator.visitTree(ast);
+
+    // `-no-code-simplify` is handled at the end of IRGenerator::visitTree()
+
+    if (options.remove_unused_define) ir_generator.removeUnusedVarDef();
+    {
+        Interprocedural interprocedural;
+        interprocedural.funcs       = &ir_generator.funcs;
+        interprocedural.global_vars = ir_generator.global_var_decl;
+        if (options.ipcp) interprocedural.propagateConstants();
+        if (options.memoize) interprocedural.markPureFunctions();
+        // the inliner leaves callees which mention a global alone, so this holds after it as well
+        interprocedural.markGlobalWriters();
+    }
+    // cfg, ssa, optimize related.
+    cfg.funcs       = ir_generator.funcs;
+    cfg.global_vars = ir_generator.global_var_decl;
+    cfg.options     = options;
+    if (options.inline_function)
+    {
+        Inliner inliner;
+        inliner.funcs       = cfg.funcs;
+        inliner.global_vars = ir_generator.global_var_decl;
+        inliner.inlineCalls();
+    }
+    if (!options.no_cfg_simplify) cfg.simplifyCFG();
+    if (options.dead_store_elimination) cfg.deadStoreElimination();
+    if (options.ssa) cfg.transformToSSA();
+    // vm instruction builder
+    bytecode_generator.funcs       = cfg.funcs;
+    bytecode_generator.global_vars = ir_generator.global_var_decl;
+    bytecode_generator.options     = options;
+    bytecode_generator.ir2VmInst();
+    // peephole
+    if (options.peephole || options.superinstruction)
+    {
+        PeepholeOptimization peephole;
+        peephole.block_list = &bytecode_generator.bytecode_basicblocks;
+        if (options.peephole) peephole.doPeepholeOptimization();
+        if (options.superinstruction) peephole.fuseSuperinstructions();
+    }
+    if (options.block_layout)
+    {
+        BlockLayout block_layout;
+        block_layout.block_list = &bytecode_generator.bytecode_basicblocks;
+        block_layout.layoutBlocks();
+    }
+    bytecode_generator.relocation();
+}
+
+CVM::Program COMPILER::Compiler::program()
+{
+    CVM::Program program;
+    program.vm_insts       = std::move(bytecode_generator.vm_insts);
+    program.entry          = bytecode_generator.entry;
+    program.entry_end      = bytecode_generator.entry_end;
+    program.global_var_len = bytecode_generator.global_var_len;
+    program.indexFuncs();
+    bytecode_generator.vm_insts.clear();
+    return program;
+}
+
+std::string COMPILER::Compiler::astStr()
+{
+    ASTVisualize ast_visualizer;
+    ast_visualizer.visitTree(ast);
+    return ast_visualizer.astStr();
+}
+
+std::string COMPILER::Compiler::irStr()
+{
+    return ir_generator.irStr();
+}
+
+std::string COMPILER::Compiler::cfgStr() const
+{
+    return cfg.cfgStr();
+}
+
+std::string COMPILER::Compiler::vmInstStr()
+{
+    return bytecode_generator.vmInstStr();
+}
@@ -0,0 +1,47 @@
+#ifndef CVM_COMPILER_H
+#define CVM_COMPILER_H
+
+#include "../common/config.h"
+#include "../core/program.hpp"
+#include "ast/ast.hpp"
+#include "bytecode/bytecode_generator.h"
+#include "ir/cfg.h"
+#include "ir/ir_generator.h"
+
+#include <string>
+#include <string_view>
+
+namespace COMPILER
+{
+    // Source to bytecode: parse, build IR, optimize by `options`, emit and lay out the bytecode.
+    // The stages are kept after `build()` for the dumps of the command line tool.
+    class Compiler
+    {
+      public:
+        // builds and verifies `source`, which is only needed during the call. throws `CYX::Error` if it doesn't
+        // compile
+        static CVM::Program compile(std::string_view source, const CompileOptions &options);
+
+        // `source` has to outlive the compiler, see `SourceFile`
+        void build(std::string_view source);
+        // the instructions of `build()`, not verified yet. `vmInstStr()` refers to them, so call it before the
+        // program is gone.
+        CVM::Program program();
+        //
+        std::string astStr();
+        std::string irStr();
+        std::string cfgStr() const;
+        std::string vmInstStr();
+
+      public:
+        CompileOptions options;
+
+      private:
+        Tree *ast{ nullptr };
+        IRGenerator ir_generator;
+        CFG cfg;
+        BytecodeGenerator bytecode_generator;
+    };
+} // namespace COMPILER
+
+#endif // CVM_COMPILER_H
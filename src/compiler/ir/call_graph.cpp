@@ -0,0 +1,117 @@
+#include "call_graph.h"
+
+void COMPILER::CallGraph::build(const std::vector<IRFunction *> &funcs, COMPILER::BasicBlock *global_vars)
+{
+    if (global_vars != nullptr)
+    {
+        for (auto *inst : global_vars->insts)
+        {
+            if (auto *assign = as<IRAssign, IR::Tag::ASSIGN>(inst); assign != nullptr)
+                global_names.insert(assign->dest()->name);
+        }
+    }
+    for (auto *func : funcs)
+    {
+        auto &targets = callees[func];
+        std::vector<IRVar *> vars;
+        for (auto *block : func->blocks)
+        {
+            for (auto *inst : block->insts)
+            {
+                auto *assign = as<IRAssign, IR::Tag::ASSIGN>(inst);
+                auto *call   = as<IRCall, IR::Tag::CALL>(assign != nullptr ? assign->src() : inst);
+                if (call != nullptr && call->func != nullptr)
+                {
+                    targets.insert(call->func);
+                    call_sites[call->func].push_back(call);
+                }
+                collectVars(inst, vars);
+                if (assign != nullptr && global_names.count(assign->dest()->name) != 0) global_writers.insert(func);
+                // build-in functions which convert their argument in place
+                if (call == nullptr || call->func != nullptr || !inOr(call->name, "read", "int", "double", "string"))
+                    continue;
+                for (auto *arg : call->args)
+                {
+                    auto *var = as<IRVar, IR::Tag::VAR>(arg);
+                    if (var != nullptr && global_names.count(var->name) != 0) global_writers.insert(func);
+                }
+            }
+        }
+        // globals live in their own frame, a renamed copy in the caller's frame would miss them
+        if (std::any_of(vars.begin(), vars.end(), [this](IRVar *var) { return global_names.count(var->name) != 0; }))
+            global_users.insert(func);
+    }
+    for (auto *func : funcs)
+    {
+        std::unordered_set<IRFunction *> seen;
+        std::vector<IRFunction *> work_list(callees[func].begin(), callees[func].end());
+        while (!work_list.empty())
+        {
+            auto *cur = work_list.back();
+            work_list.pop_back();
+            if (cur == func)
+            {
+                recursive.insert(func);
+                break;
+            }
+            if (!seen.insert(cur).second) continue;
+            work_list.insert(work_list.end(), callees[cur].begin(), callees[cur].end());
+        }
+    }
+    for (auto *func : funcs)
+    {
+        sort(func);
+    }
+}
+
+void COMPILER::CallGraph::sort(COMPILER::IRFunction *func)
+{
+    if (!visited.insert(func).second) return;
+    for (auto *callee : callees[func])
+    {
+        sort(callee);
+    }
+    order.push_back(func);
+}
+
+void COMPILER::CallGraph::collectVars(COMPILER::IR *ir, std::vector<IRVar *> &vars)
+{
+    if (ir == nullptr) return;
+    switch (ir->tag)
+    {
+        case IR::Tag::VAR:
+        {
+            auto *var = static_cast<IRVar *>(ir);
+            vars.push_back(var);
+            for (auto *idx : var->index)
+            {
+                collectVars(idx, vars);
+            }
+            break;
+        }
+        case IR::Tag::BINARY:
+            collectVars(static_cast<IRBinary *>(ir)->lhs, vars);
+            collectVars(static_cast<IRBinary *>(ir)->rhs, vars);
+            break;
+        case IR::Tag::ARRAY:
+            for (auto *x : static_cast<IRArray *>(ir)->content)
+            {
+                collectVars(x, vars);
+            }
+            break;
+        case IR::Tag::CALL:
+            for (auto *arg : static_cast<IRCall *>(ir)->args)
+            {
+                collectVars(arg, vars);
+            }
+            break;
+        case IR::Tag::ASSIGN:
+            collectVars(static_cast<IRAssign *>(ir)->dest(), vars);
+            collectVars(static_cast<IRAssign *>(ir)->src(), vars);
+            break;
+        case IR::Tag::BRANCH: collectVars(static_cast<IRBranch *>(ir)->cond, vars); break;
+        case IR::Tag::SWITCH: collectVars(static_cast<IRSwitch *>(ir)->cond, vars); break;
+        case IR::Tag::RETURN: collectVars(static_cast<IRReturn *>(ir)->ret, vars); break;
+        default: break;
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef CVM_CALL_GRAPH_H
+#define CVM_CALL_GRAPH_H
+
+#include "basicblock.hpp"
+#include "ir_instruction.hpp"
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace COMPILER
+{
+    // `IRGenerator` resolves every call of a user function by name and arity, so the call graph is static.
+    class CallGraph
+    {
+      public:
+        void build(const std::vector<IRFunction *> &funcs, BasicBlock *global_vars);
+        static void collectVars(IR *ir, std::vector<IRVar *> &vars);
+
+      public:
+        std::unordered_map<IRFunction *, std::unordered_set<IRFunction *>> callees;
+        std::unordered_map<IRFunction *, std::vector<IRCall *>> call_sites; // every call of a function
+        std::unordered_set<IRFunction *> recursive;                         // can reach itself
+        std::unordered_set<IRFunction *> global_users;                      // mentions a global variable
+        std::unordered_set<IRFunction *> global_writers;                    // assigns or converts a global
+        std::vector<IRFunction *> order;                                    // callees come before their callers
+
+      private:
+        void sort(IRFunction *func);
+
+      private:
+        std::unordered_set<std::string> global_names;
+        std::unordered_set<IRFunction *> visited;
+    };
+} // namespace COMPILER
+
+#endif // CVM_CALL_GRAPH_H
@@ -1,115 +1,128 @@
 #include "cfg.h"
 
-void COMPILER::CFG::init(IRFunction *func)
-{
-    for (auto block : func->blocks)
-    {
-        sdom[block]             = block;
-        disjoint_set[block]     = block;
-        disjoint_set_val[block] = block;
-    }
-}
-
 void COMPILER::CFG::clear()
 {
-    sdom.clear();
-    dfn.clear();
-    dfn_map.clear();
-    father.clear();
-    visited.clear();
-    sdom.clear();
+    index_block.clear();
+    rpo.clear();
+    rpo_number.clear();
     idom.clear();
     tree.clear();
     dominance_frontier.clear();
-    disjoint_set.clear();
-    disjoint_set_val.clear();
     var_block_map.clear();
     counter.clear();
     stack.clear();
     ssa_def_map.clear();
 }
 
-void COMPILER::CFG::dfs(COMPILER::BasicBlock *cur_basic_block)
+void COMPILER::CFG::calcReversePostOrder(COMPILER::IRFunction *func)
 {
-    if (cur_basic_block == nullptr) return;
-    if (visited.find(cur_basic_block) != visited.end()) return;
-    visited[cur_basic_block] = true;
-    dfn.push_back(cur_basic_block);
-    dfn_map[cur_basic_block] = dfn.size() - 1;
-    for (auto *block : cur_basic_block->succs)
+    // dense numbering, so everything below can live in flat vectors
+    for (auto *block : func->blocks)
+    {
+        block->block_index = index_block.size();
+        index_block.push_back(block);
+    }
+    const int n = index_block.size();
+    rpo_number.assign(n, -1);
+    // iterative dfs, huge functions would overflow the stack otherwise
+    std::vector<bool> visited(n, false);
+    std::vector<std::pair<BasicBlock *, std::unordered_set<BasicBlock *>::iterator>> dfs_stack;
+    visited[entry->block_index] = true;
+    dfs_stack.emplace_back(entry, entry->succs.begin());
+    while (!dfs_stack.empty())
+    {
+        auto &[block, it] = dfs_stack.back();
+        if (it == block->succs.end())
+        {
+            rpo.push_back(block);
+            dfs_stack.pop_back();
+            continue;
+        }
+        auto *succ = *it++;
+        if (visited[succ->block_index]) continue;
+        visited[succ->block_index] = true;
+        dfs_stack.emplace_back(succ, succ->succs.begin());
+    }
+    std::reverse(rpo.begin(), rpo.end());
+    for (int i = 0; i < rpo.size(); i++)
     {
-        dfs(block);
-        father[block] = cur_basic_block;
+        rpo_number[rpo[i]->block_index] = i;
     }
 }
 
-COMPILER::BasicBlock *COMPILER::CFG::find(COMPILER::BasicBlock *block)
+int COMPILER::CFG::intersect(int a, int b) const
 {
-    if (block == disjoint_set[block]) return block;
-    auto *tmp = find(disjoint_set[block]);
-    if (dfn_map[sdom[disjoint_set_val[disjoint_set[block]]]] < dfn_map[sdom[disjoint_set_val[block]]])
-        disjoint_set_val[block] = disjoint_set_val[disjoint_set[block]];
-    disjoint_set[block] = tmp;
-    return tmp;
+    while (a != b)
+    {
+        while (rpo_number[a] > rpo_number[b])
+            a = idom[a];
+        while (rpo_number[b] > rpo_number[a])
+            b = idom[b];
+    }
+    return a;
 }
 
-void COMPILER::CFG::tarjan()
+void COMPILER::CFG::calcIDom()
 {
-    for (unsigned long i = dfn.size() - 1; i >= 1; i--)
+    // Cooper, Harvey, Kennedy. "A Simple, Fast Dominance Algorithm".
+    // iterate to a fixed point in reverse post order, converges in 2-3 rounds on reducible cfg.
+    const int entry_idx = entry->block_index;
+    idom.assign(index_block.size(), -1);
+    idom[entry_idx] = entry_idx;
+    bool changed    = true;
+    while (changed)
     {
-        auto *cur_block = dfn[i];
-        if (cur_block == nullptr) continue;
-        for (auto *pre_block : cur_block->pres)
+        changed = false;
+        for (int i = 1; i < rpo.size(); i++)
         {
-            if (dfn_map.find(pre_block) != dfn_map.end())
+            auto *block  = rpo[i];
+            int new_idom = -1;
+            for (auto *pre : block->pres)
             {
-                find(cur_block);
-                int a           = dfn_map[sdom[cur_block]];
-                int b           = dfn_map[sdom[disjoint_set_val[pre_block]]];
-                sdom[cur_block] = dfn[std::min(a, b)];
+                const int pre_idx = pre->block_index;
+                if (idom[pre_idx] == -1) continue; // not processed yet or unreachable
+                new_idom = new_idom == -1 ? pre_idx : intersect(pre_idx, new_idom);
+            }
+            if (idom[block->block_index] != new_idom)
+            {
+                idom[block->block_index] = new_idom;
+                changed                  = true;
             }
         }
-        tree[sdom[cur_block]].insert(cur_block);
-        disjoint_set[cur_block] = father[cur_block];
-        auto *tmp               = disjoint_set[cur_block];
-        for (auto *block : tree[tmp])
-        {
-            find(block);
-            if (dfn_map[sdom[disjoint_set_val[block]]] < dfn_map[father[cur_block]])
-                idom[block] = disjoint_set_val[block];
-            else
-                idom[block] = father[cur_block];
-        }
-        tree[tmp].clear();
     }
-    for (int i = 1; i < dfn.size(); i++)
+    idom[entry_idx] = -1;
+    tree.assign(index_block.size(), {});
+    for (int i = 1; i < rpo.size(); i++)
     {
-        auto *cur_block = dfn[i];
-        if (idom[cur_block] != sdom[cur_block]) idom[cur_block] = idom[idom[cur_block]];
-        tree[idom[cur_block]].insert(cur_block);
+        tree[idom[rpo[i]->block_index]].push_back(rpo[i]);
     }
 }
 
 void COMPILER::CFG::buildDominateTree(COMPILER::IRFunction *func)
 {
     clear();
-    init(func);
-    dfs(func->blocks.front());
-    tarjan();
-    calcDominanceFrontier(func);
+    entry = func->blocks.front();
+    calcReversePostOrder(func);
+    calcIDom();
+    calcDominanceFrontier();
 }
 
-void COMPILER::CFG::calcDominanceFrontier(COMPILER::IRFunction *func)
+void COMPILER::CFG::calcDominanceFrontier()
 {
-    for (auto *block : func->blocks)
+    dominance_frontier.assign(index_block.size(), {});
+    for (auto *block : rpo)
     {
         if (block->pres.size() < 2) continue;
+        const int block_idom = idom[block->block_index];
         for (auto *pre : block->pres)
         {
-            auto *runner = pre;
-            while (runner != idom[block] && runner != nullptr)
+            if (rpo_number[pre->block_index] == -1) continue;
+            int runner = pre->block_index;
+            while (runner != block_idom && runner != -1)
             {
-                dominance_frontier[runner].insert(block);
+                auto &df = dominance_frontier[runner];
+                // all insertions of `block` happen in this loop, checking the last one is enough
+                if (df.empty() || df.back() != block) df.push_back(block);
                 runner = idom[runner];
             }
         }
@@ -120,92 +133,127 @@ void COMPILER::CFG::simplifyCFG()
 {
     for (auto *func : funcs)
     {
-        for (auto it = func->blocks.begin(); it != func->blocks.end();)
+        simplifyCFG(func);
+    }
+}
+
+void COMPILER::CFG::simplifyCFG(COMPILER::IRFunction *func)
+{
+    for (auto it = func->blocks.begin(); it != func->blocks.end();)
+    {
+        auto *block = *it;
+        if (block->insts.empty() && !block->pres.empty() && block->succs.size() == 1)
         {
-            auto *block = *it;
-            if (block->insts.empty() && !block->pres.empty() && block->succs.size() == 1)
+            // remove it!
+            auto *succ = *block->succs.begin();
+            succ->pres.erase(block);
+            for (auto *pre : block->pres)
             {
-                // remove it!
-                auto *succ = *block->succs.begin();
-                succ->pres.erase(block);
-                for (auto *pre : block->pres)
+                // remove block from pred's succs
+                pre->succs.erase(block);
+                pre->succs.insert(succ);
+                succ->pres.insert(pre);
+                // remove block from pred's insts
+                for (auto *inst : pre->insts)
                 {
-                    // remove block from pred's succs
-                    pre->succs.erase(block);
-                    pre->succs.insert(succ);
-                    succ->pres.insert(pre);
-                    // remove block from pred's insts
-                    for (auto *inst : pre->insts)
+                    if (inOr(inst->tag, IR::Tag::BRANCH, IR::Tag::SWITCH, IR::Tag::JMP))
                     {
-                        if (inOr(inst->tag, IR::Tag::BRANCH, IR::Tag::JMP))
+                        if (inst->tag == IR::Tag::BRANCH)
                         {
-                            if (inst->tag == IR::Tag::BRANCH)
-                            {
-                                auto *tmp = static_cast<IRBranch *>(inst);
-                                if (tmp->true_block == block) tmp->true_block = succ;
-                                if (tmp->false_block == block) tmp->false_block = succ;
-                            }
-                            else
-                            {
-                                auto *tmp = static_cast<IRJump *>(inst);
-                                if (tmp->target == block) tmp->target = succ;
-                            }
+                            auto *tmp = static_cast<IRBranch *>(inst);
+                            if (tmp->true_block == block) tmp->true_block = succ;
+                            if (tmp->false_block == block) tmp->false_block = succ;
                         }
-                    }
-                }
-                it = func->blocks.erase(it);
-                delete block;
-            }
-            else if (it != func->blocks.begin() && block->pres.empty())
-            {
-                // remove this block, it isn't the entry block and it has succ blocks
-                // remove all instructions
-                for (auto inst : block->insts)
-                {
-                    if (auto *tmp = as<IRAssign, IR::Tag::ASSIGN>(inst); tmp != nullptr)
-                    {
-                        COMPILER::forceRemoveVar(tmp->dest());
-                        auto *binary = as<IRBinary, IR::Tag::BINARY>(tmp->src());
-                        if (binary != nullptr)
+                        else if (inst->tag == IR::Tag::SWITCH)
                         {
-                            // maybe lhs and rhs are not var but IRConstant.
-                            if (!forceRemoveVar(as<IRVar, IR::Tag::VAR>(binary->lhs))) delete binary->lhs;
-                            if (!forceRemoveVar(as<IRVar, IR::Tag::VAR>(binary->rhs))) delete binary->rhs;
-                            delete binary;
+                            static_cast<IRSwitch *>(inst)->replaceTarget(block, succ);
+                        }
+                        else
+                        {
+                            auto *tmp = static_cast<IRJump *>(inst);
+                            if (tmp->target == block) tmp->target = succ;
                         }
-                        delete tmp;
-                    }
-                    else if (auto *tmp = as<IRBranch, IR::Tag::BRANCH>(inst); tmp != nullptr)
-                    {
-                        forceRemoveVar(tmp->cond);
-                        delete tmp;
-                    }
-                    else
-                    {
-                        delete inst;
                     }
                 }
-                // remove succs edges
-                for (auto succ : block->succs)
-                {
-                    succ->pres.erase(block);
-                }
-                // remove it from block list
-                it = func->blocks.erase(it);
-                delete block;
             }
-            else
+            it = func->blocks.erase(it);
+            delete block;
+        }
+        else if (it != func->blocks.begin() && block->pres.empty())
+        {
+            // remove this block, it isn't the entry block and it has succ blocks
+            it = func->blocks.erase(it);
+            destroyBlock(block);
+        }
+        else
+        {
+            it++;
+        }
+    }
+    // append missing return inst
+    auto *end_block = func->blocks.back();
+    if (end_block->insts.empty() || end_block->insts.back()->tag != IR::Tag::RETURN)
+    {
+        end_block->addInst(new IRReturn);
+    }
+}
+
+void COMPILER::CFG::destroyBlock(COMPILER::BasicBlock *block)
+{
+    // remove all phi functions, their args may be defined in blocks which are already gone.
+    for (auto *assign : block->phis)
+    {
+        forceRemoveVar(assign->dest());
+        auto *phi = as<IRPhi, IR::Tag::PHI>(assign->src());
+        for (auto *arg : phi->args)
+        {
+            if (!forceRemoveVar(as<IRVar, IR::Tag::VAR>(arg))) delete arg;
+        }
+        delete phi;
+        delete assign;
+    }
+    // remove all instructions
+    for (auto inst : block->insts)
+    {
+        if (auto *tmp = as<IRAssign, IR::Tag::ASSIGN>(inst); tmp != nullptr)
+        {
+            auto *binary = as<IRBinary, IR::Tag::BINARY>(tmp->src());
+            COMPILER::forceRemoveVar(tmp->dest());
+            forceRemoveVar(as<IRVar, IR::Tag::VAR>(tmp->src()));
+            if (binary != nullptr)
             {
-                it++;
+                // maybe lhs and rhs are not var but IRConstant.
+                if (!forceRemoveVar(as<IRVar, IR::Tag::VAR>(binary->lhs))) delete binary->lhs;
+                if (!forceRemoveVar(as<IRVar, IR::Tag::VAR>(binary->rhs))) delete binary->rhs;
+                delete binary;
             }
+            delete tmp;
+        }
+        else if (auto *tmp = as<IRBranch, IR::Tag::BRANCH>(inst); tmp != nullptr)
+        {
+            forceRemoveVar(tmp->cond);
+            delete tmp;
+        }
+        else if (auto *tmp = as<IRSwitch, IR::Tag::SWITCH>(inst); tmp != nullptr)
+        {
+            forceRemoveVar(tmp->cond);
+            delete tmp;
         }
-        // append missing return inst
-        auto *end_block = func->blocks.back();
-        if (end_block->insts.empty() || end_block->insts.back()->tag != IR::Tag::RETURN)
+        else
         {
-            end_block->addInst(new IRReturn);
+            delete inst;
         }
     }
+    // remove edges
+    for (auto succ : block->succs)
+    {
+        succ->pres.erase(block);
+    }
+    for (auto pre : block->pres)
+    {
+        pre->succs.erase(block);
+    }
+    delete block;
 }
 
 void COMPILER::CFG::removeUnusedPhis(IRFunction *func)
@@ -225,28 +273,51 @@ void COMPILER::CFG::removeUnusedPhis(IRFunction *func)
 
 void COMPILER::CFG::transformToSSA()
 {
-    if (NO_SSA) return;
-    for (auto *func : funcs)
+    if (!options.ssa) return;
+    if (options.jobs <= 1 || funcs.size() <= 1)
     {
-        if (func->blocks.empty()) continue;
-        entry = func->blocks.front();
-        buildDominateTree(func);
-
-        var_block_map.clear();
-        collectVarAssign(func);
-        insertPhiNode();
-        tryRename(func);
-        removeUnusedPhis(func);
-        removeTrivialPhi(func);
-        if (CONSTANT_FOLDING)
+        for (auto *func : funcs)
         {
-            constantFolding(func);
-            if (CONSTANT_PROPAGATION) constantPropagation(func);
-            removeUnusedPhis(func);
+            transformToSSA(func);
         }
-        phiElimination(func);
-        if (DEAD_CODE_ELIMINATION) deadCodeElimination(func);
+        return;
+    }
+    // functions don't share IR, every worker has a CFG of its own for the per function state
+    ThreadPool pool(options.jobs);
+    std::vector<CFG> workers(pool.size());
+    for (auto &worker : workers)
+    {
+        worker.global_vars = global_vars;
+        worker.options     = options;
+    }
+    pool.parallelFor(funcs.size(), [this, &workers](int i, int worker) { workers[worker].transformToSSA(funcs[i]); });
+}
+
+void COMPILER::CFG::transformToSSA(COMPILER::IRFunction *func)
+{
+    if (func->blocks.empty()) return;
+    buildDominateTree(func);
+    var_block_map.clear();
+    collectVarAssign(func);
+    if (options.pruned_ssa) calcLiveness();
+    insertPhiNode();
+    tryRename(func);
+    removeUnusedPhis(func);
+    removeTrivialPhi(func);
+    if (options.sccp) sparseConditionalConstantPropagation(func);
+    if (options.gvn) globalValueNumbering(func);
+    if (options.licm) loopInvariantCodeMotion(func);
+    if (options.induction_variable) inductionVariables(func);
+    if (options.constant_folding)
+    {
+        constantFolding(func);
+        if (options.constant_propagation) constantPropagation(func);
+        removeUnusedPhis(func);
     }
+    phiElimination(func);
+    if (options.dead_code_elimination) deadCodeElimination(func);
+    // branches folded by SCCP and unused preheaders leave empty blocks behind
+    if (options.sccp || options.licm) simplifyCFG(func);
 }
 
 void COMPILER::CFG::collectVarAssign(COMPILER::IRFunction *func)
@@ -259,6 +330,8 @@ void COMPILER::CFG::collectVarAssign(COMPILER::IRFunction *func)
             {
                 auto *assign = static_cast<IRAssign *>(inst);
                 if (assign->dest()->def == nullptr && assign->dest()->is_ir_gen) continue;
+                // a[i] = x updates `a` in place, it is not a new definition
+                if (assign->dest()->is_array) continue;
                 var_block_map[assign->dest()->name].insert(block);
             }
         }
@@ -268,11 +341,23 @@ void COMPILER::CFG::collectVarAssign(COMPILER::IRFunction *func)
 void COMPILER::CFG::insertPhiNode()
 {
     std::queue<BasicBlock *> work_list;
-    std::unordered_map<BasicBlock *, std::string> inserted;
+    std::vector<const std::string *> inserted(index_block.size(), nullptr);
+
+    // semi-pruned: a variable which is never used before its definition in some block
+    // is local to every block, it never needs a phi node.
+    std::unordered_set<std::string> global_names;
+    if (options.pruned_ssa)
+    {
+        for (auto *block : rpo)
+        {
+            global_names.insert(block->gen.begin(), block->gen.end());
+        }
+    }
 
     for (const auto &p : var_block_map)
     {
         const std::string var_name = p.first;
+        if (options.pruned_ssa && global_names.find(var_name) == global_names.end()) continue;
         for (auto *block : p.second)
         {
             work_list.push(block);
@@ -282,12 +367,14 @@ void COMPILER::CFG::insertPhiNode()
             auto *block = work_list.front();
             work_list.pop();
 
-            for (auto *df_block : dominance_frontier[block])
+            for (auto *df_block : dominance_frontier[block->block_index])
             {
-                if (inserted[df_block] != var_name)
+                // pruned: the merged value is dead here, nobody reads it before a redefinition.
+                if (options.pruned_ssa && df_block->live_in.find(var_name) == df_block->live_in.end()) continue;
+                if (inserted[df_block->block_index] == nullptr || *inserted[df_block->block_index] != var_name)
                 {
                     // add phi node
-                    inserted[df_block] = var_name;
+                    inserted[df_block->block_index] = &p.first;
                     auto *assign       = new IRAssign;
                     //
                     auto *lhs = new IRVar;
@@ -307,6 +394,90 @@ void COMPILER::CFG::insertPhiNode()
     }
 }
 
+void COMPILER::CFG::collectUses(COMPILER::IR *ir, COMPILER::BasicBlock *block)
+{
+    if (ir == nullptr) return;
+    switch (ir->tag)
+    {
+        case IR::Tag::VAR:
+        {
+            auto *var = static_cast<IRVar *>(ir);
+            if (block->kill.find(var->name) == block->kill.end()) block->gen.insert(var->name);
+            for (auto *idx : var->index)
+            {
+                collectUses(idx, block);
+            }
+            break;
+        }
+        case IR::Tag::BINARY:
+            collectUses(static_cast<IRBinary *>(ir)->lhs, block);
+            collectUses(static_cast<IRBinary *>(ir)->rhs, block);
+            break;
+        case IR::Tag::CALL:
+            for (auto *arg : static_cast<IRCall *>(ir)->args)
+            {
+                collectUses(arg, block);
+            }
+            break;
+        case IR::Tag::ARRAY:
+            for (auto *x : static_cast<IRArray *>(ir)->content)
+            {
+                collectUses(x, block);
+            }
+            break;
+        case IR::Tag::RETURN: collectUses(static_cast<IRReturn *>(ir)->ret, block); break;
+        case IR::Tag::BRANCH: collectUses(static_cast<IRBranch *>(ir)->cond, block); break;
+        case IR::Tag::SWITCH: collectUses(static_cast<IRSwitch *>(ir)->cond, block); break;
+        case IR::Tag::ASSIGN:
+        {
+            auto *assign = static_cast<IRAssign *>(ir);
+            collectUses(assign->src(), block);
+            // a[i] = x reads `a` (the other elements survive) and does not kill it
+            if (assign->dest()->is_array)
+                collectUses(assign->dest(), block);
+            else
+                block->kill.insert(assign->dest()->name);
+            break;
+        }
+        default: break;
+    }
+}
+
+void COMPILER::CFG::calcLiveness()
+{
+    for (auto *block : rpo)
+    {
+        block->gen.clear();
+        block->kill.clear();
+        block->live_in.clear();
+        block->live_out.clear();
+        for (auto *inst : block->insts)
+        {
+            collectUses(inst, block);
+        }
+        block->live_in = block->gen;
+    }
+    // backward data flow, post order converges fastest.
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (auto it = rpo.rbegin(); it != rpo.rend(); it++)
+        {
+            auto *block = *it;
+            for (auto *succ : block->succs)
+            {
+                for (const auto &name : succ->live_in)
+                {
+                    if (!block->live_out.insert(name).second) continue;
+                    if (block->kill.find(name) == block->kill.end()) block->live_in.insert(name);
+                    changed = true;
+                }
+            }
+        }
+    }
+}
+
 void COMPILER::CFG::removeTrivialPhi(COMPILER::IRFunction *func)
 {
     // remove phi node like x2 = phi(x1, x1)
@@ -376,7 +547,9 @@ void COMPILER::CFG::constantPropagation(COMPILER::IRFunction *func)
             auto *phi = as<IRPhi, IR::Tag::PHI>(assign->src());
             for (auto &arg : phi->args)
             {
-                auto *var        = as<IRVar, IR::Tag::VAR>(arg);
+                auto *var = as<IRVar, IR::Tag::VAR>(arg);
+                // no definition on this path, e.g. the outer loop's first visit of an inner loop's counter
+                if (var == nullptr || var->def == nullptr) continue;
                 auto *arg_assign = as<IRAssign, IR::Tag::ASSIGN>(var->def->belong_inst);
                 if (arg_assign == nullptr) continue;
                 auto *constant = as<IRConstant, IR::Tag::CONST>(arg_assign->src());
@@ -447,6 +620,62 @@ void COMPILER::CFG::constantFolding(COMPILER::IRFunction *func)
     }
 }
 
+namespace
+{
+    // fold `lhs op rhs` the same way as the vm does, gives up if the vm would fail or the result is not cheap.
+    std::optional<CYX::Value> foldBinary(COMPILER::IROpcode opcode, CYX::Value lhs, CYX::Value rhs)
+    {
+        using namespace COMPILER;
+        const bool numeric = !lhs.is<std::string>() && !rhs.is<std::string>();
+        const bool integer = lhs.is<long long>() && rhs.is<long long>();
+        switch (opcode)
+        {
+            case IR_ADD: return lhs + rhs;
+            case IR_SUB:
+                if (numeric) return lhs - rhs;
+                break;
+            case IR_MUL:
+                if (numeric) return lhs * rhs;
+                break;
+            case IR_DIV:
+                if (numeric && rhs.as<double>() != 0) return lhs / rhs;
+                break;
+            case IR_MOD:
+                if (integer && rhs.as<long long>() != 0) return lhs % rhs;
+                break;
+            case IR_BAND:
+                if (integer) return lhs & rhs;
+                break;
+            case IR_BOR:
+                if (integer) return lhs | rhs;
+                break;
+            case IR_BXOR:
+                if (integer) return lhs ^ rhs;
+                break;
+            case IR_SHL:
+                if (integer && rhs.as<long long>() >= 0 && rhs.as<long long>() < 64) return lhs << rhs;
+                break;
+            case IR_SHR:
+                if (integer && rhs.as<long long>() >= 0 && rhs.as<long long>() < 64) return lhs >> rhs;
+                break;
+            case IR_LAND:
+                if (integer) return CYX::Value(lhs && rhs);
+                break;
+            case IR_LOR:
+                if (integer) return CYX::Value(lhs || rhs);
+                break;
+            case IR_EQ: return CYX::Value(lhs == rhs);
+            case IR_NE: return CYX::Value(lhs != rhs);
+            case IR_LT: return CYX::Value(lhs < rhs);
+            case IR_LE: return CYX::Value(lhs <= rhs);
+            case IR_GT: return CYX::Value(lhs > rhs);
+            case IR_GE: return CYX::Value(lhs >= rhs);
+            default: break;
+        }
+        return {};
+    }
+} // namespace
+
 std::optional<CYX::Value> COMPILER::CFG::tryFindConstant(COMPILER::IRVar *var)
 {
     // recursive exit
@@ -502,180 +731,1378 @@ std::optional<CYX::Value> COMPILER::CFG::tryFindConstant(COMPILER::IRVar *var)
             else
                 return {};
         }
-        switch (src_binary->opcode)
-        {
-            case IR_ADD: return lhs + rhs;
-            case IR_SUB: return lhs - rhs;
-            case IR_MUL: return lhs * rhs;
-            case IR_DIV: return lhs / rhs;
-            case IR_BOR: return lhs | rhs;
-            case IR_BXOR: return lhs ^ rhs;
-            case IR_MOD: return lhs % rhs;
-            case IR_SHR: return lhs >> rhs;
-            case IR_SHL: return lhs << rhs;
-            default: UNREACHABLE();
-        }
+        // `"a" - 1` is left to fail when it runs
+        return foldBinary(src_binary->opcode, lhs, rhs);
     }
     return {};
 }
 
-void COMPILER::CFG::destroyPhiNode(COMPILER::IRAssign *assign)
-{
-    delete assign->dest();
-    auto *phi = as<IRPhi, IR::Tag::PHI>(assign->src());
-    for (auto *tmp : phi->args)
-    {
-        auto *var = as<IRVar, IR::Tag::VAR>(tmp);
-        if (var->def) var->def->killUse(var);
-        delete var;
-    }
-    delete phi;
-    delete assign;
-}
-
-void COMPILER::CFG::phiElimination(COMPILER::IRFunction *func)
+void COMPILER::CFG::sparseConditionalConstantPropagation(COMPILER::IRFunction *func)
 {
+    // a value is only propagated along edges which may be executed, so
+    // x = 1; if (x != 1) { x = 2 } -> the `then` block is dead and x stays 1 after the if stmt.
+    lattice.clear();
+    sccp_uses.clear();
+    inst_block.clear();
+    executable.assign(index_block.size(), false);
     for (auto *block : func->blocks)
     {
         for (auto *assign : block->phis)
         {
-            auto args = as<IRPhi, IR::Tag::PHI>(assign->src())->args;
-
-            const auto dest_name    = assign->dest()->name;
-            const auto dest_ssa_idx = assign->dest()->ssa_index;
-            auto *dest              = assign->dest();
-            //
-            for (int i = 0; i < args.size(); i++)
-            {
-                auto *new_assign = new IRAssign;
-                if (i != 0)
-                {
-                    auto *new_var      = new IRVar;
-                    new_var->name      = dest_name;
-                    new_var->ssa_index = dest_ssa_idx;
-                    new_assign->setDest(new_var);
-                    new_var->def = dest;
-                    dest->addUse(new_var);
-                }
-                else
-                {
-                    new_assign->setDest(dest);
-                }
-                //
-
-                BasicBlock *insert_block;
-                if (auto *tmp = as<IRVar, IR::Tag::VAR>(args[i]); tmp != nullptr)
-                {
-                    insert_block = tmp->def->belong_inst->block;
-                }
-                else if (auto *tmp = as<IRConstant, IR::Tag::CONST>(args[i]))
-                {
-                    insert_block = tmp->belong_inst->block;
-                }
-                else
-                {
-                    UNREACHABLE();
-                }
-                new_assign->setSrc(args[i]);
-                new_assign->block = insert_block;
-                // avoid insert as following code
-                // jmp L1
-                // x1 = x2
-                if (insert_block->insts.back()->tag == IR::Tag::JMP)
-                {
-                    insert_block->addInstBefore(new_assign, insert_block->insts.back());
-                }
-                else
-                {
-                    insert_block->addInst(new_assign);
-                }
-            }
-            delete assign;
+            inst_block[assign] = block;
+            lattice.emplace(assign->dest()->ssaName(), LatticeCell{});
+            sccpCollectUses(assign->src(), assign);
+        }
+        for (auto *inst : block->insts)
+        {
+            inst_block[inst] = block;
+            sccpCollectUses(inst, inst);
+            auto *assign = as<IRAssign, IR::Tag::ASSIGN>(inst);
+            // an element store makes the whole array unknown, keep it out of the lattice (BOTTOM).
+            if (assign != nullptr && !assign->dest()->is_array)
+                lattice.emplace(assign->dest()->ssaName(), LatticeCell{});
         }
-        // remove all phi functions.
-        block->phis.clear();
     }
-}
-
-void COMPILER::CFG::deadCodeElimination(COMPILER::IRFunction *func)
-{
-    // MAGIC
-    for (auto block_it = func->blocks.crbegin(); block_it != func->blocks.crend(); block_it++)
+    //
+    sccpMarkExecutable(func->blocks.front());
+    while (!block_work_list.empty() || !ssa_work_list.empty())
     {
-        auto *block = *block_it;
-        for (auto inst_it = block->insts.rbegin(); inst_it != block->insts.rend();)
+        while (!block_work_list.empty())
         {
-            auto *tmp    = *inst_it;
-            auto *assign = as<IRAssign, IR::Tag::ASSIGN>(tmp);
-            // a = b + c
-            // no user! remove this instruction!
-            if (assign != nullptr && assign->dest()->use.empty())
+            auto *block = block_work_list.front();
+            block_work_list.pop();
+            for (auto *assign : block->phis)
             {
-                if (assign->dest()->def != nullptr && assign->dest()->def->ssaName() == assign->dest()->ssaName())
-                {
-                    inst_it++;
-                    continue;
-                }
-                // call
-                auto *call = as<IRCall, IR::Tag::CALL>(assign->src());
-                if (call != nullptr)
-                {
-                    // non-retval. remove temp var.
-                    delete tmp;
-                    *inst_it = call;
-                    inst_it++;
-                    continue;
-                }
-                auto *var = as<IRVar, IR::Tag::VAR>(assign->src());
-                if (var != nullptr)
-                {
-                    var->def->killUse(var);
-                    delete var;
-                }
-                //
-                auto *binary = as<IRBinary, IR::Tag::BINARY>(assign->src());
-                if (binary != nullptr)
+                sccpVisitPhi(assign);
+            }
+            for (auto *inst : block->insts)
+            {
+                sccpVisitInst(inst, block);
+            }
+            // falls through
+            if (block->insts.empty() ||
+                !inOr(block->insts.back()->tag, IR::Tag::BRANCH, IR::Tag::SWITCH, IR::Tag::JMP, IR::Tag::RETURN))
+            {
+                for (auto *succ : block->succs)
                 {
-                    auto *lhs_var   = as<IRVar, IR::Tag::VAR>(binary->lhs);
-                    auto *lhs_const = as<IRConstant, IR::Tag::CONST>(binary->lhs);
-                    auto *rhs_var   = as<IRVar, IR::Tag::VAR>(binary->rhs);
-                    auto *rhs_const = as<IRConstant, IR::Tag::CONST>(binary->rhs);
-                    if (lhs_var != nullptr) lhs_var->def->killUse(lhs_var);
-                    if (rhs_var != nullptr) rhs_var->def->killUse(rhs_var);
-                    //
-                    delete lhs_var;
-                    delete rhs_var;
-                    delete lhs_const;
-                    delete rhs_const;
-                    delete binary;
+                    sccpMarkExecutable(succ);
                 }
-                delete assign;
-                // remove it from list
-                block->insts.erase(--inst_it.base());
             }
-            else
+        }
+        while (!ssa_work_list.empty())
+        {
+            auto name = ssa_work_list.front();
+            ssa_work_list.pop();
+            for (auto *inst : sccp_uses[name])
             {
-                inst_it++;
+                auto *block = inst_block[inst];
+                if (!executable[block->block_index]) continue;
+                auto *assign = as<IRAssign, IR::Tag::ASSIGN>(inst);
+                if (assign != nullptr && assign->src()->tag == IR::Tag::PHI)
+                    sccpVisitPhi(assign);
+                else
+                    sccpVisitInst(inst, block);
             }
         }
     }
+    sccpRewrite(func);
 }
 
-void COMPILER::CFG::tryRename(COMPILER::IRFunction *func)
+bool COMPILER::CFG::sccpMeet(LatticeCell &cell, const LatticeCell &that)
 {
-    for (const auto &p : var_block_map)
+    // returns true if `cell` changed.
+    if (cell.state == LatticeCell::State::BOTTOM || that.state == LatticeCell::State::TOP) return false;
+    if (cell.state == LatticeCell::State::TOP || that.state == LatticeCell::State::BOTTOM)
     {
-        counter[p.first] = 0;
+        cell = that;
+        return true;
     }
-    rename(func->blocks.front());
+    auto value = that.value;
+    if (cell.value.isSameType(value) && cell.value == value) return false;
+    cell.state = LatticeCell::State::BOTTOM;
+    return true;
 }
 
-void COMPILER::CFG::rename(COMPILER::BasicBlock *block)
+void COMPILER::CFG::sccpCollectUses(COMPILER::IR *ir, COMPILER::IRInst *user)
 {
-    for (auto *phi : block->phis)
+    if (ir == nullptr) return;
+    switch (ir->tag)
     {
-        auto *lhs                   = phi->dest();
-        lhs->ssa_index              = newId(lhs->name, lhs);
+        case IR::Tag::VAR:
+        {
+            auto *var = static_cast<IRVar *>(ir);
+            sccp_uses[var->ssaName()].push_back(user);
+            for (auto *idx : var->index)
+            {
+                sccpCollectUses(idx, user);
+            }
+            break;
+        }
+        case IR::Tag::BINARY:
+            sccpCollectUses(static_cast<IRBinary *>(ir)->lhs, user);
+            sccpCollectUses(static_cast<IRBinary *>(ir)->rhs, user);
+            break;
+        case IR::Tag::PHI:
+            for (auto *arg : static_cast<IRPhi *>(ir)->args)
+            {
+                sccpCollectUses(arg, user);
+            }
+            break;
+        case IR::Tag::CALL:
+        {
+            // build-in functions like `string(x)` convert their argument in place, don't trust it anymore.
+            auto *call = static_cast<IRCall *>(ir);
+            if (call->func != nullptr || !inOr(call->name, "read", "int", "double", "string")) break;
+            for (auto *arg : call->args)
+            {
+                if (auto *var = as<IRVar, IR::Tag::VAR>(arg); var != nullptr)
+                    lattice[var->ssaName()].state = LatticeCell::State::BOTTOM;
+            }
+            break;
+        }
+        case IR::Tag::BRANCH: sccpCollectUses(static_cast<IRBranch *>(ir)->cond, user); break;
+        case IR::Tag::SWITCH: sccpCollectUses(static_cast<IRSwitch *>(ir)->cond, user); break;
+        case IR::Tag::ASSIGN: sccpCollectUses(static_cast<IRAssign *>(ir)->src(), user); break;
+        // returns and arrays never produce a constant, nothing to revisit.
+        default: break;
+    }
+}
+
+void COMPILER::CFG::sccpMarkExecutable(COMPILER::BasicBlock *block)
+{
+    if (executable[block->block_index]) return;
+    executable[block->block_index] = true;
+    block_work_list.push(block);
+}
+
+void COMPILER::CFG::sccpVisitInst(COMPILER::IRInst *inst, COMPILER::BasicBlock *block)
+{
+    if (auto *assign = as<IRAssign, IR::Tag::ASSIGN>(inst); assign != nullptr)
+    {
+        if (assign->dest()->is_array) return;
+        LatticeCell cell;
+        if (auto *binary = as<IRBinary, IR::Tag::BINARY>(assign->src()); binary != nullptr)
+            cell = sccpEvalBinary(binary);
+        else if (inOr(assign->src()->tag, IR::Tag::CONST, IR::Tag::VAR))
+            cell = sccpValueOf(assign->src());
+        else
+            cell.state = LatticeCell::State::BOTTOM; // call, array
+        sccpUpdate(assign->dest(), cell);
+    }
+    else if (auto *branch = as<IRBranch, IR::Tag::BRANCH>(inst); branch != nullptr)
+    {
+        auto cell = sccpValueOf(branch->cond);
+        if (cell.state == LatticeCell::State::CONSTANT)
+        {
+            sccpMarkExecutable(static_cast<bool>(cell.value) ? branch->true_block : branch->false_block);
+        }
+        else if (cell.state == LatticeCell::State::BOTTOM)
+        {
+            sccpMarkExecutable(branch->true_block);
+            sccpMarkExecutable(branch->false_block);
+        }
+    }
+    else if (auto *inst_switch = as<IRSwitch, IR::Tag::SWITCH>(inst); inst_switch != nullptr)
+    {
+        auto cell = sccpValueOf(inst_switch->cond);
+        if (cell.state == LatticeCell::State::CONSTANT)
+        {
+            sccpMarkExecutable(inst_switch->target(cell.value));
+        }
+        else if (cell.state == LatticeCell::State::BOTTOM)
+        {
+            for (auto &x : inst_switch->cases)
+            {
+                sccpMarkExecutable(x.second);
+            }
+            sccpMarkExecutable(inst_switch->default_block);
+        }
+    }
+    else if (auto *jump = as<IRJump, IR::Tag::JMP>(inst); jump != nullptr)
+    {
+        sccpMarkExecutable(jump->target);
+    }
+}
+
+void COMPILER::CFG::sccpVisitPhi(COMPILER::IRAssign *assign)
+{
+    LatticeCell cell;
+    for (auto *arg : as<IRPhi, IR::Tag::PHI>(assign->src())->args)
+    {
+        auto *var = as<IRVar, IR::Tag::VAR>(arg);
+        if (var != nullptr)
+        {
+            // phi args don't remember their incoming edges, the block of the definition stands in for it.
+            auto it = var->def != nullptr ? inst_block.find(var->def->belong_inst) : inst_block.end();
+            if (it != inst_block.end() && !executable[it->second->block_index]) continue;
+        }
+        sccpMeet(cell, sccpValueOf(arg));
+    }
+    sccpUpdate(assign->dest(), cell);
+}
+
+void COMPILER::CFG::sccpUpdate(COMPILER::IRVar *dest, const LatticeCell &cell)
+{
+    auto name = dest->ssaName();
+    auto it   = lattice.find(name);
+    if (it == lattice.end()) return;
+    if (sccpMeet(it->second, cell)) ssa_work_list.push(name);
+}
+
+COMPILER::CFG::LatticeCell COMPILER::CFG::sccpValueOf(COMPILER::IR *ir)
+{
+    LatticeCell cell;
+    cell.state = LatticeCell::State::BOTTOM;
+    if (auto *constant = as<IRConstant, IR::Tag::CONST>(ir); constant != nullptr)
+    {
+        cell.state = LatticeCell::State::CONSTANT;
+        cell.value = constant->value;
+    }
+    else if (auto *var = as<IRVar, IR::Tag::VAR>(ir); var != nullptr && !var->is_array)
+    {
+        // params and globals are not defined in this function
+        auto it = lattice.find(var->ssaName());
+        if (it != lattice.end()) cell = it->second;
+    }
+    return cell;
+}
+
+COMPILER::CFG::LatticeCell COMPILER::CFG::sccpEvalBinary(COMPILER::IRBinary *binary)
+{
+    LatticeCell cell;
+    cell.state = LatticeCell::State::BOTTOM;
+    // unary expr, self add / sub
+    if (binary->lhs == nullptr || binary->rhs == nullptr) return cell;
+    auto lhs = sccpValueOf(binary->lhs);
+    auto rhs = sccpValueOf(binary->rhs);
+    if (lhs.state == LatticeCell::State::BOTTOM || rhs.state == LatticeCell::State::BOTTOM) return cell;
+    if (lhs.state == LatticeCell::State::TOP || rhs.state == LatticeCell::State::TOP) return {};
+    auto value = foldBinary(binary->opcode, lhs.value, rhs.value);
+    if (value.has_value())
+    {
+        cell.state = LatticeCell::State::CONSTANT;
+        cell.value = value.value();
+    }
+    return cell;
+}
+
+void COMPILER::CFG::sccpRewrite(COMPILER::IRFunction *func)
+{
+    auto is_constant = [this](IRVar *var) {
+        auto it = lattice.find(var->ssaName());
+        return it != lattice.end() && it->second.state == LatticeCell::State::CONSTANT;
+    };
+    // if (1) goto L1 else goto L2 -> jmp L1
+    for (auto *block : func->blocks)
+    {
+        if (!executable[block->block_index] || block->insts.empty()) continue;
+        auto *branch = as<IRBranch, IR::Tag::BRANCH>(block->insts.back());
+        if (branch == nullptr || !is_constant(branch->cond)) continue;
+        const bool taken = static_cast<bool>(lattice[branch->cond->ssaName()].value);
+        auto *jump       = new IRJump;
+        jump->target     = taken ? branch->true_block : branch->false_block;
+        jump->block      = block;
+        auto *not_taken  = taken ? branch->false_block : branch->true_block;
+        if (not_taken != jump->target)
+        {
+            block->succs.erase(not_taken);
+            not_taken->pres.erase(block);
+        }
+        forceRemoveVar(branch->cond);
+        delete branch;
+        block->insts.back() = jump;
+    }
+    // switch (1) { (1) => ..., (2) => ... } -> jmp case 1
+    for (auto *block : func->blocks)
+    {
+        if (!executable[block->block_index] || block->insts.empty()) continue;
+        auto *inst = as<IRSwitch, IR::Tag::SWITCH>(block->insts.back());
+        if (inst == nullptr || !is_constant(inst->cond)) continue;
+        auto *jump   = new IRJump;
+        jump->target = inst->target(lattice[inst->cond->ssaName()].value);
+        jump->block  = block;
+        for (auto *succ : std::vector<BasicBlock *>(block->succs.begin(), block->succs.end()))
+        {
+            if (succ == jump->target) continue;
+            block->succs.erase(succ);
+            succ->pres.erase(block);
+        }
+        forceRemoveVar(inst->cond);
+        delete inst;
+        block->insts.back() = jump;
+    }
+    // drop the phi args which come from dead blocks, then the dead blocks
+    auto is_dead = [this](IRVar *var) {
+        if (var == nullptr || var->def == nullptr) return false;
+        auto it = inst_block.find(var->def->belong_inst);
+        return it != inst_block.end() && !executable[it->second->block_index];
+    };
+    for (auto *block : func->blocks)
+    {
+        if (!executable[block->block_index]) continue;
+        for (auto *assign : block->phis)
+        {
+            auto *phi = as<IRPhi, IR::Tag::PHI>(assign->src());
+            for (int i = 0; i < phi->args.size();)
+            {
+                auto *var = as<IRVar, IR::Tag::VAR>(phi->args[i]);
+                if (is_dead(var) || !executable[phi->blocks[i]->block_index])
+                {
+                    forceRemoveVar(var);
+                    phi->args.erase(phi->args.begin() + i);
+                    phi->blocks.erase(phi->blocks.begin() + i);
+                }
+                else
+                    i++;
+            }
+        }
+    }
+    for (auto it = func->blocks.begin(); it != func->blocks.end();)
+    {
+        auto *block = *it;
+        if (!executable[block->block_index])
+        {
+            it = func->blocks.erase(it);
+            destroyBlock(block);
+        }
+        else
+            it++;
+    }
+    // replace constant definitions
+    for (auto *block : func->blocks)
+    {
+        for (auto *inst : block->insts)
+        {
+            auto *assign = as<IRAssign, IR::Tag::ASSIGN>(inst);
+            if (assign == nullptr || assign->dest()->is_array || assign->src()->tag == IR::Tag::CONST) continue;
+            if (!is_constant(assign->dest())) continue;
+            if (auto *var = as<IRVar, IR::Tag::VAR>(assign->src()); var != nullptr)
+            {
+                forceRemoveVar(var);
+            }
+            else if (auto *binary = as<IRBinary, IR::Tag::BINARY>(assign->src()); binary != nullptr)
+            {
+                if (!forceRemoveVar(as<IRVar, IR::Tag::VAR>(binary->lhs))) delete binary->lhs;
+                if (!forceRemoveVar(as<IRVar, IR::Tag::VAR>(binary->rhs))) delete binary->rhs;
+                delete binary;
+            }
+            auto *result  = new IRConstant;
+            result->value = lattice[assign->dest()->ssaName()].value;
+            assign->setSrc(result);
+        }
+        // x2 = phi(1, x1) where x1 is 1 -> x2 = 1
+        for (auto it = block->phis.begin(); it != block->phis.end();)
+        {
+            auto *assign = *it;
+            if (!is_constant(assign->dest()))
+            {
+                it++;
+                continue;
+            }
+            auto *phi = as<IRPhi, IR::Tag::PHI>(assign->src());
+            for (auto *arg : phi->args)
+            {
+                if (!forceRemoveVar(as<IRVar, IR::Tag::VAR>(arg))) delete arg;
+            }
+            delete phi;
+            auto *result  = new IRConstant;
+            result->value = lattice[assign->dest()->ssaName()].value;
+            auto *copy    = new IRAssign;
+            copy->setDest(assign->dest());
+            copy->setSrc(result);
+            copy->block = block;
+            block->insts.push_front(copy);
+            delete assign;
+            it = block->phis.erase(it);
+        }
+    }
+}
+
+void COMPILER::CFG::countDefinitions(COMPILER::IRFunction *func)
+{
+    def_count.clear();
+    phi_names.clear();
+    unsafe_names.clear();
+    // a param is defined by the call
+    for (auto *param : func->params)
+    {
+        def_count[param->ssaName()]++;
+    }
+    for (auto *block : func->blocks)
+    {
+        for (auto *assign : block->phis)
+        {
+            def_count[assign->dest()->ssaName()]++;
+            phi_names.insert(assign->dest()->ssaName());
+        }
+        for (auto *inst : block->insts)
+        {
+            auto *assign = as<IRAssign, IR::Tag::ASSIGN>(inst);
+            if (assign != nullptr && !assign->dest()->is_array) def_count[assign->dest()->ssaName()]++;
+            auto *call = as<IRCall, IR::Tag::CALL>(assign != nullptr ? assign->src() : inst);
+            if (call == nullptr || call->func != nullptr || !inOr(call->name, "read", "int", "double", "string"))
+                continue;
+            for (auto *arg : call->args)
+            {
+                if (auto *var = as<IRVar, IR::Tag::VAR>(arg); var != nullptr) unsafe_names.insert(var->ssaName());
+            }
+        }
+    }
+}
+
+bool COMPILER::CFG::isStableName(const std::string &name)
+{
+    return def_count[name] == 1 && unsafe_names.count(name) == 0;
+}
+
+void COMPILER::CFG::countIntegers(COMPILER::IRFunction *func)
+{
+    // assume every candidate holds an integer and drop those with an operand which may not, until nothing changes.
+    // the loop phis stay in, `i1 = phi(i0, i2)` and `i2 = i1 + 1` prove each other.
+    std::unordered_map<std::string, IR *> candidates;
+    int_names.clear();
+    for (auto *block : func->blocks)
+    {
+        for (auto *assign : block->phis)
+        {
+            candidates[assign->dest()->ssaName()] = assign->src();
+        }
+        for (auto *inst : block->insts)
+        {
+            auto *assign = as<IRAssign, IR::Tag::ASSIGN>(inst);
+            if (assign == nullptr || assign->dest()->is_array) continue;
+            auto *src    = assign->src();
+            auto *binary = as<IRBinary, IR::Tag::BINARY>(src);
+            auto *call   = as<IRCall, IR::Tag::CALL>(src);
+            auto *copy   = as<IRVar, IR::Tag::VAR>(src);
+            if ((binary != nullptr && inOr(binary->opcode, IR_ADD, IR_SUB, IR_MUL, IR_DIV, IR_MOD, IR_BAND, IR_BXOR,
+                                           IR_BOR, IR_SHL, IR_SHR)) ||
+                (call != nullptr && call->func == nullptr && call->name == "len") ||
+                (copy != nullptr && !copy->is_array) || src->tag == IR::Tag::CONST)
+                candidates[assign->dest()->ssaName()] = src;
+        }
+    }
+    for (auto &[name, src] : candidates)
+    {
+        if (isStableName(name)) int_names.insert(name);
+    }
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (auto it = int_names.begin(); it != int_names.end();)
+        {
+            auto *src = candidates[*it];
+            bool keep = false;
+            if (auto *phi = as<IRPhi, IR::Tag::PHI>(src); phi != nullptr)
+                keep = std::all_of(phi->args.begin(), phi->args.end(), [&](IR *arg) { return isInteger(arg); });
+            else if (auto *binary = as<IRBinary, IR::Tag::BINARY>(src); binary != nullptr)
+                keep = isInteger(binary->lhs) && isInteger(binary->rhs);
+            else if (src->tag == IR::Tag::CALL)
+                keep = true;
+            else
+                keep = isInteger(src);
+            if (keep)
+            {
+                it++;
+                continue;
+            }
+            it      = int_names.erase(it);
+            changed = true;
+        }
+    }
+}
+
+bool COMPILER::CFG::isInteger(COMPILER::IR *ir)
+{
+    if (auto *constant = as<IRConstant, IR::Tag::CONST>(ir); constant != nullptr)
+        return constant->value.is<long long>();
+    auto *var = as<IRVar, IR::Tag::VAR>(ir);
+    return var != nullptr && !var->is_array && int_names.count(var->ssaName()) != 0;
+}
+
+void COMPILER::CFG::globalValueNumbering(COMPILER::IRFunction *func)
+{
+    // SCCP may have removed blocks
+    buildDominateTree(func);
+    countDefinitions(func);
+    gvn_available.clear();
+    gvnVisitBlock(func->blocks.front());
+}
+
+void COMPILER::CFG::gvnVisitBlock(COMPILER::BasicBlock *block)
+{
+    gvn_local.clear();
+    gvn_memory.clear();
+    std::vector<std::string> scoped_keys;
+    for (auto *inst : block->insts)
+    {
+        auto *assign = as<IRAssign, IR::Tag::ASSIGN>(inst);
+        if (assign == nullptr)
+        {
+            // the callee may write to any array
+            if (inst->tag == IR::Tag::CALL) gvn_memory.clear();
+            continue;
+        }
+        // a[i] = x, arrays may alias each other
+        if (assign->dest()->is_array || assign->src()->tag == IR::Tag::CALL)
+        {
+            gvn_memory.clear();
+            continue;
+        }
+        // plain copies and constants are left to constant / copy propagation
+        auto *src_var = as<IRVar, IR::Tag::VAR>(assign->src());
+        if (assign->src()->tag != IR::Tag::BINARY && (src_var == nullptr || !src_var->is_array)) continue;
+        bool local  = false;
+        bool memory = false;
+        auto key    = gvnKey(assign->src(), local, memory);
+        if (key.empty()) continue;
+        auto &table = memory ? gvn_memory : (local ? gvn_local : gvn_available);
+        if (auto it = table.find(key); it != table.end())
+        {
+            gvnReplace(assign, it->second);
+            continue;
+        }
+        auto *dest = assign->dest();
+        if (!isStableName(dest->ssaName())) continue;
+        table[key] = dest;
+        if (&table == &gvn_available) scoped_keys.push_back(key);
+    }
+    for (auto *child : tree[block->block_index])
+    {
+        gvnVisitBlock(child);
+    }
+    for (const auto &key : scoped_keys)
+    {
+        gvn_available.erase(key);
+    }
+}
+
+std::string COMPILER::CFG::gvnKey(COMPILER::IR *ir, bool &local, bool &memory)
+{
+    // returns an empty string if the value can't be numbered.
+    if (ir == nullptr) return "";
+    if (auto *constant = as<IRConstant, IR::Tag::CONST>(ir); constant != nullptr) return constant->toString();
+    if (auto *var = as<IRVar, IR::Tag::VAR>(ir); var != nullptr)
+    {
+        auto name = var->ssaName();
+        if (!isStableName(name)) return "";
+        if (phi_names.count(name) != 0) local = true; // a phi result, only reused within its block
+        if (!var->is_array) return name;
+        if (var->index.empty()) return "";
+        memory = true;
+        for (auto *idx : var->index)
+        {
+            auto idx_key = gvnKey(idx, local, memory);
+            if (idx_key.empty()) return "";
+            name += "[" + idx_key + "]";
+        }
+        return name;
+    }
+    auto *binary = as<IRBinary, IR::Tag::BINARY>(ir);
+    // unary expr, self add / sub
+    if (binary == nullptr || binary->lhs == nullptr || binary->rhs == nullptr) return "";
+    auto lhs = gvnKey(binary->lhs, local, memory);
+    auto rhs = gvnKey(binary->rhs, local, memory);
+    if (lhs.empty() || rhs.empty()) return "";
+    // `+` concatenates strings, it is not commutative
+    if (inOr(binary->opcode, IR_MUL, IR_BAND, IR_BOR, IR_BXOR, IR_EQ, IR_NE, IR_LAND, IR_LOR) && rhs < lhs)
+        std::swap(lhs, rhs);
+    return "(" + lhs + " " + opcode_str[binary->opcode].opcode_str + " " + rhs + ")";
+}
+
+void COMPILER::CFG::gvnReplace(COMPILER::IRAssign *assign, COMPILER::IRVar *available)
+{
+    // t2 = a1 + b1 -> t2 = t1
+    if (auto *var = as<IRVar, IR::Tag::VAR>(assign->src()); var != nullptr)
+    {
+        for (auto *idx : var->index)
+        {
+            if (!forceRemoveVar(as<IRVar, IR::Tag::VAR>(idx))) delete idx;
+        }
+        forceRemoveVar(var);
+    }
+    else if (auto *binary = as<IRBinary, IR::Tag::BINARY>(assign->src()); binary != nullptr)
+    {
+        if (!forceRemoveVar(as<IRVar, IR::Tag::VAR>(binary->lhs))) delete binary->lhs;
+        if (!forceRemoveVar(as<IRVar, IR::Tag::VAR>(binary->rhs))) delete binary->rhs;
+        delete binary;
+    }
+    auto *copy      = new IRVar;
+    copy->name      = available->name;
+    copy->ssa_index = available->ssa_index;
+    copy->is_ir_gen = available->is_ir_gen;
+    copy->def       = available;
+    available->addUse(copy);
+    assign->setSrc(copy);
+}
+
+bool COMPILER::CFG::dominates(COMPILER::BasicBlock *a, COMPILER::BasicBlock *b) const
+{
+    if (rpo_number[b->block_index] == -1) return false;
+    for (int runner = b->block_index; runner != -1; runner = idom[runner])
+    {
+        if (runner == a->block_index) return true;
+    }
+    return false;
+}
+
+void COMPILER::CFG::findLoops()
+{
+    // every back edge `latch -> header` (header dominates latch) spans a natural loop,
+    // back edges to the same header share one loop.
+    loops.clear();
+    std::vector<int> header_loop(index_block.size(), -1);
+    for (auto *block : rpo)
+    {
+        for (auto *succ : block->succs)
+        {
+            if (!dominates(succ, block)) continue;
+            if (header_loop[succ->block_index] == -1)
+            {
+                header_loop[succ->block_index] = loops.size();
+                loops.emplace_back();
+                loops.back().header = succ;
+                loops.back().body.assign(index_block.size(), false);
+                loops.back().body[succ->block_index] = true;
+            }
+            auto &loop = loops[header_loop[succ->block_index]];
+            loop.latches.push_back(block);
+            // walk backwards from the latch until the header
+            std::vector<BasicBlock *> work_list{ block };
+            while (!work_list.empty())
+            {
+                auto *cur = work_list.back();
+                work_list.pop_back();
+                if (loop.body[cur->block_index] || rpo_number[cur->block_index] == -1) continue;
+                loop.body[cur->block_index] = true;
+                work_list.insert(work_list.end(), cur->pres.begin(), cur->pres.end());
+            }
+        }
+    }
+    for (auto &loop : loops)
+    {
+        for (auto *block : rpo)
+        {
+            if (loop.body[block->block_index]) loop.blocks.push_back(block);
+        }
+    }
+    // innermost first, then an enclosing loop is always found after the loop itself
+    std::stable_sort(loops.begin(), loops.end(),
+                     [](const Loop &a, const Loop &b) { return a.blocks.size() < b.blocks.size(); });
+    for (int i = 0; i < loops.size(); i++)
+    {
+        for (int j = i + 1; j < loops.size() && loops[i].parent == -1; j++)
+        {
+            if (loops[j].body[loops[i].header->block_index] && loops[j].header != loops[i].header) loops[i].parent = j;
+        }
+    }
+    for (int i = loops.size() - 1; i >= 0; i--)
+    {
+        if (loops[i].parent != -1) loops[i].depth = loops[loops[i].parent].depth + 1;
+    }
+    for (auto &loop : loops)
+    {
+        std::vector<BasicBlock *> outside;
+        for (auto *pre : loop.header->pres)
+        {
+            if (!loop.body[pre->block_index]) outside.push_back(pre);
+        }
+        if (outside.size() == 1 && outside.front()->succs.size() == 1) loop.preheader = outside.front();
+    }
+}
+
+bool COMPILER::CFG::insertPreheaders(COMPILER::IRFunction *func)
+{
+    // give every loop a block which runs once right before it, returns true if the cfg changed.
+    bool changed = false;
+    for (auto &loop : loops)
+    {
+        if (loop.preheader != nullptr) continue;
+        auto *header    = loop.header;
+        auto *preheader = new BasicBlock(header->name + "_preheader");
+        for (auto *pre : std::vector<BasicBlock *>(header->pres.begin(), header->pres.end()))
+        {
+            if (loop.body[pre->block_index]) continue;
+            pre->succs.erase(header);
+            header->pres.erase(pre);
+            pre->addSucc(preheader);
+            preheader->addPre(pre);
+            if (pre->insts.empty()) continue;
+            if (auto *branch = as<IRBranch, IR::Tag::BRANCH>(pre->insts.back()); branch != nullptr)
+            {
+                if (branch->true_block == header) branch->true_block = preheader;
+                if (branch->false_block == header) branch->false_block = preheader;
+            }
+            else if (auto *inst = as<IRSwitch, IR::Tag::SWITCH>(pre->insts.back()); inst != nullptr)
+            {
+                inst->replaceTarget(header, preheader);
+            }
+            else if (auto *jump = as<IRJump, IR::Tag::JMP>(pre->insts.back()); jump != nullptr)
+            {
+                if (jump->target == header) jump->target = preheader;
+            }
+        }
+        preheader->addSucc(header);
+        header->addPre(preheader);
+        // the values coming from outside arrive through the preheader now, several of them are merged there
+        for (auto *assign : header->phis)
+        {
+            auto *phi = as<IRPhi, IR::Tag::PHI>(assign->src());
+            std::vector<int> outside;
+            for (int i = 0; i < phi->blocks.size(); i++)
+            {
+                if (!loop.body[phi->blocks[i]->block_index]) outside.push_back(i);
+            }
+            if (outside.size() == 1) phi->blocks[outside.front()] = preheader;
+            if (outside.size() <= 1) continue;
+            auto *merge     = new IRPhi;
+            auto *dest      = new IRVar;
+            dest->name      = assign->dest()->name;
+            dest->ssa_index = counter[dest->name]++;
+            for (auto it = outside.rbegin(); it != outside.rend(); it++)
+            {
+                merge->args.insert(merge->args.begin(), phi->args[*it]);
+                merge->blocks.insert(merge->blocks.begin(), phi->blocks[*it]);
+                phi->args.erase(phi->args.begin() + *it);
+                phi->blocks.erase(phi->blocks.begin() + *it);
+            }
+            auto *merge_assign = new IRAssign;
+            merge_assign->setDest(dest);
+            merge_assign->setSrc(merge);
+            merge_assign->block = preheader;
+            preheader->phis.push_back(merge_assign);
+            auto *arg        = new IRVar;
+            arg->name        = dest->name;
+            arg->ssa_index   = dest->ssa_index;
+            arg->def         = dest;
+            arg->belong_inst = assign;
+            dest->addUse(arg);
+            phi->args.push_back(arg);
+            phi->blocks.push_back(preheader);
+        }
+        // the block in front of the header falls through into the preheader now,
+        // a latch which used to fall through into the header needs a jump.
+        auto pos = std::find(func->blocks.begin(), func->blocks.end(), header);
+        if (pos != func->blocks.begin())
+        {
+            auto *prev = *std::prev(pos);
+            if (loop.body[prev->block_index] && prev->succs.count(header) != 0 &&
+                (prev->insts.empty() ||
+                 !inOr(prev->insts.back()->tag, IR::Tag::JMP, IR::Tag::BRANCH, IR::Tag::SWITCH, IR::Tag::RETURN)))
+            {
+                auto *jump   = new IRJump;
+                jump->target = header;
+                jump->block  = prev;
+                prev->addInst(jump);
+            }
+        }
+        func->blocks.insert(pos, preheader);
+        changed = true;
+    }
+    return changed;
+}
+
+void COMPILER::CFG::loopInvariantCodeMotion(COMPILER::IRFunction *func)
+{
+    buildDominateTree(func);
+    findLoops();
+    if (insertPreheaders(func))
+    {
+        buildDominateTree(func);
+        findLoops();
+    }
+    countDefinitions(func);
+    countIntegers(func);
+    for (auto &loop : loops)
+    {
+        licmHoist(loop);
+    }
+}
+
+void COMPILER::CFG::licmHoist(Loop &loop)
+{
+    // names whose value may change inside the loop
+    std::unordered_set<std::string> variant;
+    for (auto *block : loop.blocks)
+    {
+        for (auto *assign : block->phis)
+        {
+            variant.insert(assign->dest()->ssaName());
+        }
+        for (auto *inst : block->insts)
+        {
+            if (auto *assign = as<IRAssign, IR::Tag::ASSIGN>(inst); assign != nullptr)
+                variant.insert(assign->dest()->ssaName());
+        }
+    }
+    auto invariant = [&](IR *ir) {
+        if (ir == nullptr) return false;
+        if (ir->tag == IR::Tag::CONST) return true;
+        auto *var = as<IRVar, IR::Tag::VAR>(ir);
+        if (var == nullptr || var->is_array) return false;
+        // phi elimination assigns a phi result only at the start of its block, the loop's own phis are variant
+        auto name = var->ssaName();
+        return isStableName(name) && variant.count(name) == 0;
+    };
+    auto *preheader = loop.preheader;
+    bool changed    = true;
+    while (changed)
+    {
+        changed = false;
+        for (auto *block : loop.blocks)
+        {
+            // the preheader always runs the header, the loop test included, so whatever the header computes
+            // before its first call fails there anyway. the rest of the body may not run at all, an operation
+            // moved out of it must not fail, e.g. `"ab" - 1` in a loop which is never entered.
+            bool in_header       = block == loop.header;
+            bool every_iteration = std::all_of(loop.latches.begin(), loop.latches.end(),
+                                               [&](BasicBlock *latch) { return dominates(block, latch); });
+            if (!every_iteration) continue;
+            for (auto it = block->insts.begin(); it != block->insts.end();)
+            {
+                auto *assign = as<IRAssign, IR::Tag::ASSIGN>(*it);
+                auto *call   = as<IRCall, IR::Tag::CALL>(assign != nullptr ? assign->src() : *it);
+                if (in_header && call != nullptr && (call->func != nullptr || call->name != "len")) break;
+                bool hoist = false;
+                if (assign != nullptr && !assign->dest()->is_array && isStableName(assign->dest()->ssaName()))
+                {
+                    auto *src    = assign->src();
+                    auto *binary = as<IRBinary, IR::Tag::BINARY>(src);
+                    if (binary != nullptr)
+                    {
+                        // an integer divided by zero is the only integer operation which fails
+                        auto *divisor = as<IRConstant, IR::Tag::CONST>(binary->rhs);
+                        bool can_fail = !isInteger(binary->lhs) || !isInteger(binary->rhs) ||
+                                        binary->opcode == IR_EXP ||
+                                        (inOr(binary->opcode, IR_DIV, IR_MOD) &&
+                                         (divisor == nullptr || divisor->value.as<double>() == 0));
+                        hoist = invariant(binary->lhs) && invariant(binary->rhs) && (in_header || !can_fail);
+                    }
+                    else if (call != nullptr)
+                    {
+                        // len(arr), arrays are values, `arr` stays the same as long as its ssa name does
+                        hoist = in_header && call->func == nullptr && call->name == "len" && call->args.size() == 1 &&
+                                invariant(call->args.front());
+                    }
+                    else
+                    {
+                        hoist = invariant(src);
+                    }
+                }
+                if (!hoist)
+                {
+                    it++;
+                    continue;
+                }
+                variant.erase(assign->dest()->ssaName());
+                it            = block->insts.erase(it);
+                assign->block = preheader;
+                if (!preheader->insts.empty() &&
+                    inOr(preheader->insts.back()->tag, IR::Tag::JMP, IR::Tag::BRANCH, IR::Tag::SWITCH, IR::Tag::RETURN))
+                    preheader->addInstBefore(assign, preheader->insts.back());
+                else
+                    preheader->addInst(assign);
+                changed = true;
+            }
+        }
+    }
+}
+
+void COMPILER::CFG::inductionVariables(COMPILER::IRFunction *func)
+{
+    buildDominateTree(func);
+    findLoops();
+    countDefinitions(func);
+    countIntegers(func);
+    iv_def.clear();
+    iv_non_negative.clear();
+    inst_block.clear();
+    for (auto *block : rpo)
+    {
+        for (auto *assign : block->phis)
+        {
+            iv_def[assign->dest()->ssaName()] = assign;
+            inst_block[assign]                = block;
+        }
+        for (auto *inst : block->insts)
+        {
+            auto *assign = as<IRAssign, IR::Tag::ASSIGN>(inst);
+            if (assign == nullptr || assign->dest()->is_array) continue;
+            iv_def[assign->dest()->ssaName()] = assign;
+            inst_block[assign]                = block;
+        }
+    }
+    // outermost first, a loop may start from the counter of an enclosing one
+    for (auto it = loops.rbegin(); it != loops.rend(); it++)
+    {
+        ivVisitLoop(*it);
+    }
+}
+
+void COMPILER::CFG::ivVisitLoop(Loop &loop)
+{
+    // i1 = phi(i0, i2), i0 comes from outside, i2 = i1 + c is computed by the only latch,
+    // which jumps back to the header right away.
+    if (loop.latches.size() != 1) return;
+    auto *latch = loop.latches.front();
+    if (latch->succs.size() != 1) return;
+    for (auto *phi_assign : loop.header->phis)
+    {
+        auto *phi = as<IRPhi, IR::Tag::PHI>(phi_assign->src());
+        auto name = phi_assign->dest()->ssaName();
+        if (phi->args.size() != 2 || !isStableName(name)) continue;
+        IRAssign *step = nullptr;
+        IRVar *init    = nullptr;
+        for (auto *arg : phi->args)
+        {
+            auto *var = as<IRVar, IR::Tag::VAR>(arg);
+            if (var == nullptr || !isStableName(var->ssaName())) break;
+            // a param has no defining instruction, it comes from outside
+            auto *block = iv_def.count(var->ssaName()) != 0 ? inst_block[iv_def[var->ssaName()]] : nullptr;
+            if (block == nullptr || !loop.body[block->block_index])
+                init = var;
+            else if (block == latch)
+                step = iv_def[var->ssaName()];
+        }
+        if (init == nullptr || step == nullptr) continue;
+        auto *binary = as<IRBinary, IR::Tag::BINARY>(step->src());
+        auto *lhs    = binary != nullptr ? as<IRVar, IR::Tag::VAR>(binary->lhs) : nullptr;
+        auto *rhs    = binary != nullptr ? as<IRConstant, IR::Tag::CONST>(binary->rhs) : nullptr;
+        if (lhs == nullptr || rhs == nullptr || lhs->ssaName() != name || !rhs->value.is<long long>() ||
+            !inOr(binary->opcode, IR_ADD, IR_SUB))
+            continue;
+        // an integer plus an integer constant stays an integer
+        if (!isInteger(init)) continue;
+        binary->is_int = true;
+
+        // bounds: only counting up from a non-negative start, while `i < len(arr)` holds
+        const auto delta = binary->opcode == IR_ADD ? rhs->value.as<long long>() : -rhs->value.as<long long>();
+        if (delta <= 0 || !ivNonNegative(init)) continue;
+        iv_non_negative.insert(name);
+        if (loop.header->insts.empty()) continue;
+        auto *branch = as<IRBranch, IR::Tag::BRANCH>(loop.header->insts.back());
+        if (branch == nullptr || branch->cond == nullptr || !isStableName(branch->cond->ssaName()) ||
+            iv_def.count(branch->cond->ssaName()) == 0)
+            continue;
+        auto *body = branch->true_block;
+        if (!loop.body[body->block_index] || loop.body[branch->false_block->block_index] || body->pres.size() != 1)
+            continue;
+        auto *cmp = as<IRBinary, IR::Tag::BINARY>(iv_def[branch->cond->ssaName()]->src());
+        if (cmp == nullptr || !inOr(cmp->opcode, IR_LT, IR_GT)) continue;
+        auto *index = as<IRVar, IR::Tag::VAR>(cmp->opcode == IR_LT ? cmp->lhs : cmp->rhs);
+        auto *array = ivLengthOf(cmp->opcode == IR_LT ? cmp->rhs : cmp->lhs);
+        if (index == nullptr || array == nullptr || index->ssaName() != name) continue;
+        for (auto *block : loop.blocks)
+        {
+            if (!dominates(body, block)) continue;
+            for (auto *inst : block->insts)
+            {
+                ivMarkInBounds(inst, array->ssaName(), name);
+            }
+        }
+    }
+}
+
+std::optional<long long> COMPILER::CFG::ivIntConstant(COMPILER::IR *ir)
+{
+    while (ir != nullptr)
+    {
+        if (auto *constant = as<IRConstant, IR::Tag::CONST>(ir); constant != nullptr)
+        {
+            if (constant->value.is<long long>()) return constant->value.as<long long>();
+            return std::nullopt;
+        }
+        auto *var = as<IRVar, IR::Tag::VAR>(ir);
+        if (var == nullptr || var->is_array || !isStableName(var->ssaName()) || iv_def.count(var->ssaName()) == 0)
+            return std::nullopt;
+        ir = iv_def[var->ssaName()]->src();
+    }
+    return std::nullopt;
+}
+
+bool COMPILER::CFG::ivNonNegative(COMPILER::IR *ir)
+{
+    // a constant, `len(arr)`, the counter of an enclosing loop, or a sum or product of them
+    if (auto constant = ivIntConstant(ir); constant.has_value()) return constant.value() >= 0;
+    auto *var = as<IRVar, IR::Tag::VAR>(ir);
+    if (var == nullptr || !isInteger(var)) return false;
+    if (iv_non_negative.count(var->ssaName()) != 0) return true;
+    if (iv_def.count(var->ssaName()) == 0) return false;
+    auto *src = iv_def[var->ssaName()]->src();
+    if (auto *call = as<IRCall, IR::Tag::CALL>(src); call != nullptr)
+        return call->func == nullptr && call->name == "len";
+    if (auto *binary = as<IRBinary, IR::Tag::BINARY>(src); binary != nullptr)
+        return inOr(binary->opcode, IR_ADD, IR_MUL) && ivNonNegative(binary->lhs) && ivNonNegative(binary->rhs);
+    return src->tag == IR::Tag::VAR && ivNonNegative(src);
+}
+
+COMPILER::IRVar *COMPILER::CFG::ivLengthOf(COMPILER::IR *ir)
+{
+    // n = len(arr), or a copy of it
+    while (ir != nullptr)
+    {
+        auto *var = as<IRVar, IR::Tag::VAR>(ir);
+        if (var == nullptr || var->is_array || !isStableName(var->ssaName()) || iv_def.count(var->ssaName()) == 0)
+            return nullptr;
+        ir = iv_def[var->ssaName()]->src();
+        auto *call = as<IRCall, IR::Tag::CALL>(ir);
+        if (call == nullptr) continue;
+        if (call->func != nullptr || call->name != "len" || call->args.size() != 1) return nullptr;
+        // the length of an array never changes unless the array itself is redefined
+        auto *array = as<IRVar, IR::Tag::VAR>(call->args.front());
+        if (array == nullptr || array->is_array || unsafe_names.count(array->ssaName()) != 0) return nullptr;
+        return isStableName(array->ssaName()) ? array : nullptr;
+    }
+    return nullptr;
+}
+
+void COMPILER::CFG::ivMarkInBounds(COMPILER::IR *ir, const std::string &array, const std::string &iv)
+{
+    if (auto *assign = as<IRAssign, IR::Tag::ASSIGN>(ir); assign != nullptr)
+    {
+        ivMarkInBounds(assign->dest(), array, iv);
+        ivMarkInBounds(assign->src(), array, iv);
+    }
+    else if (auto *binary = as<IRBinary, IR::Tag::BINARY>(ir); binary != nullptr)
+    {
+        ivMarkInBounds(binary->lhs, array, iv);
+        ivMarkInBounds(binary->rhs, array, iv);
+    }
+    else if (auto *var = as<IRVar, IR::Tag::VAR>(ir); var != nullptr)
+    {
+        if (!var->is_array || var->index.size() != 1 || var->ssaName() != array) return;
+        auto *index = as<IRVar, IR::Tag::VAR>(var->index.front());
+        if (index != nullptr && index->ssaName() == iv) var->in_bounds = true;
+    }
+}
+
+void COMPILER::CFG::destroyPhiNode(COMPILER::IRAssign *assign)
+{
+    delete assign->dest();
+    auto *phi = as<IRPhi, IR::Tag::PHI>(assign->src());
+    for (auto *tmp : phi->args)
+    {
+        auto *var = as<IRVar, IR::Tag::VAR>(tmp);
+        if (var->def) var->def->killUse(var);
+        delete var;
+    }
+    delete phi;
+    delete assign;
+}
+
+void COMPILER::CFG::phiElimination(COMPILER::IRFunction *func)
+{
+    // x2 = phi(x0 from L1, x1 from L2) becomes
+    // L1: x2.phi = x0    L2: x2.phi = x1    and    x2 = x2.phi    at the start of the phi's block.
+    // every arg is read at the end of its predecessor, before any phi result is written,
+    // so a phi result which is still live after the edge (lost copy) and phis reading each other (swap) are fine.
+    for (auto *block : func->blocks)
+    {
+        for (auto it = block->phis.rbegin(); it != block->phis.rend(); it++)
+        {
+            auto *assign    = *it;
+            auto *phi       = as<IRPhi, IR::Tag::PHI>(assign->src());
+            auto *dest      = assign->dest();
+            auto *copy      = new IRVar;
+            copy->name      = dest->name + ".phi";
+            copy->ssa_index = dest->ssa_index;
+            for (int i = 0; i < phi->args.size(); i++)
+            {
+                auto *new_assign = new IRAssign;
+                if (i != 0)
+                {
+                    auto *new_var      = new IRVar;
+                    new_var->name      = copy->name;
+                    new_var->ssa_index = copy->ssa_index;
+                    new_var->def       = copy;
+                    copy->addUse(new_var);
+                    new_assign->setDest(new_var);
+                }
+                else
+                {
+                    new_assign->setDest(copy);
+                }
+                new_assign->setSrc(phi->args[i]);
+                auto *insert_block = phi->blocks[i];
+                new_assign->block  = insert_block;
+                // avoid insert as following code
+                // jmp L1
+                // x1 = x2
+                if (!insert_block->insts.empty() &&
+                    inOr(insert_block->insts.back()->tag, IR::Tag::JMP, IR::Tag::BRANCH, IR::Tag::SWITCH))
+                {
+                    insert_block->addInstBefore(new_assign, insert_block->insts.back());
+                }
+                else
+                {
+                    insert_block->addInst(new_assign);
+                }
+            }
+            auto *src      = new IRVar;
+            src->name      = copy->name;
+            src->ssa_index = copy->ssa_index;
+            src->def       = copy;
+            copy->addUse(src);
+            auto *result = new IRAssign;
+            result->setDest(dest);
+            result->setSrc(src);
+            result->block = block;
+            block->insts.push_front(result);
+            delete phi;
+            delete assign;
+        }
+        // remove all phi functions.
+        block->phis.clear();
+    }
+}
+
+void COMPILER::CFG::deadCodeElimination(COMPILER::IRFunction *func)
+{
+    // MAGIC
+    for (auto block_it = func->blocks.crbegin(); block_it != func->blocks.crend(); block_it++)
+    {
+        auto *block = *block_it;
+        for (auto inst_it = block->insts.rbegin(); inst_it != block->insts.rend();)
+        {
+            auto *tmp    = *inst_it;
+            auto *assign = as<IRAssign, IR::Tag::ASSIGN>(tmp);
+            // a = b + c
+            // no user! remove this instruction!
+            if (assign != nullptr && !assign->dest()->is_array && assign->dest()->use.empty())
+            {
+                if (assign->dest()->def != nullptr && assign->dest()->def->ssaName() == assign->dest()->ssaName())
+                {
+                    inst_it++;
+                    continue;
+                }
+                // call
+                auto *call = as<IRCall, IR::Tag::CALL>(assign->src());
+                if (call != nullptr)
+                {
+                    // non-retval. remove temp var.
+                    delete tmp;
+                    *inst_it = call;
+                    inst_it++;
+                    continue;
+                }
+                auto *var = as<IRVar, IR::Tag::VAR>(assign->src());
+                if (var != nullptr)
+                {
+                    var->def->killUse(var);
+                    delete var;
+                }
+                //
+                auto *binary = as<IRBinary, IR::Tag::BINARY>(assign->src());
+                if (binary != nullptr)
+                {
+                    auto *lhs_var   = as<IRVar, IR::Tag::VAR>(binary->lhs);
+                    auto *lhs_const = as<IRConstant, IR::Tag::CONST>(binary->lhs);
+                    auto *rhs_var   = as<IRVar, IR::Tag::VAR>(binary->rhs);
+                    auto *rhs_const = as<IRConstant, IR::Tag::CONST>(binary->rhs);
+                    if (lhs_var != nullptr) lhs_var->def->killUse(lhs_var);
+                    if (rhs_var != nullptr) rhs_var->def->killUse(rhs_var);
+                    //
+                    delete lhs_var;
+                    delete rhs_var;
+                    delete lhs_const;
+                    delete rhs_const;
+                    delete binary;
+                }
+                delete assign;
+                // remove it from list
+                block->insts.erase(--inst_it.base());
+            }
+            else
+            {
+                inst_it++;
+            }
+        }
+    }
+}
+
+void COMPILER::CFG::deadStoreElimination()
+{
+    for (auto *func : funcs)
+    {
+        deadStoreElimination(func);
+    }
+}
+
+void COMPILER::CFG::deadStoreElimination(COMPILER::IRFunction *func)
+{
+    dse_globals.clear();
+    if (global_vars != nullptr)
+    {
+        for (auto *inst : global_vars->insts)
+        {
+            if (auto *assign = as<IRAssign, IR::Tag::ASSIGN>(inst); assign != nullptr)
+                dse_globals.insert(assign->dest()->name);
+        }
+    }
+    for (auto *param : func->params)
+    {
+        dse_globals.erase(param->name);
+    }
+    for (auto *block : func->blocks)
+    {
+        dseVisitBlock(block);
+    }
+}
+
+void COMPILER::CFG::dseVisitBlock(COMPILER::BasicBlock *block)
+{
+    dse_pending.clear();
+    dse_read_after.clear();
+    dse_orphans.clear();
+    // locals die with the frame
+    const bool at_exit = !block->insts.empty() && block->insts.back()->tag == IR::Tag::RETURN;
+    for (auto it = block->insts.end(); it != block->insts.begin();)
+    {
+        auto *inst   = *--it;
+        auto *assign = as<IRAssign, IR::Tag::ASSIGN>(inst);
+        auto *call   = as<IRCall, IR::Tag::CALL>(assign != nullptr ? assign->src() : inst);
+        std::vector<IRVar *> reads;
+        if (assign != nullptr)
+        {
+            CallGraph::collectVars(assign->src(), reads);
+            for (auto *idx : assign->dest()->index)
+            {
+                CallGraph::collectVars(idx, reads);
+            }
+        }
+        else
+            CallGraph::collectVars(inst, reads);
+
+        if (assign != nullptr && call == nullptr && dseIsDead(assign, at_exit))
+        {
+            for (auto *var : reads)
+            {
+                if (var->def == nullptr) continue;
+                var->def->killUse(var);
+                if (var->def->is_ir_gen && var->def->use.empty()) dse_orphans.insert(var->def);
+            }
+            // dropped like unreachable instructions, def-use chains may still point at them
+            it = block->insts.erase(it);
+            continue;
+        }
+        // executed backwards, the value is read before it is written
+        if (assign != nullptr) dseWrite(assign->dest());
+        for (auto *var : reads)
+        {
+            dseRead(var);
+        }
+        // user functions may read any global, so may the ones `parallel_map` runs
+        if (call != nullptr && (call->func != nullptr || call->name == "parallel_map"))
+        {
+            for (const auto &name : dse_globals)
+            {
+                dse_pending.erase(name);
+                dse_read_after.insert(name);
+            }
+        }
+    }
+}
+
+bool COMPILER::CFG::dseIsDead(COMPILER::IRAssign *assign, bool at_exit)
+{
+    auto *dest = assign->dest();
+    if (dse_orphans.count(dest) != 0) return true;
+    if (dest->is_ir_gen) return false;
+    // the first definition of a name is the one its uses point at
+    if (!dest->is_array && (dest->def == nullptr || !dest->use.empty())) return false;
+    const auto location = dseLocation(dest);
+    if (!location.has_value()) return false;
+    if (at_exit && dse_globals.count(dest->name) == 0 && dse_read_after.count(dest->name) == 0) return true;
+    auto it = dse_pending.find(dest->name);
+    if (it == dse_pending.end()) return false;
+    return std::any_of(it->second.begin(), it->second.end(), [&location](const std::vector<std::string> &that) {
+        return that.empty() || that == *location;
+    });
+}
+
+void COMPILER::CFG::dseWrite(COMPILER::IRVar *dest)
+{
+    if (dest->is_ir_gen) return;
+    if (!dest->is_array)
+    {
+        // an index variable gets another value, the locations computed from it are unknown before this point
+        const auto key = "v" + dest->name;
+        for (auto &[name, locations] : dse_pending)
+        {
+            locations.erase(std::remove_if(locations.begin(), locations.end(),
+                                           [&key](const std::vector<std::string> &location) {
+                                               return std::find(location.begin(), location.end(), key) !=
+                                                      location.end();
+                                           }),
+                            locations.end());
+        }
+    }
+    if (auto location = dseLocation(dest); location.has_value()) dse_pending[dest->name].push_back(*location);
+}
+
+void COMPILER::CFG::dseRead(COMPILER::IRVar *var)
+{
+    dse_read_after.insert(var->name);
+    auto it = dse_pending.find(var->name);
+    if (it == dse_pending.end()) return;
+    const auto location = dseLocation(var);
+    if (!var->is_array || !location.has_value())
+    {
+        dse_pending.erase(it);
+        return;
+    }
+    // two locations may be the same element unless they differ in a constant index
+    auto may_alias = [&location](const std::vector<std::string> &that) {
+        for (int i = 0; i < std::min(that.size(), location->size()); i++)
+        {
+            if (that[i][0] == 'c' && (*location)[i][0] == 'c' && that[i] != (*location)[i]) return false;
+        }
+        return true;
+    };
+    auto &locations = it->second;
+    locations.erase(std::remove_if(locations.begin(), locations.end(), may_alias), locations.end());
+}
+
+std::optional<std::vector<std::string>> COMPILER::CFG::dseLocation(COMPILER::IRVar *var)
+{
+    std::vector<std::string> location;
+    for (auto *idx : var->index)
+    {
+        auto *constant = as<IRConstant, IR::Tag::CONST>(idx);
+        auto *index    = as<IRVar, IR::Tag::VAR>(idx);
+        std::string key;
+        if (constant != nullptr && constant->value.appendKey(key))
+            location.push_back("c" + key);
+        else if (index != nullptr && !index->is_array)
+            location.push_back("v" + index->name);
+        else
+            return std::nullopt;
+    }
+    return location;
+}
+
+void COMPILER::CFG::tryRename(COMPILER::IRFunction *func)
+{
+    for (const auto &p : var_block_map)
+    {
+        counter[p.first] = 0;
+    }
+    // params are defined on entry
+    for (auto *param : func->params)
+    {
+        param->ssa_index              = newId(param->name, param);
+        ssa_def_map[param->ssaName()] = param;
+    }
+    rename(func->blocks.front());
+}
+
+void COMPILER::CFG::rename(COMPILER::BasicBlock *block)
+{
+    for (auto *phi : block->phis)
+    {
+        auto *lhs                   = phi->dest();
+        lhs->ssa_index              = newId(lhs->name, lhs);
         ssa_def_map[lhs->ssaName()] = lhs;
     }
     for (auto *inst : block->insts)
@@ -698,9 +2125,10 @@ void COMPILER::CFG::rename(COMPILER::BasicBlock *block)
             arg->def = dynamic_cast<IRVar *>(def);
             if (def != nullptr) def->addUse(arg);
             src->args.push_back(arg);
+            src->blocks.push_back(block);
         }
     }
-    for (auto *succ : tree[block])
+    for (auto *succ : tree[block->block_index])
     {
         rename(succ);
     }
@@ -709,6 +2137,7 @@ void COMPILER::CFG::rename(COMPILER::BasicBlock *block)
         if (inst->tag == IR::Tag::ASSIGN)
         {
             auto *assign = as<IRAssign, IR::Tag::ASSIGN>(inst);
+            if (assign->dest()->is_array) continue;
             if (!stack[assign->dest()->name].empty()) stack[assign->dest()->name].pop();
         }
     }
@@ -734,9 +2163,25 @@ void COMPILER::CFG::renameIrArgs(COMPILER::IR *inst)
         renameVar(var);
         return;
     }
+    if (auto *ret = as<IRReturn, IR::Tag::RETURN>(inst); ret != nullptr)
+    {
+        renameIrArgs(ret->ret);
+        return;
+    }
+    if (auto *branch = as<IRBranch, IR::Tag::BRANCH>(inst); branch != nullptr)
+    {
+        renameVar(branch->cond);
+        return;
+    }
+    if (auto *inst_switch = as<IRSwitch, IR::Tag::SWITCH>(inst); inst_switch != nullptr)
+    {
+        renameVar(inst_switch->cond);
+        return;
+    }
     if (assign == nullptr) return;
     // try type cast
     auto *binary = as<IRBinary, IR::Tag::BINARY>(assign->src());
+    auto *array  = as<IRArray, IR::Tag::ARRAY>(assign->src());
     var          = as<IRVar, IR::Tag::VAR>(assign->src());
     func_call    = as<IRCall, IR::Tag ::CALL>(assign->src());
     // rename src!
@@ -747,6 +2192,13 @@ void COMPILER::CFG::renameIrArgs(COMPILER::IR *inst)
         renameVar(src_lhs);
         renameVar(src_rhs);
     }
+    if (array != nullptr)
+    {
+        for (auto *x : array->content)
+        {
+            renameIrArgs(x);
+        }
+    }
     if (var != nullptr)
     {
         renameVar(var);
@@ -757,6 +2209,12 @@ void COMPILER::CFG::renameIrArgs(COMPILER::IR *inst)
     }
     // rename dest
     if (assign->dest()->def == nullptr && assign->dest()->is_ir_gen) return;
+    // a[i] = x, reads the current `a`
+    if (assign->dest()->is_array)
+    {
+        renameVar(assign->dest());
+        return;
+    }
     assign->dest()->ssa_index = newId(assign->dest()->name, assign->dest());
     auto dest_name            = assign->dest()->ssaName();
     ssa_def_map[dest_name]    = assign->dest();
@@ -774,18 +2232,19 @@ void COMPILER::CFG::renameFuncCall(COMPILER::IRCall *inst)
 
 void COMPILER::CFG::renameVar(COMPILER::IRVar *var)
 {
-    if (var == nullptr || var->is_ir_gen) return;
+    if (var == nullptr) return;
+    for (auto *idx : var->index)
+    {
+        renameIrArgs(idx);
+    }
+    if (var->is_ir_gen) return;
     auto [id, def] = getId(var->name);
     var->ssa_index = id;
     // def-use chains update
     auto def_name = var->ssaName();
-    if (ssa_def_map.find(def_name) != ssa_def_map.end())
-    {
-        var->def = ssa_def_map[def_name];
-        var->def->addUse(var);
-    }
-    else
-        UNREACHABLE();
+    if (ssa_def_map.find(def_name) == ssa_def_map.end()) THROW("ssa: `" + def_name + "` has no definition");
+    var->def = ssa_def_map[def_name];
+    var->def->addUse(var);
 }
 
 int COMPILER::CFG::newId(const std::string &name, IRVar *def)
@@ -806,10 +2265,10 @@ std::pair<int, COMPILER::IRVar *> COMPILER::CFG::getId(const std::string &name)
 std::string COMPILER::CFG::iDomDetailStr() const
 {
     std::string str;
-    for (const auto &x : idom)
+    for (auto *block : rpo)
     {
-        str += (x.first != nullptr ? x.first->name : "null") + " dominated by " +
-               (x.second != nullptr ? x.second->name : "null") + "\n";
+        const int dom = idom[block->block_index];
+        str += block->name + " dominated by " + (dom != -1 ? index_block[dom]->name : "null") + "\n";
     }
     return str;
 }
@@ -817,12 +2276,13 @@ std::string COMPILER::CFG::iDomDetailStr() const
 std::string COMPILER::CFG::dominanceFrontierStr() const
 {
     std::string str;
-    for (const auto &p : dominance_frontier)
+    for (auto *block : rpo)
     {
-        str += p.first->name + " : {";
-        for (auto *block : p.second)
+        if (dominance_frontier[block->block_index].empty()) continue;
+        str += block->name + " : {";
+        for (auto *df_block : dominance_frontier[block->block_index])
         {
-            str += block->name + " ";
+            str += df_block->name + " ";
         }
         str += "}\n";
     }
@@ -1,8 +1,10 @@
 #ifndef CVM_CFG_H
 #define CVM_CFG_H
 
+#include "../../utility/thread_pool.hpp"
 #include "../../utility/utility.hpp"
 #include "basicblock.hpp"
+#include "call_graph.h"
 #include "ir_instruction.hpp"
 
 #include <algorithm>
@@ -18,8 +20,12 @@ namespace COMPILER
 
       public:
         void simplifyCFG();
+        void simplifyCFG(COMPILER::IRFunction *func);
         void buildDominateTree(COMPILER::IRFunction *func);
+        // on `options.jobs` threads, one function at a time per thread
         void transformToSSA();
+        void transformToSSA(COMPILER::IRFunction *func);
+        void deadStoreElimination();
         void removeUnusedPhis(IRFunction *func);
         std::string iDomDetailStr() const;
         std::string dominanceFrontierStr() const;
@@ -27,15 +33,18 @@ namespace COMPILER
 
       public:
         std::vector<IRFunction *> funcs;
+        BasicBlock *global_vars{ nullptr };
+        CompileOptions options;
 
       private:
-        void init(IRFunction *func);
         void clear();
-        void dfs(BasicBlock *cur_basic_block);
-        void tarjan();
-        void calcDominanceFrontier(COMPILER::IRFunction *func);
-        // disjoint set
-        COMPILER::BasicBlock *find(COMPILER::BasicBlock *block);
+        void calcReversePostOrder(COMPILER::IRFunction *func);
+        void calcIDom();
+        int intersect(int a, int b) const;
+        void calcDominanceFrontier();
+        // liveness, fills BasicBlock::gen / kill / live_in / live_out
+        void calcLiveness();
+        void collectUses(IR *ir, BasicBlock *block);
         // SSA construction
         void collectVarAssign(COMPILER::IRFunction *func);
         void insertPhiNode();
@@ -44,10 +53,78 @@ namespace COMPILER
         void constantPropagation(COMPILER::IRFunction *func);
         void constantFolding(COMPILER::IRFunction *func);
         std::optional<CYX::Value> tryFindConstant(COMPILER::IRVar *var);
+        // sparse conditional constant propagation (Wegman, Zadeck)
+        struct LatticeCell
+        {
+            enum class State
+            {
+                TOP,      // undefined yet
+                CONSTANT, //
+                BOTTOM,   // overdefined
+            } state{ State::TOP };
+            CYX::Value value;
+        };
+        void sparseConditionalConstantPropagation(COMPILER::IRFunction *func);
+        void sccpCollectUses(IR *ir, IRInst *user);
+        void sccpMarkExecutable(BasicBlock *block);
+        void sccpVisitInst(IRInst *inst, BasicBlock *block);
+        void sccpVisitPhi(IRAssign *assign);
+        void sccpUpdate(IRVar *dest, const LatticeCell &cell);
+        static bool sccpMeet(LatticeCell &cell, const LatticeCell &that);
+        LatticeCell sccpValueOf(IR *ir);
+        LatticeCell sccpEvalBinary(IRBinary *binary);
+        void sccpRewrite(COMPILER::IRFunction *func);
+        void destroyBlock(BasicBlock *block);
+        // a name with a single definition which nothing converts in place keeps its value everywhere
+        void countDefinitions(COMPILER::IRFunction *func);
+        bool isStableName(const std::string &name);
+        // stable names which only ever hold an integer, operations on them can't fail, needs `countDefinitions()`
+        void countIntegers(COMPILER::IRFunction *func);
+        bool isInteger(IR *ir);
+        // global value numbering, walks the dominator tree with a scoped expression table
+        void globalValueNumbering(COMPILER::IRFunction *func);
+        void gvnVisitBlock(BasicBlock *block);
+        std::string gvnKey(IR *ir, bool &local, bool &memory);
+        void gvnReplace(IRAssign *assign, IRVar *available);
+        // natural loops and loop invariant code motion
+        struct Loop
+        {
+            BasicBlock *header{ nullptr };
+            BasicBlock *preheader{ nullptr }; // the only block outside the loop which jumps to `header`
+            std::vector<BasicBlock *> latches;
+            std::vector<BasicBlock *> blocks; // reverse post order, `header` first
+            std::vector<bool> body;           // indexed by `BasicBlock::block_index`
+            int parent{ -1 };                 // the closest enclosing loop in `loops`, -1 if outermost
+            int depth{ 1 };
+        };
+        bool dominates(BasicBlock *a, BasicBlock *b) const;
+        void findLoops();
+        bool insertPreheaders(COMPILER::IRFunction *func);
+        void loopInvariantCodeMotion(COMPILER::IRFunction *func);
+        void licmHoist(Loop &loop);
+        // induction variables, typed increments and array bounds check elimination. a loop with a single latch
+        // which steps `i` by a constant, `i += c` or `i -= c`, gets an integer increment if `i` starts from an
+        // integer. `arr[i]` skips its bounds checks in the body of `while (i < len(arr))` (or `len(arr) > i`, or
+        // `n = len(arr)` in front of the loop) if `i` counts up from a constant, `len()`, the counter of an
+        // enclosing loop or a sum of them; `arr` may be a param. a start or bound only known at runtime, e.g.
+        // `for (i = s; i < n; i++)` with params `s` and `n`, keeps the checks.
+        void inductionVariables(COMPILER::IRFunction *func);
+        void ivVisitLoop(Loop &loop);
+        std::optional<long long> ivIntConstant(IR *ir);
+        bool ivNonNegative(IR *ir);
+        IRVar *ivLengthOf(IR *ir);
+        void ivMarkInBounds(IR *ir, const std::string &array, const std::string &iv);
         //
         void destroyPhiNode(COMPILER::IRAssign *assign);
         void phiElimination(COMPILER::IRFunction *func);
         void deadCodeElimination(COMPILER::IRFunction *func);
+        // dead store elimination on the normal IR, block local, array elements are told apart by constant indices
+        void deadStoreElimination(COMPILER::IRFunction *func);
+        void dseVisitBlock(BasicBlock *block);
+        bool dseIsDead(IRAssign *assign, bool at_exit);
+        void dseWrite(IRVar *dest);
+        void dseRead(IRVar *var);
+        static std::optional<std::vector<std::string>> dseLocation(IRVar *var);
         // rename
         void tryRename(COMPILER::IRFunction *func);
         void rename(BasicBlock *block);
@@ -59,25 +136,46 @@ namespace COMPILER
 
       private:
         BasicBlock *entry{ nullptr };
-        // dfs related
-        std::vector<BasicBlock *> dfn;
-        std::unordered_map<BasicBlock *, int> dfn_map;
-        std::unordered_map<BasicBlock *, BasicBlock *> father;
-        std::unordered_map<BasicBlock *, bool> visited;
-        // dominate tree related
-        std::unordered_map<BasicBlock *, BasicBlock *> sdom; // a.k.a semi, not strict.
-        std::unordered_map<BasicBlock *, BasicBlock *> idom; // the closest point of dominated point
-        std::unordered_map<BasicBlock *, std::unordered_set<BasicBlock *>> tree;
-        std::unordered_map<BasicBlock *, std::unordered_set<BasicBlock *>> dominance_frontier;
-        // disjoint set (union find) related
-        std::unordered_map<BasicBlock *, BasicBlock *> disjoint_set;
-        std::unordered_map<BasicBlock *, BasicBlock *> disjoint_set_val;
+        // dominate tree related, all indexed by `BasicBlock::block_index`,
+        // which is renumbered densely (0..n-1) for the current function.
+        std::vector<BasicBlock *> index_block;
+        std::vector<BasicBlock *> rpo; // reachable blocks, reverse post order
+        std::vector<int> rpo_number;   // -1 if unreachable
+        std::vector<int> idom;         // index of the closest dominator, -1 for entry and unreachable blocks
+        std::vector<std::vector<BasicBlock *>> tree;
+        std::vector<std::vector<BasicBlock *>> dominance_frontier;
         // SSA construction.....
         std::unordered_map<std::string, std::unordered_set<BasicBlock *>> var_block_map;
         std::unordered_map<std::string, int> counter;
         std::unordered_map<std::string, std::stack<std::pair<int, IRVar *>>> stack;
         // for build new def-use chain.
         std::unordered_map<std::string, IRVar *> ssa_def_map;
+        // SCCP, keyed by `IRVar::ssaName()`, temporary variables may have several definitions.
+        std::unordered_map<std::string, LatticeCell> lattice;
+        std::unordered_map<std::string, std::vector<IRInst *>> sccp_uses;
+        std::unordered_map<IRInst *, BasicBlock *> inst_block;
+        std::vector<bool> executable;
+        std::queue<BasicBlock *> block_work_list;
+        std::queue<std::string> ssa_work_list;
+        // definitions of the current function, see `countDefinitions()`
+        std::unordered_map<std::string, int> def_count;
+        std::unordered_set<std::string> phi_names;
+        std::unordered_set<std::string> unsafe_names; // converted in place by build-in functions
+        std::unordered_set<std::string> int_names;    // see `countIntegers()`
+        // GVN, expression key -> variable holding its value
+        std::unordered_map<std::string, IRVar *> gvn_available; // valid in the dominated blocks
+        std::unordered_map<std::string, IRVar *> gvn_local;     // reads a phi result, valid in the current block
+        std::unordered_map<std::string, IRVar *> gvn_memory;    // reads an array element, until a call or store
+        // loop forest of the current function, innermost loops first
+        std::vector<Loop> loops;
+        // induction variables, keyed by `IRVar::ssaName()`, only names with a single definition
+        std::unordered_map<std::string, IRAssign *> iv_def;
+        std::unordered_set<std::string> iv_non_negative; // counting up from a non-negative start
+        // DSE, locations (index keys, empty for the whole variable) which are written again before being read
+        std::unordered_map<std::string, std::vector<std::vector<std::string>>> dse_pending;
+        std::unordered_set<std::string> dse_globals;    // outlive the function, unless shadowed by a param
+        std::unordered_set<std::string> dse_read_after; // read by the rest of the current block
+        std::unordered_set<IRVar *> dse_orphans;        // temporaries whose only users were removed
     };
 } // namespace COMPILER
 
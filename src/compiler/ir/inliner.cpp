@@ -0,0 +1,173 @@
+#include "inliner.h"
+
+void COMPILER::Inliner::inlineCalls()
+{
+    graph.build(funcs, global_vars);
+    // callees first, so that their own small calls are already inlined when they get copied
+    for (auto *func : graph.order)
+    {
+        inlineInto(func);
+    }
+}
+
+bool COMPILER::Inliner::canInline(COMPILER::IRFunction *caller, COMPILER::IRFunction *callee,
+                                  COMPILER::IRAssign *assign)
+{
+    if (callee == nullptr || callee == caller || graph.recursive.count(callee) != 0 ||
+        graph.global_users.count(callee) != 0 || callee->blocks.empty())
+        return false;
+    const int size = instCount(callee);
+    if (size > INLINE_THRESHOLD || instCount(caller) + size > CALLER_LIMIT) return false;
+    // the value of `return` without a value is whatever is left in the register
+    const bool need_result = !assign->dest()->is_ir_gen || !assign->dest()->use.empty();
+    for (auto *block : callee->blocks)
+    {
+        if (!block->phis.empty()) return false;
+        for (auto *inst : block->insts)
+        {
+            if (!inOr(inst->tag, IR::Tag::ASSIGN, IR::Tag::BRANCH, IR::Tag::JMP, IR::Tag::RETURN)) return false;
+            auto *ret = as<IRReturn, IR::Tag::RETURN>(inst);
+            if (ret != nullptr && ret->ret == nullptr && need_result) return false;
+        }
+    }
+    return true;
+}
+
+int COMPILER::Inliner::instCount(COMPILER::IRFunction *func)
+{
+    int count = 0;
+    for (auto *block : func->blocks)
+    {
+        count += block->insts.size();
+    }
+    return count;
+}
+
+void COMPILER::Inliner::inlineInto(COMPILER::IRFunction *caller)
+{
+    for (auto block_it = caller->blocks.begin(); block_it != caller->blocks.end(); block_it++)
+    {
+        auto *block = *block_it;
+        for (auto inst_it = block->insts.begin(); inst_it != block->insts.end(); inst_it++)
+        {
+            auto *assign = as<IRAssign, IR::Tag::ASSIGN>(*inst_it);
+            auto *call   = assign != nullptr ? as<IRCall, IR::Tag::CALL>(assign->src()) : nullptr;
+            if (call == nullptr || !canInline(caller, call->func, assign)) continue;
+            inlineCall(caller, block_it, inst_it);
+            // continue with the rest of the block, the copied callee has nothing left to inline
+            std::advance(block_it, call->func->blocks.size());
+            delete call;
+            break;
+        }
+    }
+}
+
+void COMPILER::Inliner::inlineCall(COMPILER::IRFunction *caller, std::list<BasicBlock *>::iterator block_it,
+                                   std::list<IRInst *>::iterator inst_it)
+{
+    auto *block  = *block_it;
+    auto *assign = static_cast<IRAssign *>(*inst_it);
+    auto *call   = static_cast<IRCall *>(assign->src());
+    auto *callee = call->func;
+    site++;
+    cloner.reset(callee->name + "." + std::to_string(site) + ".");
+
+    // the instructions after the call run once the callee returns
+    auto *ret_block = new BasicBlock(block->name + "." + std::to_string(site));
+    ret_block->insts.splice(ret_block->insts.end(), block->insts, std::next(inst_it), block->insts.end());
+    for (auto *inst : ret_block->insts)
+    {
+        inst->block = ret_block;
+    }
+    for (auto *succ : block->succs)
+    {
+        succ->pres.erase(block);
+        succ->addPre(ret_block);
+        ret_block->addSucc(succ);
+    }
+    block->succs.clear();
+    block->insts.erase(inst_it);
+
+    // params are plain assignments now
+    for (int i = 0; i < callee->params.size(); i++)
+    {
+        auto *param  = new IRAssign;
+        param->block = block;
+        param->setDest(cloner.cloneVar(callee->params[i]));
+        param->setSrc(call->args[i]);
+        block->addInst(param);
+    }
+
+    std::list<BasicBlock *> clones;
+    for (auto *callee_block : callee->blocks)
+    {
+        auto *clone                    = new BasicBlock(callee_block->name + "." + std::to_string(site));
+        cloner.block_map[callee_block] = clone;
+        clones.push_back(clone);
+    }
+    const bool need_result = !assign->dest()->is_ir_gen || !assign->dest()->use.empty();
+    for (auto *callee_block : callee->blocks)
+    {
+        auto *clone = cloner.block_map[callee_block];
+        for (auto *inst : callee_block->insts)
+        {
+            auto *ret = as<IRReturn, IR::Tag::RETURN>(inst);
+            if (ret == nullptr)
+            {
+                auto *copy  = static_cast<IRInst *>(cloner.cloneIR(inst));
+                copy->block = clone;
+                clone->addInst(copy);
+                continue;
+            }
+            if (ret->ret != nullptr && need_result)
+            {
+                auto *result  = new IRAssign;
+                auto *dest    = new IRVar;
+                dest->name    = cloner.prefix + "return";
+                result->block = clone;
+                result->setDest(dest);
+                result->setSrc(cloner.cloneIR(ret->ret));
+                clone->addInst(result);
+            }
+            auto *jump   = new IRJump;
+            jump->target = ret_block;
+            jump->block  = clone;
+            clone->addInst(jump);
+        }
+        for (auto *succ : callee_block->succs)
+        {
+            clone->addSucc(cloner.block_map[succ]);
+            cloner.block_map[succ]->addPre(clone);
+        }
+        // returns and the end of the callee continue at `ret_block`
+        if (clone->insts.empty() || clone->insts.back()->tag != IR::Tag::BRANCH)
+        {
+            auto *jump = as<IRJump, IR::Tag::JMP>(clone->insts.empty() ? nullptr : clone->insts.back());
+            if ((jump != nullptr && jump->target == ret_block) ||
+                (jump == nullptr && clone == clones.back() && callee_block->succs.empty()))
+            {
+                clone->addSucc(ret_block);
+                ret_block->addPre(clone);
+            }
+        }
+    }
+    block->addSucc(clones.front());
+    clones.front()->addPre(block);
+
+    if (need_result)
+    {
+        auto *result = new IRVar;
+        result->name = cloner.prefix + "return";
+        assign->setSrc(result);
+        assign->block = ret_block;
+        ret_block->insts.push_front(assign);
+    }
+    else
+    {
+        delete assign->dest();
+        delete assign;
+    }
+    auto pos = std::next(block_it);
+    caller->blocks.insert(pos, clones.begin(), clones.end());
+    caller->blocks.insert(pos, ret_block);
+}
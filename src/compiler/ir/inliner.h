@@ -0,0 +1,48 @@
+#ifndef CVM_INLINER_H
+#define CVM_INLINER_H
+
+#include "../../common/config.h"
+#include "../../utility/utility.hpp"
+#include "basicblock.hpp"
+#include "call_graph.h"
+#include "ir_cloner.h"
+#include "ir_instruction.hpp"
+
+#include <list>
+#include <vector>
+
+namespace COMPILER
+{
+    // Replaces calls to small non-recursive functions with a copy of their body.
+    // Runs on the normal IR, before SSA construction: the callee's variables are renamed
+    // to `callee.site.name`, params become plain assignments and every `return` assigns
+    // `callee.site.return` and jumps to the rest of the caller's block.
+    class Inliner
+    {
+      public:
+        void inlineCalls();
+
+      public:
+        std::vector<IRFunction *> funcs;
+        BasicBlock *global_vars{ nullptr };
+
+      private:
+        bool canInline(IRFunction *caller, IRFunction *callee, IRAssign *assign);
+        static int instCount(IRFunction *func);
+        void inlineInto(IRFunction *caller);
+        void inlineCall(IRFunction *caller, std::list<BasicBlock *>::iterator block_it,
+                        std::list<IRInst *>::iterator inst_it);
+
+      private:
+        // a small callee is at most this many IR instructions
+        static constexpr int INLINE_THRESHOLD = 24;
+        // stop growing a caller beyond this many IR instructions
+        static constexpr int CALLER_LIMIT = 2000;
+        CallGraph graph;
+        // current call site
+        int site{ 0 };
+        IRCloner cloner;
+    };
+} // namespace COMPILER
+
+#endif // CVM_INLINER_H
@@ -0,0 +1,271 @@
+#include "interprocedural.h"
+
+void COMPILER::Interprocedural::propagateConstants()
+{
+    graph.build(*funcs, global_vars);
+    // callers first, the calls in a cloned caller are call sites of their callees too
+    for (auto it = graph.order.rbegin(); it != graph.order.rend(); it++)
+    {
+        auto *func  = *it;
+        auto &sites = graph.call_sites[func];
+        if (func->name == ENTRY_FUNC || func->blocks.empty() || sites.empty()) continue;
+        auto *target = propagateUniform(func, sites);
+        if (graph.recursive.count(func) == 0 && instCount(target) <= SPECIALIZE_THRESHOLD)
+            specialize(target, graph.call_sites[target], target != func);
+    }
+}
+
+COMPILER::IRFunction *COMPILER::Interprocedural::propagateUniform(COMPILER::IRFunction *func,
+                                                                  std::vector<IRCall *> &sites)
+{
+    std::vector<IRConstant *> values(func->params.size(), nullptr);
+    bool found = false;
+    for (int i = 0; i < func->params.size(); i++)
+    {
+        auto *first = as<IRConstant, IR::Tag::CONST>(sites.front()->args[i]);
+        std::string key;
+        if (first == nullptr || !first->value.appendKey(key)) continue;
+        const bool same = std::all_of(sites.begin(), sites.end(), [i, &key](IRCall *call) {
+            auto *constant = as<IRConstant, IR::Tag::CONST>(call->args[i]);
+            std::string that;
+            return constant != nullptr && constant->value.appendKey(that) && that == key;
+        });
+        if (!same) continue;
+        values[i] = first;
+        found     = true;
+    }
+    if (!found) return func;
+    // `parallel_map()` and the library call functions by name, the original keeps its params
+    auto *clone = cloneFunction(func);
+    bindParams(clone, values);
+    for (auto *call : sites)
+    {
+        dropArgs(call, values);
+        call->func = clone;
+        call->name = clone->name;
+    }
+    graph.call_sites[clone] = sites;
+    sites.clear();
+    return clone;
+}
+
+void COMPILER::Interprocedural::specialize(COMPILER::IRFunction *func, std::vector<IRCall *> &sites, bool is_clone)
+{
+    // group the call sites by their constant arguments, a param passed as a variable is left as it is
+    std::vector<std::string> keys;
+    std::unordered_map<std::string, std::vector<IRCall *>> groups;
+    for (auto *call : sites)
+    {
+        std::string key;
+        for (int i = 0; i < call->args.size(); i++)
+        {
+            auto *constant = as<IRConstant, IR::Tag::CONST>(call->args[i]);
+            std::string value;
+            if (constant == nullptr || !constant->value.appendKey(value)) continue;
+            key += std::to_string(i) + ";" + value;
+        }
+        if (key.empty()) continue;
+        if (groups[key].empty()) keys.push_back(key);
+        groups[key].push_back(call);
+    }
+    // the biggest groups pay off most
+    std::stable_sort(keys.begin(), keys.end(),
+                     [&groups](const std::string &a, const std::string &b) { return groups[a].size() > groups[b].size(); });
+    if (keys.size() > MAX_CLONES) keys.resize(MAX_CLONES);
+
+    int redirected = 0;
+    for (const auto &key : keys)
+    {
+        auto &group = groups[key];
+        std::vector<IRConstant *> values;
+        for (auto *arg : group.front()->args)
+        {
+            values.push_back(as<IRConstant, IR::Tag::CONST>(arg));
+        }
+        auto *clone = cloneFunction(func);
+        bindParams(clone, values);
+        for (auto *call : group)
+        {
+            dropArgs(call, values);
+            call->func = clone;
+            call->name = clone->name;
+        }
+        redirected += group.size();
+    }
+    // nothing calls it any more, a function of the source may still be called by name
+    if (is_clone && redirected == sites.size()) funcs->erase(std::find(funcs->begin(), funcs->end(), func));
+}
+
+COMPILER::IRFunction *COMPILER::Interprocedural::cloneFunction(COMPILER::IRFunction *func)
+{
+    auto *clone        = new IRFunction;
+    const auto postfix = ".spec" + std::to_string(++clone_count);
+    clone->name        = func->name + postfix;
+    // variables keep their names, every function has its own frame
+    cloner.reset("");
+    for (auto *block : func->blocks)
+    {
+        auto *copy              = new BasicBlock(block->name + postfix);
+        cloner.block_map[block] = copy;
+        clone->blocks.push_back(copy);
+    }
+    for (auto *param : func->params)
+    {
+        clone->params.push_back(cloner.cloneVar(param));
+    }
+    for (auto *block : func->blocks)
+    {
+        auto *copy = cloner.block_map[block];
+        for (auto *inst : block->insts)
+        {
+            auto *inst_copy  = static_cast<IRInst *>(cloner.cloneIR(inst));
+            inst_copy->block = copy;
+            copy->addInst(inst_copy);
+            auto *assign = as<IRAssign, IR::Tag::ASSIGN>(inst_copy);
+            auto *call   = as<IRCall, IR::Tag::CALL>(assign != nullptr ? assign->src() : inst_copy);
+            if (call != nullptr && call->func != nullptr) graph.call_sites[call->func].push_back(call);
+        }
+        for (auto *succ : block->succs)
+        {
+            copy->addSucc(cloner.block_map[succ]);
+            cloner.block_map[succ]->addPre(copy);
+        }
+    }
+    funcs->insert(std::next(std::find(funcs->begin(), funcs->end(), func)), clone);
+    return clone;
+}
+
+void COMPILER::Interprocedural::bindParams(COMPILER::IRFunction *func, const std::vector<IRConstant *> &values)
+{
+    auto *entry = func->blocks.front();
+    auto pos    = entry->insts.begin();
+    std::vector<IRVar *> params;
+    for (int i = 0; i < func->params.size(); i++)
+    {
+        if (values[i] == nullptr)
+        {
+            params.push_back(func->params[i]);
+            continue;
+        }
+        auto *constant  = new IRConstant;
+        constant->value = values[i]->value;
+        auto *assign    = new IRAssign;
+        assign->block   = entry;
+        assign->setDest(func->params[i]);
+        assign->setSrc(constant);
+        entry->insts.insert(pos, assign);
+    }
+    func->params = params;
+}
+
+void COMPILER::Interprocedural::dropArgs(COMPILER::IRCall *call, const std::vector<IRConstant *> &values)
+{
+    std::vector<IR *> args;
+    for (int i = 0; i < call->args.size(); i++)
+    {
+        if (values[i] == nullptr)
+            args.push_back(call->args[i]);
+        else
+            delete call->args[i];
+    }
+    call->args = args;
+}
+
+void COMPILER::Interprocedural::markGlobalWriters()
+{
+    CallGraph call_graph;
+    call_graph.build(*funcs, global_vars);
+    std::unordered_set<IRFunction *> writers = call_graph.global_writers;
+    // callees first, a cycle needs another round
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (auto *func : call_graph.order)
+        {
+            if (writers.count(func) != 0) continue;
+            const auto &targets = call_graph.callees[func];
+            if (std::any_of(targets.begin(), targets.end(),
+                            [&writers](IRFunction *f) { return writers.count(f) != 0; }))
+            {
+                writers.insert(func);
+                changed = true;
+            }
+        }
+    }
+    for (auto *func : *funcs)
+    {
+        func->writes_globals = writers.count(func) != 0;
+    }
+}
+
+void COMPILER::Interprocedural::markPureFunctions()
+{
+    static const std::unordered_set<std::string> pure_buildins = { "len", "int", "double", "string" };
+    CallGraph call_graph;
+    call_graph.build(*funcs, global_vars);
+    std::unordered_set<IRFunction *> impure;
+    for (auto *func : *funcs)
+    {
+        if (func->name == ENTRY_FUNC || call_graph.global_users.count(func) != 0) impure.insert(func);
+        for (auto *block : func->blocks)
+        {
+            for (auto *inst : block->insts)
+            {
+                auto *assign = as<IRAssign, IR::Tag::ASSIGN>(inst);
+                auto *call   = as<IRCall, IR::Tag::CALL>(assign != nullptr ? assign->src() : inst);
+                if (call != nullptr && call->func == nullptr && pure_buildins.count(call->name) == 0)
+                    impure.insert(func);
+            }
+        }
+    }
+    // callees first, a cycle needs another round
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (auto *func : call_graph.order)
+        {
+            if (impure.count(func) != 0) continue;
+            const auto &targets = call_graph.callees[func];
+            if (std::any_of(targets.begin(), targets.end(), [&impure](IRFunction *f) { return impure.count(f) != 0; }))
+            {
+                impure.insert(func);
+                changed = true;
+            }
+        }
+    }
+    for (auto *func : *funcs)
+    {
+        func->pure    = impure.count(func) == 0;
+        func->memoize = func->pure && call_graph.recursive.count(func) != 0 && !func->params.empty() &&
+                        returnsValue(func);
+    }
+}
+
+int COMPILER::Interprocedural::instCount(COMPILER::IRFunction *func)
+{
+    int count = 0;
+    for (auto *block : func->blocks)
+    {
+        count += block->insts.size();
+    }
+    return count;
+}
+
+bool COMPILER::Interprocedural::returnsValue(COMPILER::IRFunction *func)
+{
+    // the last block would fall through into the next function, a bare `return` leaves a stale register
+    if (func->blocks.empty() || func->blocks.back()->insts.empty() ||
+        func->blocks.back()->insts.back()->tag != IR::Tag::RETURN)
+        return false;
+    for (auto *block : func->blocks)
+    {
+        for (auto *inst : block->insts)
+        {
+            auto *ret = as<IRReturn, IR::Tag::RETURN>(inst);
+            if (ret != nullptr && ret->ret == nullptr) return false;
+        }
+    }
+    return true;
+}
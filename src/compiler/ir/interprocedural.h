@@ -0,0 +1,56 @@
+#ifndef CVM_INTERPROCEDURAL_H
+#define CVM_INTERPROCEDURAL_H
+
+#include "../../common/config.h"
+#include "../../utility/utility.hpp"
+#include "basicblock.hpp"
+#include "call_graph.h"
+#include "ir_cloner.h"
+#include "ir_instruction.hpp"
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace COMPILER
+{
+    // Interprocedural passes over the normal IR, before SSA construction.
+    class Interprocedural
+    {
+      public:
+        // A param which every call site passes the same constant becomes an assignment at the entry
+        // of a clone of the callee, the call sites drop its argument and call the clone. Small non-recursive
+        // callees are cloned for each group of call sites sharing constant arguments (at most `MAX_CLONES`
+        // per function). The functions of the source are left as they are, they may be called by name.
+        void propagateConstants();
+        // Sets `IRFunction::pure` and `IRFunction::memoize`.
+        void markPureFunctions();
+        // Sets `IRFunction::writes_globals`, `parallel_map()` only copies the globals once for the others.
+        void markGlobalWriters();
+
+      public:
+        std::vector<IRFunction *> *funcs{ nullptr };
+        BasicBlock *global_vars{ nullptr };
+
+      private:
+        // returns the function the call sites call now
+        IRFunction *propagateUniform(IRFunction *func, std::vector<IRCall *> &sites);
+        void specialize(IRFunction *func, std::vector<IRCall *> &sites, bool is_clone);
+        IRFunction *cloneFunction(IRFunction *func);
+        void bindParams(IRFunction *func, const std::vector<IRConstant *> &values);
+        static void dropArgs(IRCall *call, const std::vector<IRConstant *> &values);
+        static int instCount(IRFunction *func);
+        static bool returnsValue(IRFunction *func);
+
+      private:
+        // a callee is cloned only if it is at most this many IR instructions
+        static constexpr int SPECIALIZE_THRESHOLD = 64;
+        static constexpr int MAX_CLONES           = 4;
+        CallGraph graph;
+        IRCloner cloner;
+        int clone_count{ 0 };
+    };
+} // namespace COMPILER
+
+#endif // CVM_INTERPROCEDURAL_H
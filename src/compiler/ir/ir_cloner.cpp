@@ -0,0 +1,120 @@
+#include "ir_cloner.h"
+
+void COMPILER::IRCloner::reset(const std::string &new_prefix)
+{
+    prefix = new_prefix;
+    block_map.clear();
+    var_map.clear();
+}
+
+COMPILER::IR *COMPILER::IRCloner::cloneIR(COMPILER::IR *ir)
+{
+    if (ir == nullptr) return nullptr;
+    switch (ir->tag)
+    {
+        case IR::Tag::CONST:
+        {
+            auto *constant  = new IRConstant;
+            constant->value = static_cast<IRConstant *>(ir)->value;
+            return constant;
+        }
+        case IR::Tag::VAR: return cloneVar(static_cast<IRVar *>(ir));
+        case IR::Tag::BINARY:
+        {
+            auto *binary = static_cast<IRBinary *>(ir);
+            auto *copy   = new IRBinary;
+            copy->opcode = binary->opcode;
+            copy->lhs    = static_cast<IRValue *>(cloneIR(binary->lhs));
+            copy->rhs    = static_cast<IRValue *>(cloneIR(binary->rhs));
+            copy->is_int = binary->is_int;
+            return copy;
+        }
+        case IR::Tag::ARRAY:
+        {
+            auto *copy = new IRArray;
+            for (auto *x : static_cast<IRArray *>(ir)->content)
+            {
+                copy->content.push_back(cloneIR(x));
+            }
+            return copy;
+        }
+        case IR::Tag::CALL:
+        {
+            auto *call = static_cast<IRCall *>(ir);
+            auto *copy = new IRCall;
+            copy->name = call->name;
+            copy->func = call->func;
+            for (auto *arg : call->args)
+            {
+                copy->args.push_back(cloneIR(arg));
+            }
+            return copy;
+        }
+        case IR::Tag::ASSIGN:
+        {
+            auto *assign = static_cast<IRAssign *>(ir);
+            auto *copy   = new IRAssign;
+            copy->setDest(cloneVar(assign->dest()));
+            copy->setSrc(cloneIR(assign->src()));
+            return copy;
+        }
+        case IR::Tag::BRANCH:
+        {
+            auto *branch      = static_cast<IRBranch *>(ir);
+            auto *copy        = new IRBranch;
+            copy->cond        = cloneVar(branch->cond);
+            copy->true_block  = block_map[branch->true_block];
+            copy->false_block = block_map[branch->false_block];
+            return copy;
+        }
+        case IR::Tag::SWITCH:
+        {
+            auto *inst          = static_cast<IRSwitch *>(ir);
+            auto *copy          = new IRSwitch;
+            copy->cond          = cloneVar(inst->cond);
+            copy->default_block = block_map[inst->default_block];
+            for (auto &[value, block] : inst->cases)
+            {
+                copy->cases.emplace_back(value, block_map[block]);
+            }
+            return copy;
+        }
+        case IR::Tag::RETURN:
+        {
+            auto *copy = new IRReturn;
+            copy->ret  = static_cast<IRValue *>(cloneIR(static_cast<IRReturn *>(ir)->ret));
+            return copy;
+        }
+        case IR::Tag::JMP:
+        {
+            auto *copy   = new IRJump;
+            copy->target = block_map[static_cast<IRJump *>(ir)->target];
+            return copy;
+        }
+        default: THROW("can't clone `" + ir->toString() + "`");
+    }
+    return nullptr;
+}
+
+COMPILER::IRVar *COMPILER::IRCloner::cloneVar(COMPILER::IRVar *var)
+{
+    if (var == nullptr) return nullptr;
+    // a definition may be reached through one of its uses first
+    if (auto it = var_map.find(var); it != var_map.end()) return it->second;
+    auto *copy      = new IRVar;
+    var_map[var]    = copy;
+    copy->name      = prefix + var->name;
+    copy->is_ir_gen = var->is_ir_gen;
+    copy->is_array  = var->is_array;
+    for (auto *idx : var->index)
+    {
+        copy->index.push_back(cloneIR(idx));
+    }
+    if (var->def != nullptr)
+    {
+        // user variables point at their definition without being recorded as its use
+        copy->def = cloneVar(var->def);
+        if (std::find(var->def->use.begin(), var->def->use.end(), var) != var->def->use.end()) copy->def->addUse(copy);
+    }
+    return copy;
+}
@@ -0,0 +1,31 @@
+#ifndef CVM_IR_CLONER_H
+#define CVM_IR_CLONER_H
+
+#include "../../utility/utility.hpp"
+#include "basicblock.hpp"
+#include "ir_instruction.hpp"
+
+#include <string>
+#include <unordered_map>
+
+namespace COMPILER
+{
+    // Deep copies of normal IR (no phis). Variables are renamed to `prefix + name` and keep their
+    // def-use links among the copies, jumps and branches are redirected through `block_map`.
+    class IRCloner
+    {
+      public:
+        void reset(const std::string &new_prefix);
+        IR *cloneIR(IR *ir);
+        IRVar *cloneVar(IRVar *var);
+
+      public:
+        std::string prefix;
+        std::unordered_map<BasicBlock *, BasicBlock *> block_map;
+
+      private:
+        std::unordered_map<IRVar *, IRVar *> var_map;
+    };
+} // namespace COMPILER
+
+#endif // CVM_IR_CLONER_H
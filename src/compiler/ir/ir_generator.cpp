@@ -67,14 +67,16 @@ void COMPILER::IRGenerator::visitUnaryExpr(COMPILER::UnaryExpr *ptr)
     {
         if (cur_value.hasValue())
         {
+            // `-` takes a number, `!` and `~` an integer
+            const bool fits = cur_value.is<long long>() || (ptr->op.keyword == Keyword::SUB && cur_value.is<double>());
+            if (!fits || !inOr(ptr->op.keyword, Keyword::SUB, Keyword::LNOT, Keyword::BNOT))
+                THROW("can't apply `" + std::string(ptr->op.value) + "` to this constant in " + POS(ptr));
             if (ptr->op.keyword == Keyword::SUB)
                 cur_value = -cur_value;
             else if (ptr->op.keyword == Keyword::LNOT)
                 cur_value = !cur_value;
-            else if (ptr->op.keyword == Keyword::BNOT)
-                cur_value = ~cur_value;
             else
-                UNREACHABLE();
+                cur_value = ~cur_value;
 
             auto *constant  = new IRConstant;
             constant->value = cur_value;
@@ -102,6 +104,11 @@ void COMPILER::IRGenerator::visitUnaryExpr(COMPILER::UnaryExpr *ptr)
 
 void COMPILER::IRGenerator::visitBinaryExpr(COMPILER::BinaryExpr *ptr)
 {
+    if (inOr(ptr->op.keyword, Keyword::LAND, Keyword::LOR))
+    {
+        visitLogicalExpr(ptr);
+        return;
+    }
     auto *binary   = new IRBinary;
     auto *assign   = new IRAssign;
     binary->opcode = token2IROp(ptr->op.keyword);
@@ -183,6 +190,113 @@ void COMPILER::IRGenerator::visitBinaryExpr(COMPILER::BinaryExpr *ptr)
     cur_basic_block->addInst(assign);
 }
 
+void COMPILER::IRGenerator::visitLogicalExpr(COMPILER::BinaryExpr *ptr)
+{
+    /*
+    x = a && b
+    ->
+    @L1
+     if a then goto @L2 else goto @L4
+    @L2
+     if b then goto @L3 else goto @L4
+    @L3
+     t0. = 1
+     jmp @L5
+    @L4
+     t0. = 0
+    @L5
+     x = t0.
+    */
+    auto exits = visitCondition(ptr);
+    // it is assigned on both paths like a user variable, the name can't clash with one
+    auto *result = new IRVar;
+    result->name = "t" + std::to_string(var_cnt++) + ".";
+
+    auto *true_block = newBasicBlock();
+    fixExits(exits.on_true, true_block);
+    auto *true_value  = new IRConstant;
+    true_value->value = 1;
+    auto *true_assign = new IRAssign;
+    true_assign->setDest(result);
+    true_assign->setSrc(true_value);
+    true_assign->block = true_block;
+    true_block->addInst(true_assign);
+    auto *jmp  = new IRJump;
+    jmp->block = true_block;
+    true_block->addInst(jmp);
+
+    auto *false_block = newBasicBlock();
+    fixExits(exits.on_false, false_block);
+    auto *redefine     = new IRVar;
+    redefine->name     = result->name;
+    redefine->def      = result;
+    auto *false_value  = new IRConstant;
+    false_value->value = 0;
+    auto *false_assign = new IRAssign;
+    false_assign->setDest(redefine);
+    false_assign->setSrc(false_value);
+    false_assign->block = false_block;
+    false_block->addInst(false_assign);
+
+    auto *out_block = newBasicBlock();
+    jmp->target     = out_block;
+    LINK(true_block, out_block);
+    LINK(false_block, out_block);
+    cur_basic_block = out_block;
+    tmp_vars.push(result);
+}
+
+COMPILER::IRGenerator::ConditionExits COMPILER::IRGenerator::visitCondition(COMPILER::Expr *ptr)
+{
+    ConditionExits exits;
+    auto *binary = dynamic_cast<BinaryExpr *>(ptr);
+    if (binary != nullptr && inOr(binary->op.keyword, Keyword::LAND, Keyword::LOR))
+    {
+        // a && b: b is tested only if a is true, a || b: only if a is false
+        const bool is_and = binary->op.keyword == Keyword::LAND;
+        check_var_exist   = true;
+        exits             = visitCondition(binary->lhs);
+        auto *rhs_block   = newBasicBlock();
+        auto &to_rhs      = is_and ? exits.on_true : exits.on_false;
+        fixExits(to_rhs, rhs_block);
+        to_rhs.clear();
+        cur_basic_block = rhs_block;
+        check_var_exist = true;
+        auto rhs        = visitCondition(binary->rhs);
+        exits.on_true.insert(exits.on_true.end(), rhs.on_true.begin(), rhs.on_true.end());
+        exits.on_false.insert(exits.on_false.end(), rhs.on_false.begin(), rhs.on_false.end());
+        return exits;
+    }
+    auto *unary = dynamic_cast<UnaryExpr *>(ptr);
+    if (unary != nullptr && unary->op.keyword == Keyword::LNOT)
+    {
+        exits = visitCondition(unary->rhs);
+        std::swap(exits.on_true, exits.on_false);
+        return exits;
+    }
+    ptr->visit(this);
+    check_var_exist = false;
+    keepInVariable();
+    auto *branch              = new IRBranch;
+    branch->block             = cur_basic_block;
+    branch->cond              = consumeVariable();
+    branch->cond->belong_inst = branch;
+    cur_basic_block->addInst(branch);
+    exits.on_true.emplace_back(branch, &branch->true_block);
+    exits.on_false.emplace_back(branch, &branch->false_block);
+    return exits;
+}
+
+void COMPILER::IRGenerator::fixExits(const std::vector<std::pair<IRBranch *, BasicBlock **>> &exits,
+                                     COMPILER::BasicBlock *target)
+{
+    for (const auto &[branch, side] : exits)
+    {
+        *side = target;
+        LINK(branch->block, target);
+    }
+}
+
 void COMPILER::IRGenerator::visitIntExpr(COMPILER::IntExpr *ptr)
 {
     cur_value = ptr->value;
@@ -208,7 +322,7 @@ void COMPILER::IRGenerator::visitAssignExpr(COMPILER::AssignExpr *ptr)
 
         if (first_scan_funcs.find(ir_var->name) != first_scan_funcs.end())
         {
-            CERR("twice defined! previous `" + ir_var->name + "` defined is function!!");
+            THROW("twice defined! previous `" + ir_var->name + "` defined is function!!");
         }
 
         first_scan_vars[ir_var->name] = ir_var;
@@ -257,7 +371,7 @@ void COMPILER::IRGenerator::visitIdentifierExpr(COMPILER::IdentifierExpr *ptr)
     {
         if (check_var_exist)
         {
-            CERR("cant find definition of `" + ptr->value + "` in " + POS(ptr));
+            THROW("cant find definition of `" + ptr->value + "` in " + POS(ptr));
         }
         auto *var_def = new IRVar;
         var_def->name = ptr->value;
@@ -283,7 +397,7 @@ void COMPILER::IRGenerator::visitFuncCallExpr(COMPILER::FuncCallExpr *ptr)
     {
         inst->name += "#" + std::to_string(ptr->args.size());
         if (first_scan_funcs.find(inst->name) == first_scan_funcs.end())
-            CERR("can't find function definition of `" + ptr->func_name + "` in " + POS(ptr));
+            THROW("can't find function definition of `" + ptr->func_name + "` in " + POS(ptr));
 
         inst->func = first_scan_funcs[inst->name]->ir_func;
     }
@@ -340,17 +454,16 @@ void COMPILER::IRGenerator::visitIfStmt(COMPILER::IfStmt *ptr)
     auto *cond_block = newBasicBlock();
     LINK(cur_basic_block, cond_block);
     cur_basic_block = cond_block;
-    ptr->cond->visit(this);
-    auto *cond = consumeVariable();
+    auto exits      = visitCondition(ptr->cond);
     //
     auto *true_block = newBasicBlock();
-    LINK(cond_block, true_block);
+    fixExits(exits.on_true, true_block);
     cur_basic_block = true_block;
     ptr->true_block->visit(this);
     auto *out_of_true = cur_basic_block;
     //
     auto *false_block = newBasicBlock();
-    LINK(cond_block, false_block);
+    fixExits(exits.on_false, false_block);
     cur_basic_block = false_block;
     if (ptr->false_block != nullptr) ptr->false_block->visit(this);
     auto *out_of_false = cur_basic_block;
@@ -359,20 +472,14 @@ void COMPILER::IRGenerator::visitIfStmt(COMPILER::IfStmt *ptr)
     LINK(out_of_false, out_block);
     //
     cur_basic_block = out_block;
-    //
-    auto *branch        = new IRBranch;
-    branch->true_block  = true_block;
-    branch->false_block = false_block;
-    branch->block       = cond_block;
-    branch->cond        = cond;
-    cond_block->addInst(branch);
-
-    if (inOr(true_block->insts.back()->tag, IR::Tag::RETURN, IR::Tag::JMP)) return;
+
+    // the true branch may end in a block of a nested statement
+    if (!out_of_true->insts.empty() && inOr(out_of_true->insts.back()->tag, IR::Tag::RETURN, IR::Tag::JMP)) return;
     // jump to the out block after executed true block instructions.
     auto *true_jmp   = new IRJump;
-    true_jmp->block  = true_block;
+    true_jmp->block  = out_of_true;
     true_jmp->target = out_block;
-    true_block->addInst(true_jmp);
+    out_of_true->addInst(true_jmp);
 }
 
 void COMPILER::IRGenerator::visitForStmt(COMPILER::ForStmt *ptr)
@@ -412,16 +519,10 @@ void COMPILER::IRGenerator::visitForStmt(COMPILER::ForStmt *ptr)
     auto *cond_block = newBasicBlock();
     LINK(cur_basic_block, cond_block);
     cur_basic_block = cond_block;
-    ptr->cond->visit(this);
-
-    auto *branch      = new IRBranch;
-    auto *cond        = consumeVariable();
-    cond->belong_inst = branch;
-    branch->cond      = cond;
-    cur_basic_block->addInst(branch);
+    auto exits      = visitCondition(ptr->cond);
     //
     auto *body_block = newBasicBlock();
-    LINK(cur_basic_block, body_block);
+    fixExits(exits.on_true, body_block);
     cur_basic_block = body_block;
     ptr->block->visit(this);
     //
@@ -431,16 +532,14 @@ void COMPILER::IRGenerator::visitForStmt(COMPILER::ForStmt *ptr)
     cur_basic_block = final_block;
     ptr->final->visit(this);
 
-    branch->true_block = body_block;
-    auto *jmp          = new IRJump;
+    auto *jmp = new IRJump;
     cur_basic_block->addInst(jmp);
 
     jmp->target = cond_block;
     //
     auto *out_block = newBasicBlock();
-    LINK(cond_block, out_block);
-    cur_basic_block     = out_block;
-    branch->false_block = out_block;
+    fixExits(exits.on_false, out_block);
+    cur_basic_block = out_block;
     // loop
     out_block->loop_start = init_block;
     init_block->loop_end  = out_block;
@@ -487,13 +586,10 @@ void COMPILER::IRGenerator::visitWhileStmt(COMPILER::WhileStmt *ptr)
     //
     LINK(cur_basic_block, cond_block);
     cur_basic_block = cond_block;
-    ptr->cond->visit(this);
-    auto *branch  = new IRBranch;
-    branch->block = cur_basic_block;
-    branch->cond  = consumeVariable();
+    auto exits      = visitCondition(ptr->cond);
 
     auto *body_block = newBasicBlock();
-    LINK(cond_block, body_block);
+    fixExits(exits.on_true, body_block);
     cur_basic_block = body_block;
     ptr->block->visit(this);
     //
@@ -503,11 +599,7 @@ void COMPILER::IRGenerator::visitWhileStmt(COMPILER::WhileStmt *ptr)
     LINK(cur_basic_block, cond_block);
 
     auto *out_block = newBasicBlock();
-    LINK(cond_block, out_block);
-
-    branch->true_block  = body_block;
-    branch->false_block = out_block;
-    cond_block->addInst(branch);
+    fixExits(exits.on_false, out_block);
 
     cur_basic_block = out_block;
     // loop
@@ -537,10 +629,141 @@ void COMPILER::IRGenerator::visitWhileStmt(COMPILER::WhileStmt *ptr)
 
 void COMPILER::IRGenerator::visitSwitchStmt(COMPILER::SwitchStmt *ptr)
 {
+    /*
+    switch (x) { (1) => { a }, ("b") => { b } }
+    ->
+    @cond
+     switch x case 1 goto @case1 case b goto @case2 else goto @out
+    @case1
+     a
+     goto @out
+    @case2
+     b
+     goto @out
+    @out
+     ....
+    a case which isn't an int or string constant makes it a chain of `if (x == case)`
+    */
+    auto *cond_block = newBasicBlock();
+    LINK(cur_basic_block, cond_block);
+    cur_basic_block = cond_block;
+    ptr->cond->visit(this);
+    // the condition is read once per case in a chain
+    keepInVariable();
+    auto *subject   = consumeVariable(false);
+    auto useSubject = [this, subject]()
+    {
+        tmp_vars.push(subject);
+        return consumeVariable();
+    };
+
+    std::vector<IRJump *> out_jumps;
+    // cases which end in `break` / `continue` / `return`, linked to the out block like the branches of an `if`,
+    // `fixEdges()` moves the edge to where they really go
+    std::vector<BasicBlock *> out_of_cases;
+    auto visitCase = [this, &out_jumps, &out_of_cases](MatchStmt *match, BasicBlock *case_block)
+    {
+        cur_basic_block = case_block;
+        match->visit(this);
+        if (!cur_basic_block->insts.empty() &&
+            inOr(cur_basic_block->insts.back()->tag, IR::Tag::RETURN, IR::Tag::JMP))
+        {
+            out_of_cases.push_back(cur_basic_block);
+            return;
+        }
+        auto *jmp  = new IRJump;
+        jmp->block = cur_basic_block;
+        cur_basic_block->addInst(jmp);
+        out_jumps.push_back(jmp);
+    };
+
+    auto isConstant = [](MatchStmt *match)
+    { return dynamic_cast<IntExpr *>(match->cond) != nullptr || dynamic_cast<StringExpr *>(match->cond) != nullptr; };
+    BasicBlock *out_block = nullptr;
+    if (std::all_of(ptr->matches.begin(), ptr->matches.end(), isConstant))
+    {
+        auto *inst              = new IRSwitch;
+        inst->block             = cond_block;
+        inst->cond              = useSubject();
+        inst->cond->belong_inst = inst;
+        cond_block->addInst(inst);
+        for (auto *match : ptr->matches)
+        {
+            match->cond->visit(this);
+            auto value = cur_value;
+            cur_value.reset();
+            // the first of two equal cases wins, the other one is never executed
+            if (std::any_of(inst->cases.begin(), inst->cases.end(),
+                            [&value](auto &x) { return x.first.isSameType(value) && x.first == value; }))
+                continue;
+            auto *case_block = newBasicBlock();
+            LINK(cond_block, case_block);
+            inst->cases.emplace_back(value, case_block);
+            visitCase(match, case_block);
+        }
+        out_block = newBasicBlock();
+        LINK(cond_block, out_block);
+        inst->default_block = out_block;
+    }
+    else
+    {
+        for (auto *match : ptr->matches)
+        {
+            auto *binary   = new IRBinary;
+            auto *assign   = new IRAssign;
+            binary->opcode = IR_EQ;
+            binary->lhs    = useSubject();
+            assign->block  = cur_basic_block;
+            assign->setSrc(binary);
+            check_var_exist = true;
+            match->cond->visit(this);
+            check_var_exist = false;
+            if (cur_value.hasValue())
+            {
+                auto *rhs   = new IRConstant;
+                rhs->value  = cur_value;
+                binary->rhs = rhs;
+                cur_value.reset();
+            }
+            else
+            {
+                binary->rhs = consumeVariable();
+            }
+            assign->setDest(newVariable());
+            cur_basic_block->addInst(assign);
+
+            auto *test_block = cur_basic_block;
+            auto *branch     = new IRBranch;
+            branch->block    = test_block;
+            branch->cond     = consumeVariable();
+            test_block->addInst(branch);
+            branch->true_block = newBasicBlock();
+            LINK(test_block, branch->true_block);
+            visitCase(match, branch->true_block);
+            // the next case is tested in the block after this case
+            branch->false_block = newBasicBlock();
+            LINK(test_block, branch->false_block);
+            cur_basic_block = branch->false_block;
+        }
+        out_block = cur_basic_block;
+    }
+    if (subject->def != nullptr) delete subject;
+
+    for (auto *jmp : out_jumps)
+    {
+        jmp->target = out_block;
+        LINK(jmp->block, out_block);
+    }
+    for (auto *block : out_of_cases)
+    {
+        LINK(block, out_block);
+    }
+    cur_basic_block = out_block;
 }
 
 void COMPILER::IRGenerator::visitMatchStmt(COMPILER::MatchStmt *ptr)
 {
+    ptr->block->visit(this);
 }
 
 void COMPILER::IRGenerator::visitFuncDeclStmt(COMPILER::FuncDeclStmt *ptr)
@@ -561,18 +784,18 @@ void COMPILER::IRGenerator::visitFuncDeclStmt(COMPILER::FuncDeclStmt *ptr)
 
     if (first_scan_vars.find(func->toString()) != first_scan_vars.end())
     {
-        CERR("twice defined! previous `" + func->name + "` defined is variable!!");
+        THROW("twice defined! previous `" + func->name + "` defined is variable!!");
     }
     if (first_scan_funcs.find(func->toString()) != first_scan_funcs.end())
     {
-        CERR("twice defined! previous `" + func->name + "` has same signature!!");
+        THROW("twice defined! previous `" + func->name + "` has same signature!!");
     }
     first_scan_funcs[func->name == ENTRY_FUNC ? func->name : func->toString()] = func;
 }
 
 void COMPILER::IRGenerator::visitBreakStmt(COMPILER::BreakStmt *ptr)
 {
-    if (loop_stack.empty()) CERR("unexpected `break` in " + POS(ptr));
+    if (loop_stack.empty()) THROW("unexpected `break` in " + POS(ptr));
     auto *inst   = new IRJump;
     inst->target = loop_stack.back();
     cur_fix_break_wait_list->push_back(inst);
@@ -582,7 +805,7 @@ void COMPILER::IRGenerator::visitBreakStmt(COMPILER::BreakStmt *ptr)
 
 void COMPILER::IRGenerator::visitContinueStmt(COMPILER::ContinueStmt *ptr)
 {
-    if (loop_stack.empty()) CERR("unexpected `continue` in " + POS(ptr));
+    if (loop_stack.empty()) THROW("unexpected `continue` in " + POS(ptr));
     auto *inst   = new IRJump;
     inst->target = loop_stack.back();
     cur_fix_continue_wait_list->push_back(inst);
@@ -689,6 +912,26 @@ COMPILER::IRVar *COMPILER::IRGenerator::consumeVariable(bool force_IRVar)
     return retval;
 }
 
+void COMPILER::IRGenerator::keepInVariable()
+{
+    if (!cur_value.hasValue() && (tmp_vars.empty() || !tmp_vars.top()->is_array)) return;
+    auto *assign  = new IRAssign;
+    assign->block = cur_basic_block;
+    if (cur_value.hasValue())
+    {
+        auto *constant  = new IRConstant;
+        constant->value = cur_value;
+        cur_value.reset();
+        assign->setSrc(constant);
+    }
+    else
+    {
+        assign->setSrc(consumeVariable());
+    }
+    assign->setDest(newVariable());
+    cur_basic_block->addInst(assign);
+}
+
 COMPILER::IRGenerator::IRGenerator()
 {
     cur_symbol = new SymbolTable(global_table);
@@ -808,7 +1051,7 @@ void COMPILER::IRGenerator::visitTree(COMPILER::Tree *ptr)
         func_pointer->block->visit(this);
         exitScope();
     }
-    if (!NO_CODE_SIMPLIFY) simplifyIR();
+    if (!options.no_code_simplify) simplifyIR();
     fixEdges();
 }
 
@@ -1039,6 +1282,16 @@ void COMPILER::IRGenerator::fixEdges()
     // remove some edges that shouldn't be there
     for (auto *func : funcs)
     {
+        // `break` / `continue` / `return` end their block, the instructions after them are never executed.
+        // drop them (they stay allocated, def-use chains may still point at them) so that the last
+        // instruction really is the terminator and the edges below follow it.
+        for (auto *block : func->blocks)
+        {
+            auto it = std::find_if(block->insts.begin(), block->insts.end(), [](IRInst *inst) {
+                return inOr(inst->tag, IR::Tag::JMP, IR::Tag::RETURN);
+            });
+            if (it != block->insts.end()) block->insts.erase(std::next(it), block->insts.end());
+        }
         // direct erase causes iterator to fail.
         // std::erase_if supported at c++2a
         std::vector<std::pair<BasicBlock *, BasicBlock *>> remove_list;
@@ -10,6 +10,7 @@
 #include "../symbol.hpp"
 #include "ir_instruction.hpp"
 
+#include <algorithm>
 #include <stack>
 
 namespace COMPILER
@@ -29,6 +30,8 @@ namespace COMPILER
         //
         void visitUnaryExpr(UnaryExpr *ptr) override;
         void visitBinaryExpr(BinaryExpr *ptr) override;
+        // `&&` and `||` as a value, see `visitCondition()`
+        void visitLogicalExpr(BinaryExpr *ptr);
         void visitIntExpr(IntExpr *ptr) override;
         void visitDoubleExpr(DoubleExpr *ptr) override;
         void visitStringExpr(StringExpr *ptr) override;
@@ -59,10 +62,22 @@ namespace COMPILER
         IRVar *newVariable();
         std::string newLabel();
         COMPILER::IRVar *consumeVariable(bool force_IRVar = true);
+        // a constant or an array element which was just visited goes to a temporary variable on `tmp_vars`
+        void keepInVariable();
         BasicBlock *newBasicBlock(const std::string &name = "");
         void destroyVar(IRVar *var);
         //
         void fixEdges();
+        //
+        // the sides of the branches which leave a condition, they are set once the target blocks exist
+        struct ConditionExits
+        {
+            std::vector<std::pair<IRBranch *, BasicBlock **>> on_true;
+            std::vector<std::pair<IRBranch *, BasicBlock **>> on_false;
+        };
+        // branches on `ptr`, the right operand of `&&` and `||` is skipped if the left one decides it
+        ConditionExits visitCondition(Expr *ptr);
+        void fixExits(const std::vector<std::pair<IRBranch *, BasicBlock **>> &exits, BasicBlock *target);
 
       private:
         std::vector<BasicBlock *> loop_stack;
@@ -88,6 +103,7 @@ namespace COMPILER
       public:
         std::vector<IRFunction *> funcs;
         BasicBlock *global_var_decl{ nullptr };
+        CompileOptions options;
 
       private:
         // AST first scan.
@@ -129,6 +129,7 @@ namespace COMPILER
     class IRCall;
     class IRFunction;
     class IRBranch;
+    class IRSwitch;
     class IRPhi;
     class IRVar;
     class IRParams;
@@ -154,6 +155,7 @@ namespace COMPILER
             FUNC,   // function decl
             PARAM,  // function params
             BRANCH, // if then else.
+            SWITCH, // switch, one target per case
             ASSIGN, // a = binary / constant / call / var / vardef
             PHI,    // phi node
             ARRAY,  // [1,a,[a,2]]
@@ -231,6 +233,7 @@ namespace COMPILER
         COMPILER::IROpcode opcode{ IROpcode::IR_INVALID };
         IRValue *lhs{ nullptr };
         IRValue *rhs{ nullptr };
+        bool is_int{ false }; // both operands are known to be integers, see `CFG::inductionVariables()`
     };
 
     class IRReturn : public IRInst
@@ -284,6 +287,9 @@ namespace COMPILER
         std::string name;
         std::vector<IRVar *> params;
         std::list<BasicBlock *> blocks;
+        bool pure{ false };          // no globals, no I/O, only calls pure functions
+        bool memoize{ false };       // pure and recursive, the VM may cache its results
+        bool writes_globals{ true }; // itself or through a callee, see `Interprocedural::markGlobalWriters()`
     };
 
     class IRCall : public IRInst
@@ -341,7 +347,7 @@ namespace COMPILER
         }
         std::string ssaName()
         {
-            return NO_SSA || is_ir_gen ? name : name + std::to_string(ssa_index);
+            return is_ir_gen || ssa_index < 0 ? name : name + std::to_string(ssa_index);
         }
         std::string toString() override
         {
@@ -355,7 +361,7 @@ namespace COMPILER
             }
             else
             {
-                str += (is_ir_gen || NO_SSA ? "" : std::to_string(ssa_index));
+                str += (is_ir_gen || ssa_index < 0 ? "" : std::to_string(ssa_index));
             }
             return str;
         }
@@ -379,10 +385,11 @@ namespace COMPILER
       public:
         bool is_array{ false };
         std::vector<IR *> index;
+        bool in_bounds{ false }; // every index is proven to be in range, no bounds check is needed
         //
         bool is_ir_gen{ false };
         std::string name;
-        int ssa_index{ 0 };
+        int ssa_index{ -1 }; // -1 until it is renamed in SSA construction
         IRVar *def{ nullptr };
         std::list<IRVar *> use;
     };
@@ -428,6 +435,7 @@ namespace COMPILER
         }
         // var / constant
         std::vector<IRValue *> args;
+        std::vector<COMPILER::BasicBlock *> blocks; // the predecessor each arg comes from
     };
 
     class IRAssign : public IRInst
@@ -520,6 +528,50 @@ namespace COMPILER
         }
     };
 
+    // goes to the block of the case which equals `cond`, or to `default_block` if there is none.
+    // the cases are distinct int or string constants, an int case doesn't match a double.
+    class IRSwitch : public IRInst
+    {
+      public:
+        using IRInst::IRInst;
+        IRSwitch()
+        {
+            tag = Tag::SWITCH;
+        }
+        COMPILER::IRVar *cond{ nullptr };
+        std::vector<std::pair<CYX::Value, COMPILER::BasicBlock *>> cases;
+        COMPILER::BasicBlock *default_block{ nullptr };
+        COMPILER::BasicBlock *target(CYX::Value &value)
+        {
+            for (auto &[key, block] : cases)
+            {
+                // an int case takes an equal double too, the same as `==` does
+                if ((key.isSameType(value) || (key.is<long long>() && value.is<double>())) && key == value)
+                    return block;
+            }
+            return default_block;
+        }
+        void replaceTarget(COMPILER::BasicBlock *from, COMPILER::BasicBlock *to)
+        {
+            for (auto &x : cases)
+            {
+                if (x.second == from) x.second = to;
+            }
+            if (default_block == from) default_block = to;
+        }
+        std::string toString() override
+        {
+            std::string retval = (id >= 0 ? std::to_string(id) + " " : "") + "switch ";
+            if (cond) retval += cond->toString() + " ";
+            for (auto &[key, block] : cases)
+            {
+                retval += "case " + key.as<std::string>() + " goto " + block->name + " ";
+            }
+            if (default_block != nullptr) retval += "else goto " + default_block->name + " ";
+            return retval;
+        }
+    };
+
     static bool forceRemoveVar(IRVar *var)
     {
         if (var == nullptr) return false;
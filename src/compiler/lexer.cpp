@@ -1,61 +1,83 @@
 #include "lexer.h"
 
-COMPILER::Lexer::Lexer(std::string raw_code) : raw_code(raw_code)
+namespace
 {
-    current_char = raw_code[0];
-    pos          = 0;
-    keyword      = {
-        { "if", Keyword::IF },             //
-        { "else", Keyword::ELSE },         //
-        { "for", Keyword::FOR },           //
-        { "while", Keyword::WHILE },       //
-        { "switch", Keyword::SWITCH },     //
-        { "break", Keyword::BREAK },       //
-        { "continue", Keyword::CONTINUE }, //
-        { "true", Keyword::TRUE },         //
-        { "false", Keyword::FALSE },       //
-        { "def", Keyword::DEF },           //
-        { "return", Keyword::RETURN },     //
-        { "import", Keyword::IMPORT },     //
+    struct KeywordSlot
+    {
+        std::string_view word;
+        COMPILER::Keyword keyword{ COMPILER::Keyword::IDENTIFIER };
+    };
+
+    constexpr KeywordSlot keywords[] = {
+        { "if", COMPILER::Keyword::IF },             //
+        { "else", COMPILER::Keyword::ELSE },         //
+        { "for", COMPILER::Keyword::FOR },           //
+        { "while", COMPILER::Keyword::WHILE },       //
+        { "switch", COMPILER::Keyword::SWITCH },     //
+        { "break", COMPILER::Keyword::BREAK },       //
+        { "continue", COMPILER::Keyword::CONTINUE }, //
+        { "true", COMPILER::Keyword::TRUE },         //
+        { "false", COMPILER::Keyword::FALSE },       //
+        { "def", COMPILER::Keyword::DEF },           //
+        { "return", COMPILER::Keyword::RETURN },     //
+        { "import", COMPILER::Keyword::IMPORT },     //
+        { "yield", COMPILER::Keyword::YIELD },       //
     };
-    column = 0;
-    row    = 1;
+} // namespace
+
+COMPILER::Lexer::Lexer(std::string_view raw_code) : raw_code(raw_code)
+{
+    current_char = raw_code.empty() ? EOF : raw_code[0];
+    pos          = 0;
+}
+
+COMPILER::Keyword COMPILER::Lexer::keywordOf(std::string_view word)
+{
+    // a constant expression only if no two keywords share a slot
+    static constexpr auto table = []
+    {
+        std::array<KeywordSlot, KEYWORD_SLOTS> table{};
+        for (const auto &slot : keywords)
+        {
+            auto &entry = table[keywordHash(slot.word)];
+            if (!entry.word.empty()) throw "keywordHash() has a collision";
+            entry = slot;
+        }
+        return table;
+    }();
+    const auto &slot = table[keywordHash(word)];
+    return slot.word == word ? slot.keyword : Keyword::IDENTIFIER;
 }
 
 void COMPILER::Lexer::skipBlank()
 {
-    while (isspace(current_char))
-        advance();
+    if (current_char == EOF) return;
+    seek(scanBlank(raw_code.data(), pos, raw_code.size()));
 }
 
 void COMPILER::Lexer::skipSingleLineComment()
 {
-    while (current_char != '\n' && current_char != EOF)
-        advance();
+    if (current_char == EOF) return;
+    seek(scanChar(raw_code.data(), pos, raw_code.size(), '\n'));
 }
 
 void COMPILER::Lexer::skipMultiLineComment()
 {
-    while (true)
-    {
-        if (current_char == '*' && peekNextChar() == '/') break;
-        advance();
-    }
-    advance(); // *
-    advance(); // /
+    // an unterminated comment runs to the end
+    if (current_char == EOF) return;
+    seek(scanCommentEnd(raw_code.data(), pos, raw_code.size()) + 2);
 }
 
 COMPILER::Token COMPILER::Lexer::number()
 {
-    std::string retval;
-    bool is_double = false;
+    const int begin = pos;
+    bool is_double  = false;
     while (isdigit(current_char) || (!is_double && current_char == '.'))
     {
         if (current_char == '.') is_double = true;
-        retval.push_back(current_char);
         advance();
     }
-    return Token(is_double ? Keyword::DOUBLE : Keyword::INTEGER, retval, row, column);
+    return Token(is_double ? Keyword::DOUBLE : Keyword::INTEGER, lexeme(begin), 0, 0);
 }
 
 void COMPILER::Lexer::advance()
@@ -63,24 +85,36 @@ void COMPILER::Lexer::advance()
     if (pos + 1 >= raw_code.size())
         current_char = EOF;
     else
-    {
-        if (current_char == '\n')
-        {
-            column = 1;
-            row++;
-        }
-        else
-        {
-            column++;
-        }
         current_char = raw_code[++pos];
+}
+
+void COMPILER::Lexer::seek(size_t target)
+{
+    if (target >= raw_code.size())
+    {
+        // like `advance()`, `pos` stays on the last char
+        pos          = raw_code.empty() ? 0 : raw_code.size() - 1;
+        current_char = EOF;
+    }
+    else
+    {
+        pos          = target;
+        current_char = raw_code[pos];
     }
 }
 
 COMPILER::Token COMPILER::Lexer::nextToken()
 {
-#define MK_TOKEN(KW) Token((KW), row, column)
-#define MK_TOKEN2(KW, ID) Token((KW), ID, row, column)
+    auto token = scanToken();
+    if (token.keyword == Keyword::INVALID) return token;
+    std::tie(token.row, token.column) = position();
+    return token;
+}
+
+COMPILER::Token COMPILER::Lexer::scanToken()
+{
+#define MK_TOKEN(KW) Token((KW), 0, 0)
+#define MK_TOKEN2(KW, ID) Token((KW), ID, 0, 0)
 #define CASE_TOKEN(ID, KW)                                                                                             \
     case ID: advance(); return MK_TOKEN(KW)
 
@@ -176,19 +210,19 @@ COMPILER::Token COMPILER::Lexer::nextToken()
             {
                 advance();
                 skipMultiLineComment();
-                return nextToken();
+                return scanToken();
             }
             else if (current_char == '/')
             {
                 advance();
                 skipSingleLineComment();
-                return nextToken();
+                return scanToken();
             }
             return MK_TOKEN2(Keyword::DIV, "/");
         case '#':
             advance();
             skipSingleLineComment();
-            return nextToken();
+            return scanToken();
         case '%':
             advance();
             if (current_char == '=')
@@ -257,43 +291,50 @@ char COMPILER::Lexer::peekNextChar() const
         return EOF;
 }
 
-std::pair<int, int> COMPILER::Lexer::position() const
+std::pair<int, int> COMPILER::Lexer::position()
 {
-    return std::pair<int, int>(row, column);
+    if (pos > counted)
+    {
+        int newlines = countNewlines(raw_code.data(), counted, pos);
+        if (newlines > 0)
+        {
+            row += newlines;
+            last_newline = raw_code.rfind('\n', pos - 1);
+        }
+        counted = pos;
+    }
+    // the first row starts at column 0, the others at 1
+    return std::pair<int, int>(row, last_newline == -1 ? pos : pos - last_newline);
 }
 
 COMPILER::Token COMPILER::Lexer::identifier()
 {
-    std::string tk;
-
-    while (isalnum(current_char) || current_char == '_')
-    {
-        tk.push_back(current_char);
-        advance();
-    }
+    const int begin = pos;
+    seek(scanWord(raw_code.data(), pos, raw_code.size()));
 
-    try
-    {
-        return Token(keyword.at(tk), "", row, column);
-    }
-    catch (const std::out_of_range &ignore)
-    {
-        return Token(Keyword::IDENTIFIER, tk, row, column);
-    }
+    auto tk      = lexeme(begin);
+    auto keyword = keywordOf(tk);
+    if (keyword != Keyword::IDENTIFIER) return Token(keyword, "", 0, 0);
+    return Token(Keyword::IDENTIFIER, tk, 0, 0);
 }
 
 COMPILER::Token COMPILER::Lexer::string()
 {
-    std::string retval;
     char target = '\'';
     if (current_char == '"') target = '"';
     advance();
-    while (current_char != target)
-    {
-        retval.push_back(current_char);
-        advance();
-    }
+    // an unterminated string runs to the end
+    const int begin = pos;
+    if (current_char != EOF) seek(scanChar(raw_code.data(), pos, raw_code.size(), target));
+    auto retval = lexeme(begin);
     advance();
 
-    return COMPILER::Token(Keyword::STRING, retval, row, column);
+    return COMPILER::Token(Keyword::STRING, retval, 0, 0);
+}
+
+std::string_view COMPILER::Lexer::lexeme(int begin) const
+{
+    // `pos` stays on the last char once the end is reached
+    int end = current_char == EOF ? raw_code.size() : pos;
+    return raw_code.substr(begin, end - begin);
 }
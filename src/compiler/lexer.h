@@ -1,11 +1,14 @@
 #ifndef CVM_LEXER_H
 #define CVM_LEXER_H
 
+#include "scan.hpp"
 #include "token.hpp"
 
+#include <array>
 #include <cctype>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <tuple>
 #include <utility>
 
 namespace COMPILER
@@ -13,14 +16,16 @@ namespace COMPILER
     class Lexer
     {
       public:
-        explicit Lexer(std::string raw_code);
+        // `raw_code` isn't copied, tokens refer to it
+        explicit Lexer(std::string_view raw_code);
         void skipBlank();
         void skipSingleLineComment();
         void skipMultiLineComment();
         void advance();
         char currentChar() const;
         char peekNextChar() const;
-        std::pair<int, int> position() const;
+        // rows are counted up to the current char only when a position is asked for
+        std::pair<int, int> position();
         Token nextToken();
 
       public:
@@ -29,13 +34,28 @@ namespace COMPILER
         Token string();
 
       private:
-        std::string raw_code;
-        std::unordered_map<std::string, Keyword> keyword;
+        Token scanToken();
+        // moves to `target`, or to the end if it's out of the source
+        void seek(size_t target);
+        // the source from `begin` to the current char
+        std::string_view lexeme(int begin) const;
+        // `Keyword::IDENTIFIER` if `word` isn't a keyword
+        static Keyword keywordOf(std::string_view word);
+        static constexpr int keywordHash(std::string_view word)
+        {
+            return (word.size() * 3 + word.front() + word.back()) & (KEYWORD_SLOTS - 1);
+        }
+
+      private:
+        // every keyword has a slot of its own under `keywordHash()`
+        static constexpr int KEYWORD_SLOTS = 32;
+        std::string_view raw_code;
         char current_char{ 0 };
         int pos{ 0 };
         //
-        int row{ 0 };
-        int column{ 0 };
+        int row{ 1 };
+        int counted{ 0 };       // newlines before it are counted in `row`
+        int last_newline{ -1 }; // the last one of them
     };
 
 } // namespace COMPILER
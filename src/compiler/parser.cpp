@@ -14,7 +14,7 @@ bool COMPILER::Parser::eat(COMPILER::Keyword tk)
         eat();
         return true;
     }
-    CERR("expected " + keyword_table[tk].identifier + " in " + std::to_string(cur_token.row) + ":" +
+    THROW("expected " + keyword_table[tk].identifier + " in " + std::to_string(cur_token.row) + ":" +
          std::to_string(cur_token.column));
 }
 
@@ -82,14 +82,14 @@ COMPILER::Expr *COMPILER::Parser::parsePrimaryExpr()
     else if (cur_token.keyword == Keyword::INTEGER)
     {
         auto *int_expr  = new IntExpr(cur_token.row, cur_token.column);
-        int_expr->value = std::stoll(cur_token.value);
+        int_expr->value = std::stoll(std::string(cur_token.value));
         eat(Keyword::INTEGER);
         return int_expr;
     }
     else if (cur_token.keyword == Keyword::DOUBLE)
     {
         auto *double_expr  = new DoubleExpr(cur_token.row, cur_token.column);
-        double_expr->value = std::stod(cur_token.value);
+        double_expr->value = std::stod(std::string(cur_token.value));
         eat(Keyword::DOUBLE);
         return double_expr;
     }
@@ -261,6 +261,7 @@ COMPILER::Stmt *COMPILER::Parser::parseStmt()
         case Keyword::WHILE: retval = parseWhileStmt(); break;
         case Keyword::IMPORT: retval = parseImportStmt(); break;
         case Keyword::RETURN: retval = parseReturnStmt(); break;
+        case Keyword::YIELD: retval = parseYieldStmt(); break;
         case Keyword::BREAK: retval = parseBreakStmt(); break;
         case Keyword::CONTINUE: retval = parseContinueStmt(); break;
         case Keyword::SWITCH: retval = parseSwitchStmt(); break;
@@ -337,7 +338,7 @@ std::vector<std::string> COMPILER::Parser::parseParamListStmt()
 
     while (inOr(cur_token.keyword, Keyword::COMMA, Keyword::IDENTIFIER))
     {
-        if (cur_token.keyword == Keyword::IDENTIFIER) params.push_back(cur_token.value);
+        if (cur_token.keyword == Keyword::IDENTIFIER) params.emplace_back(cur_token.value);
         eat();
     }
 
@@ -442,6 +443,18 @@ COMPILER::Stmt *COMPILER::Parser::parseReturnStmt()
     return return_stmt;
 }
 
+COMPILER::Stmt *COMPILER::Parser::parseYieldStmt()
+{
+    // `yield a` is a call of the `yield` buildin, the VM stops there and hands `a` to the host
+    auto *yield_stmt          = new ExprStmt(cur_token.row, cur_token.column);
+    auto *func_call_expr      = new FuncCallExpr(cur_token.row, cur_token.column);
+    func_call_expr->func_name = "yield";
+    eat(Keyword::YIELD);
+    if (auto *value = parseExprStmt(); value != nullptr) func_call_expr->args.push_back(value);
+    yield_stmt->expr = func_call_expr;
+    return yield_stmt;
+}
+
 COMPILER::Stmt *COMPILER::Parser::parseBreakStmt()
 {
     auto *break_stmt = new BreakStmt(cur_token.row, cur_token.column);
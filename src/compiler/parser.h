@@ -17,7 +17,8 @@ namespace COMPILER
     class Parser
     {
       public:
-        explicit Parser(std::string code) : lexer(std::move(code))
+        // `code` has to outlive the parser and the tree, see `SourceFile`
+        explicit Parser(std::string_view code) : lexer(code)
         {
             cur_token = lexer.nextToken();
             pre_token = Token(Keyword::INVALID, "", -1, -1);
@@ -51,6 +52,7 @@ namespace COMPILER
         COMPILER::Stmt *parseForStmt();
         COMPILER::Stmt *parseWhileStmt();
         COMPILER::Stmt *parseReturnStmt();
+        COMPILER::Stmt *parseYieldStmt();
         COMPILER::Stmt *parseBreakStmt();
         COMPILER::Stmt *parseContinueStmt();
         COMPILER::Stmt *parseImportStmt();
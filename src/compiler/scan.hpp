@@ -0,0 +1,194 @@
+#ifndef CVM_SCAN_HPP
+#define CVM_SCAN_HPP
+
+#include <cstddef>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#define CYX_SCAN_SIMD
+#endif
+
+// Scanning kernels of the lexer. Each one looks at 32 (AVX2) or 16 (SSE2) bytes at a time and finishes the
+// tail byte by byte, the vector width is chosen at compile time (e.g. `-DCYX_NATIVE=ON`).
+// `s[begin, end)` is scanned, a kernel returns `end` if it doesn't stop before.
+namespace COMPILER
+{
+    // most blanks and identifiers are shorter, they are scanned byte by byte before loading a vector
+    constexpr size_t SHORT_RUN = 8;
+
+#ifdef CYX_SCAN_SIMD
+    namespace SIMD
+    {
+#if defined(__AVX2__)
+        using Vec                 = __m256i;
+        constexpr size_t WIDTH    = 32;
+        constexpr unsigned ALL_ON = 0xFFFFFFFFu;
+        inline Vec load(const char *p)
+        {
+            return _mm256_loadu_si256(reinterpret_cast<const Vec *>(p));
+        }
+        inline Vec set(char c)
+        {
+            return _mm256_set1_epi8(c);
+        }
+        inline Vec eq(Vec a, Vec b)
+        {
+            return _mm256_cmpeq_epi8(a, b);
+        }
+        inline Vec sub(Vec a, Vec b)
+        {
+            return _mm256_sub_epi8(a, b);
+        }
+        inline Vec min(Vec a, Vec b)
+        {
+            return _mm256_min_epu8(a, b);
+        }
+        inline Vec bitOr(Vec a, Vec b)
+        {
+            return _mm256_or_si256(a, b);
+        }
+        inline unsigned mask(Vec a)
+        {
+            return _mm256_movemask_epi8(a);
+        }
+#else
+        using Vec                 = __m128i;
+        constexpr size_t WIDTH    = 16;
+        constexpr unsigned ALL_ON = 0xFFFFu;
+        inline Vec load(const char *p)
+        {
+            return _mm_loadu_si128(reinterpret_cast<const Vec *>(p));
+        }
+        inline Vec set(char c)
+        {
+            return _mm_set1_epi8(c);
+        }
+        inline Vec eq(Vec a, Vec b)
+        {
+            return _mm_cmpeq_epi8(a, b);
+        }
+        inline Vec sub(Vec a, Vec b)
+        {
+            return _mm_sub_epi8(a, b);
+        }
+        inline Vec min(Vec a, Vec b)
+        {
+            return _mm_min_epu8(a, b);
+        }
+        inline Vec bitOr(Vec a, Vec b)
+        {
+            return _mm_or_si128(a, b);
+        }
+        inline unsigned mask(Vec a)
+        {
+            return _mm_movemask_epi8(a);
+        }
+#endif
+        // bytes in [lo, lo + len], compared unsigned
+        inline Vec inRange(Vec v, char lo, char len)
+        {
+            auto x = sub(v, set(lo));
+            return eq(min(x, set(len)), x);
+        }
+    } // namespace SIMD
+#endif
+
+    inline bool isBlankChar(char c)
+    {
+        return c == ' ' || static_cast<unsigned char>(c - '\t') <= '\r' - '\t';
+    }
+
+    inline bool isWordChar(char c)
+    {
+        return static_cast<unsigned char>((c | 0x20) - 'a') <= 'z' - 'a' ||
+               static_cast<unsigned char>(c - '0') <= '9' - '0' || c == '_';
+    }
+
+    // the first char which isn't a space, `\t`, `\n`, `\v`, `\f` or `\r`
+    inline size_t scanBlank(const char *s, size_t begin, size_t end)
+    {
+        size_t i = begin;
+        for (; i < end && i < begin + SHORT_RUN; i++)
+        {
+            if (!isBlankChar(s[i])) return i;
+        }
+#ifdef CYX_SCAN_SIMD
+        for (; i + SIMD::WIDTH <= end; i += SIMD::WIDTH)
+        {
+            auto v     = SIMD::load(s + i);
+            auto blank = SIMD::bitOr(SIMD::eq(v, SIMD::set(' ')), SIMD::inRange(v, '\t', '\r' - '\t'));
+            unsigned m = SIMD::mask(blank);
+            if (m != SIMD::ALL_ON) return i + __builtin_ctz(~m);
+        }
+#endif
+        while (i < end && isBlankChar(s[i]))
+        {
+            i++;
+        }
+        return i;
+    }
+
+    // the first char which can't be part of an identifier
+    inline size_t scanWord(const char *s, size_t begin, size_t end)
+    {
+        size_t i = begin;
+        for (; i < end && i < begin + SHORT_RUN; i++)
+        {
+            if (!isWordChar(s[i])) return i;
+        }
+#ifdef CYX_SCAN_SIMD
+        for (; i + SIMD::WIDTH <= end; i += SIMD::WIDTH)
+        {
+            auto v     = SIMD::load(s + i);
+            auto alpha = SIMD::inRange(SIMD::bitOr(v, SIMD::set(0x20)), 'a', 'z' - 'a');
+            auto digit = SIMD::inRange(v, '0', '9' - '0');
+            auto word  = SIMD::bitOr(SIMD::bitOr(alpha, digit), SIMD::eq(v, SIMD::set('_')));
+            unsigned m = SIMD::mask(word);
+            if (m != SIMD::ALL_ON) return i + __builtin_ctz(~m);
+        }
+#endif
+        while (i < end && isWordChar(s[i]))
+        {
+            i++;
+        }
+        return i;
+    }
+
+    // the first `c`, libc's `memchr` is vectorized already
+    inline size_t scanChar(const char *s, size_t begin, size_t end, char c)
+    {
+        if (begin >= end) return end;
+        auto *found = static_cast<const char *>(std::memchr(s + begin, c, end - begin));
+        return found == nullptr ? end : found - s;
+    }
+
+    // the `*` of the first `*/`
+    inline size_t scanCommentEnd(const char *s, size_t begin, size_t end)
+    {
+        for (size_t i = scanChar(s, begin, end, '*'); i < end; i = scanChar(s, i + 1, end, '*'))
+        {
+            if (i + 1 < end && s[i + 1] == '/') return i;
+        }
+        return end;
+    }
+
+    inline size_t countNewlines(const char *s, size_t begin, size_t end)
+    {
+        size_t count = 0;
+        size_t i     = begin;
+#ifdef CYX_SCAN_SIMD
+        for (; i + SIMD::WIDTH <= end; i += SIMD::WIDTH)
+        {
+            count += __builtin_popcount(SIMD::mask(SIMD::eq(SIMD::load(s + i), SIMD::set('\n'))));
+        }
+#endif
+        for (; i < end; i++)
+        {
+            count += s[i] == '\n';
+        }
+        return count;
+    }
+} // namespace COMPILER
+
+#endif // CVM_SCAN_HPP
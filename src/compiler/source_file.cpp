@@ -0,0 +1,52 @@
+#include "source_file.h"
+
+#include "../utility/log.h"
+
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+COMPILER::SourceFile::SourceFile(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd != -1)
+    {
+        struct stat st = {};
+        const bool stat_ok = fstat(fd, &st) == 0;
+        if (stat_ok && S_ISDIR(st.st_mode))
+        {
+            close(fd);
+            THROW("can't read source file `" + path + "`, it is a directory");
+        }
+        if (stat_ok && S_ISREG(st.st_mode) && st.st_size > 0)
+        {
+            void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED)
+            {
+                // the lexer reads it once from front to back
+                madvise(addr, st.st_size, MADV_SEQUENTIAL);
+                mapped      = static_cast<const char *>(addr);
+                mapped_size = st.st_size;
+            }
+        }
+        close(fd);
+    }
+    if (mapped != nullptr) return;
+    std::ifstream in(path, std::ios::in);
+    if (!in.is_open()) THROW("can't open source file `" + path + "`");
+    buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+COMPILER::SourceFile::~SourceFile()
+{
+    if (mapped != nullptr) munmap(const_cast<char *>(mapped), mapped_size);
+}
+
+std::string_view COMPILER::SourceFile::code() const
+{
+    if (mapped != nullptr) return { mapped, mapped_size };
+    return buffer;
+}
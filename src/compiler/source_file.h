@@ -0,0 +1,28 @@
+#ifndef CVM_SOURCE_FILE_H
+#define CVM_SOURCE_FILE_H
+
+#include <string>
+#include <string_view>
+
+namespace COMPILER
+{
+    // The source of a script, mapped into memory read only. Tokens and the AST refer to it through
+    // `std::string_view`, so it has to outlive the parser and the tree. If the file can't be mapped
+    // (e.g. it's empty or a pipe), it is read into a string instead. Throws `CYX::Error` if it can't be opened.
+    class SourceFile
+    {
+      public:
+        explicit SourceFile(const std::string &path);
+        SourceFile(const SourceFile &) = delete;
+        SourceFile &operator=(const SourceFile &) = delete;
+        ~SourceFile();
+        std::string_view code() const;
+
+      private:
+        const char *mapped{ nullptr };
+        size_t mapped_size{ 0 };
+        std::string buffer;
+    };
+} // namespace COMPILER
+
+#endif // CVM_SOURCE_FILE_H
@@ -3,6 +3,7 @@
 
 #include <ostream>
 #include <string>
+#include <string_view>
 
 namespace COMPILER
 {
@@ -25,6 +26,7 @@ namespace COMPILER
         DEF,        // def
         RETURN,     // return
         IMPORT,     // import
+        YIELD,      // yield
 
         // Binary opcode
 
@@ -112,6 +114,7 @@ namespace COMPILER
         { DEF, "def", STR(DEF) },                          // def
         { RETURN, "return", STR(RETURN) },                 // return
         { IMPORT, "import", STR(IMPORT) },                 // import
+        { YIELD, "yield", STR(YIELD) },                    // yield
 
         // Binary opcode
 
@@ -181,12 +184,13 @@ namespace COMPILER
     {
       public:
         Token() = default;
-        Token(Keyword keyword, std::string value, int row, int column)
-            : keyword(keyword), value(std::move(value)), row(row), column(column){};
+        Token(Keyword keyword, std::string_view value, int row, int column)
+            : keyword(keyword), value(value), row(row), column(column){};
         Token(Keyword keyword, int row, int column)
             : keyword(keyword), value(keyword_table[keyword].identifier), row(row), column(column){};
         Keyword keyword{ 0 };
-        std::string value;
+        // points into the source or `keyword_table`, it isn't owned by the token
+        std::string_view value;
         int row{ 0 };
         int column{ 0 };
 
@@ -3,6 +3,10 @@
 void CVM::BytecodeReader::readInsts()
 {
     in.open(filename, std::ios::in | std::ios::binary);
+    if (!in.is_open()) THROW("can't open bytecode file `" + filename + "`");
+    in.seekg(0, std::ios::end);
+    file_size = in.tellg();
+    in.seekg(0, std::ios::beg);
     readHeader();
     while (in.peek() != EOF)
     {
@@ -41,6 +45,15 @@ void CVM::BytecodeReader::readInsts()
             case CVM::Opcode::LOADX: readLoadX(); break;
             case CVM::Opcode::STOREX: readStoreX(); break;
             case CVM::Opcode::STOREA: readStoreA(); break;
+            // nothing proves their indices are in bounds, a file could index past the end of an array
+            case CVM::Opcode::LOADXU:
+            case CVM::Opcode::STOREXU:
+            case CVM::Opcode::STOREAU:
+                THROW("bytecode verify error at #" + std::to_string(vm_insts.size()) + ": unchecked array access " +
+                      opcode2Str(cur_opcode));
+            case CVM::Opcode::ADDI: readAddI(); break;
+            case CVM::Opcode::BINXX:
+            case CVM::Opcode::BINXI: readBinaryX(); break;
             case CVM::Opcode::CALL: readCall(); break;
             case CVM::Opcode::FUNC: readFunc(); break;
             case CVM::Opcode::ARG: readArg(); break;
@@ -48,9 +61,31 @@ void CVM::BytecodeReader::readInsts()
             case CVM::Opcode::RET: readRet(); break;
             case CVM::Opcode::JMP: readJmp(); break;
             case CVM::Opcode::JIF: readJif(); break;
-            default: LOGD("unknown opcode"); break;
+            case CVM::Opcode::JTABLE: readJTable(); break;
+            case CVM::Opcode::JLOOKUP: readJLookup(); break;
+            default: THROW("bytecode verify error at #" + std::to_string(vm_insts.size()) + ": unknown opcode 0x" +
+                           digit2HexStr((int) opcode2UChar(cur_opcode)));
         }
+        // the instruction is in `vm_insts` already, the destructor frees it
+        if (in.fail())
+            THROW("bytecode verify error at #" + std::to_string(vm_insts.size() - 1) + ": " +
+                  (corruption.empty() ? "truncated file" : corruption));
+        // verify while streaming, the VM relies on it to skip its runtime checks.
+        verifier.visit(vm_insts.back());
     }
+    verifier.finish(entry, entry_end, global_var_len);
+}
+
+CVM::Program CVM::BytecodeReader::program()
+{
+    Program program;
+    program.vm_insts       = std::move(vm_insts);
+    program.entry          = entry;
+    program.entry_end      = entry_end;
+    program.global_var_len = global_var_len;
+    program.indexFuncs();
+    vm_insts.clear();
+    return program;
 }
 
 void CVM::BytecodeReader::readHeader()
@@ -60,7 +95,8 @@ void CVM::BytecodeReader::readHeader()
     entry             = readInt();
     entry_end         = readInt();
     global_var_len    = readInt();
-    if (magic_number != 0xc2 && version != 0x01) LOGE("bytecode file error!");
+    if (in.fail()) THROW("bytecode file `" + filename + "` is truncated");
+    if (magic_number != 0xc2 || version != 0x03) THROW("`" + filename + "` is no bytecode file of this version");
 }
 
 unsigned char CVM::BytecodeReader::readByte()
@@ -87,6 +123,12 @@ double CVM::BytecodeReader::readDouble()
 std::string CVM::BytecodeReader::readString()
 {
     auto str_len = readInt();
+    if (in.fail()) return {};
+    if (str_len < 0 || str_len > file_size - in.tellg())
+    {
+        corrupt("string length out of range");
+        return {};
+    }
     char *tmp    = new char[str_len + 1];
     tmp[str_len] = '\0';
     in.read(tmp, str_len);
@@ -95,6 +137,13 @@ std::string CVM::BytecodeReader::readString()
     return ret;
 }
 
+void CVM::BytecodeReader::corrupt(const std::string &what)
+{
+    // reported by `readInsts()` once the instruction is complete
+    if (corruption.empty()) corruption = what;
+    in.setstate(std::ios::failbit);
+}
+
 CVM::Opcode CVM::BytecodeReader::readOpcode()
 {
     return CVM::uchar2Opcode(readByte());
@@ -102,15 +151,15 @@ CVM::Opcode CVM::BytecodeReader::readOpcode()
 
 void CVM::BytecodeReader::readUnary()
 {
-    auto type = readByte();
     Unary *inst{ nullptr };
     if (cur_opcode == Opcode::LNOT)
         inst = new Lnot;
     else
         inst = new Bnot;
 
-    // type tag. only string and int
     inst->reg_idx = readByte();
+    // type tag. only string and int
+    auto type = readByte();
     if (type == 0)
     {
         inst->type  = ArgType::RAW;
@@ -126,35 +175,35 @@ void CVM::BytecodeReader::readUnary()
 
 void CVM::BytecodeReader::readBinary()
 {
-    Binary *tmp{ nullptr };
-    switch (cur_opcode)
-    {
-        case CVM::Opcode::ADD: tmp = new Add; break;
-        case CVM::Opcode::SUB: tmp = new Sub; break;
-        case CVM::Opcode::MUL: tmp = new Mul; break;
-        case CVM::Opcode::DIV: tmp = new Div; break;
-        case CVM::Opcode::MOD: tmp = new Mod; break;
-        case CVM::Opcode::EXP: tmp = new Exp; break;
-        case CVM::Opcode::BAND: tmp = new Band; break;
-        case CVM::Opcode::BOR: tmp = new Bor; break;
-        case CVM::Opcode::BXOR: tmp = new Bxor; break;
-        case CVM::Opcode::SHL: tmp = new Shl; break;
-        case CVM::Opcode::SHR: tmp = new Shr; break;
-        case CVM::Opcode::LOR: tmp = new Lor; break;
-        case CVM::Opcode::NE: tmp = new Ne; break;
-        case CVM::Opcode::EQ: tmp = new Eq; break;
-        case CVM::Opcode::LT: tmp = new Lt; break;
-        case CVM::Opcode::LE: tmp = new Le; break;
-        case CVM::Opcode::GT: tmp = new Gt; break;
-        case CVM::Opcode::GE: tmp = new Ge; break;
-        case CVM::Opcode::LAND: tmp = new Land; break;
-        default: LOGE("WTF");
-    }
+    auto *tmp     = newBinary(cur_opcode);
     tmp->reg_idx1 = readByte();
     tmp->reg_idx2 = readByte();
     vm_insts.push_back(tmp);
 }
 
+void CVM::BytecodeReader::readAddI()
+{
+    auto *inst    = new AddI;
+    inst->reg_idx = readByte();
+    inst->val     = readInt();
+    vm_insts.push_back(inst);
+}
+
+void CVM::BytecodeReader::readBinaryX()
+{
+    auto *inst     = new BinaryX(cur_opcode);
+    inst->op       = readOpcode();
+    inst->reg_idx1 = readByte();
+    inst->reg_idx2 = readByte();
+    inst->lhs      = readString();
+    if (cur_opcode == Opcode::BINXX)
+        inst->rhs = readString();
+    else
+        inst->val = readInt();
+    inst->dest = readString();
+    vm_insts.push_back(inst);
+}
+
 void CVM::BytecodeReader::readLoadX()
 {
     auto *inst    = new LoadX;
@@ -172,7 +221,7 @@ void CVM::BytecodeReader::readLoadA()
     inst->reg_idx = readByte();
     int idx_size  = readInt();
     std::vector<CYX::Value> arr;
-    for (int i = 0; i < idx_size; i++)
+    for (int i = 0; i < idx_size && !in.fail(); i++)
     {
         const auto type = readByte();
         if (type == 0)
@@ -183,6 +232,8 @@ void CVM::BytecodeReader::readLoadA()
             arr.emplace_back(readString());
         else if (type == 3)
             arr.emplace_back();
+        else
+            corrupt("unknown element type " + std::to_string(type));
     }
     inst->array = std::move(arr);
     vm_insts.push_back(inst);
@@ -222,7 +273,7 @@ void CVM::BytecodeReader::readLoad()
         vm_insts.push_back(inst);
     }
     else
-        UNREACHABLE();
+        THROW("can't read a constant of this type");
 }
 
 void CVM::BytecodeReader::readStoreX()
@@ -278,7 +329,7 @@ void CVM::BytecodeReader::readStore()
         vm_insts.push_back(inst);
     }
     else
-        UNREACHABLE();
+        THROW("can't read a constant of this type");
 }
 
 void CVM::BytecodeReader::readArg()
@@ -322,6 +373,8 @@ void CVM::BytecodeReader::readFunc()
 {
     auto *inst        = new Func;
     inst->param_count = readByte();
+    inst->memoize     = readByte() != 0;
+    inst->name        = readString();
     vm_insts.push_back(inst);
 }
 
@@ -353,10 +406,47 @@ void CVM::BytecodeReader::readJif()
     vm_insts.push_back(inst);
 }
 
+void CVM::BytecodeReader::readJTable()
+{
+    auto *inst     = new JTable;
+    inst->reg_idx  = readByte();
+    inst->base     = readInt();
+    const auto len = readInt();
+    for (int i = 0; i < len && !in.fail(); i++)
+    {
+        inst->targets.push_back(readInt());
+    }
+    inst->default_target = readInt();
+    vm_insts.push_back(inst);
+}
+
+void CVM::BytecodeReader::readJLookup()
+{
+    auto *inst         = new JLookup;
+    inst->reg_idx      = readByte();
+    const auto int_len = readInt();
+    for (int i = 0; i < int_len && !in.fail(); i++)
+    {
+        inst->int_keys.push_back(readInt());
+    }
+    const auto str_len = readInt();
+    for (int i = 0; i < str_len && !in.fail(); i++)
+    {
+        inst->str_keys.push_back(readString());
+    }
+    for (int i = 0; i < int_len + str_len && !in.fail(); i++)
+    {
+        inst->targets.push_back(readInt());
+    }
+    inst->default_target = readInt();
+    inst->indexKeys();
+    vm_insts.push_back(inst);
+}
+
 void CVM::BytecodeReader::readArrIdx(std::vector<ArrIdx> &arr_idx)
 {
     auto arr_size = readInt();
-    for (int i = 0; i < arr_size; i++)
+    for (int i = 0; i < arr_size && !in.fail(); i++)
     {
         const auto type = readByte();
         if (type == 0)
@@ -368,7 +458,7 @@ void CVM::BytecodeReader::readArrIdx(std::vector<ArrIdx> &arr_idx)
             arr_idx.emplace_back(readString());
         }
         else
-            UNREACHABLE();
+            corrupt("unknown index type " + std::to_string(type));
     }
 }
 
@@ -2,7 +2,10 @@
 #define CVM_BYTECODE_READER_H
 
 #include "../utility/log.h"
+#include "../utility/utility.hpp"
+#include "bytecode_verifier.h"
 #include "opcode.hpp"
+#include "program.hpp"
 #include "vm_instruction.hpp"
 
 #include <cmath>
@@ -18,7 +21,19 @@ namespace CVM
         explicit BytecodeReader(std::string filename) : filename(std::move(filename))
         {
         }
+        BytecodeReader(const BytecodeReader &) = delete;
+        BytecodeReader &operator=(const BytecodeReader &) = delete;
+        ~BytecodeReader()
+        {
+            for (auto *inst : vm_insts)
+            {
+                delete inst;
+            }
+        }
+        // throws `CYX::Error` if the file can't be opened, is truncated or doesn't verify
         void readInsts();
+        // the instructions of `readInsts()`, verified already
+        Program program();
         std::string vmInstStr();
 
       private:
@@ -27,11 +42,14 @@ namespace CVM
         long long readInt();
         double readDouble();
         std::string readString();
+        void corrupt(const std::string &what);
         //
         CVM::Opcode readOpcode();
         //
         void readUnary();
         void readBinary();
+        void readAddI();
+        void readBinaryX();
         //
         void readLoadX();
         void readLoadA();
@@ -51,6 +69,8 @@ namespace CVM
         void readRet();
         void readJmp();
         void readJif();
+        void readJTable();
+        void readJLookup();
         //
         void readArrIdx(std::vector<ArrIdx> &arr_idx);
 
@@ -62,8 +82,11 @@ namespace CVM
 
       private:
         Opcode cur_opcode;
+        BytecodeVerifier verifier;
         std::string filename;
         std::ifstream in;
+        std::streamoff file_size{ 0 };
+        std::string corruption; // why the current instruction can't be read, see `corrupt()`
     };
 } // namespace CVM
 
@@ -0,0 +1,274 @@
+#include "bytecode_verifier.h"
+
+void CVM::BytecodeVerifier::visit(VMInstruction *inst)
+{
+    const int idx = insts.size();
+    insts.push_back(inst);
+    arg_count.push_back(0);
+
+    if (inst->opcode != Opcode::ARG) cur_call = -1;
+    if (inst->opcode != Opcode::PARAM && cur_func != -1)
+    {
+        auto *func = static_cast<Func *>(insts[cur_func]);
+        if (idx - cur_func - 1 != func->param_count)
+            error("FUNC declares " + std::to_string(func->param_count) + " params but has " +
+                      std::to_string(idx - cur_func - 1),
+                  cur_func);
+        cur_func = -1;
+    }
+
+    switch (inst->opcode)
+    {
+        case Opcode::ADD:
+        case Opcode::SUB:
+        case Opcode::MUL:
+        case Opcode::DIV:
+        case Opcode::MOD:
+        case Opcode::EXP:
+        case Opcode::BAND:
+        case Opcode::BOR:
+        case Opcode::BXOR:
+        case Opcode::SHL:
+        case Opcode::SHR:
+        case Opcode::LOR:
+        case Opcode::NE:
+        case Opcode::EQ:
+        case Opcode::LT:
+        case Opcode::LE:
+        case Opcode::GT:
+        case Opcode::GE:
+        case Opcode::LAND:
+        {
+            auto *tmp = static_cast<Binary *>(inst);
+            verifyReg(tmp->reg_idx1);
+            verifyReg(tmp->reg_idx2);
+            break;
+        }
+        case Opcode::ADDI: verifyReg(static_cast<AddI *>(inst)->reg_idx); break;
+        case Opcode::BINXX:
+        case Opcode::BINXI:
+        {
+            auto *tmp = static_cast<BinaryX *>(inst);
+            if (opcode2UChar(tmp->op) < opcode2UChar(Opcode::ADD) || opcode2UChar(tmp->op) > opcode2UChar(Opcode::LAND))
+                error("fused opcode 0x" + digit2HexStr((int) opcode2UChar(tmp->op)) + " is not a binary op");
+            verifyReg(tmp->reg_idx1);
+            verifyReg(tmp->reg_idx2);
+            verifyName(tmp->lhs);
+            if (tmp->opcode == Opcode::BINXX) verifyName(tmp->rhs);
+            break;
+        }
+        case Opcode::LNOT:
+        case Opcode::BNOT:
+        {
+            auto *tmp = static_cast<Unary *>(inst);
+            verifyReg(tmp->reg_idx);
+            if (tmp->type == ArgType::MAP) verifyName(tmp->name);
+            break;
+        }
+        case Opcode::LOADI:
+        case Opcode::LOADD:
+        case Opcode::LOADS:
+        case Opcode::LOADA: verifyReg(static_cast<Load *>(inst)->reg_idx); break;
+        // the unchecked variants get the same operand checks, their indices were proven by the compiler.
+        // `BytecodeReader` doesn't take them from a file
+        case Opcode::LOADX:
+        case Opcode::LOADXU:
+        {
+            auto *tmp = static_cast<LoadX *>(inst);
+            verifyReg(tmp->reg_idx);
+            verifyName(tmp->name);
+            verifyArrIdx(tmp->index);
+            break;
+        }
+        case Opcode::LOADXA:
+        {
+            auto *tmp = static_cast<LoadXA *>(inst);
+            verifyReg(tmp->reg_idx);
+            verifyName(tmp->name);
+            if (tmp->index < 0) error("negative array slot " + std::to_string(tmp->index));
+            break;
+        }
+        case Opcode::STOREI:
+        case Opcode::STORED:
+        case Opcode::STORES: verifyName(static_cast<Store *>(inst)->name); break;
+        case Opcode::STOREA:
+        case Opcode::STOREAU:
+        {
+            auto *tmp = static_cast<StoreA *>(inst);
+            verifyName(tmp->name);
+            verifyArrIdx(tmp->index);
+            break;
+        }
+        case Opcode::STOREX:
+        case Opcode::STOREXU:
+        {
+            auto *tmp = static_cast<StoreX *>(inst);
+            verifyReg(tmp->reg_idx);
+            verifyName(tmp->name);
+            verifyArrIdx(tmp->index);
+            break;
+        }
+        case Opcode::CALL:
+            cur_call = idx;
+            calls.push_back(idx);
+            break;
+        case Opcode::ARG:
+        {
+            auto *tmp = static_cast<Arg *>(inst);
+            if (cur_call == -1) error("ARG without CALL");
+            arg_count[cur_call]++;
+            if (tmp->type == ArgType::MAP)
+            {
+                verifyName(tmp->name);
+                verifyArrIdx(tmp->index);
+            }
+            else if (!tmp->value.hasValue())
+                error("ARG without value");
+            break;
+        }
+        case Opcode::FUNC:
+            if (static_cast<Func *>(inst)->param_count < 0) error("negative param count");
+            cur_func = idx;
+            break;
+        case Opcode::PARAM:
+            if (cur_func == -1) error("PARAM outside of FUNC header");
+            verifyName(static_cast<Param *>(inst)->name);
+            break;
+        case Opcode::RET: break;
+        case Opcode::JMP:
+        case Opcode::JIF: jumps.push_back(idx); break;
+        case Opcode::JTABLE:
+        {
+            auto *tmp = static_cast<JTable *>(inst);
+            verifyReg(tmp->reg_idx);
+            jumps.push_back(idx);
+            break;
+        }
+        case Opcode::JLOOKUP:
+        {
+            auto *tmp = static_cast<JLookup *>(inst);
+            verifyReg(tmp->reg_idx);
+            if (tmp->targets.size() != tmp->int_keys.size() + tmp->str_keys.size()) error("JLOOKUP key count mismatch");
+            // binary search needs them sorted, equal keys would make the target ambiguous
+            if (std::adjacent_find(tmp->int_keys.begin(), tmp->int_keys.end(), std::greater_equal<>()) !=
+                tmp->int_keys.end())
+                error("JLOOKUP int keys are not strictly increasing");
+            if (tmp->str_index.size() != tmp->str_keys.size()) error("JLOOKUP has duplicate string keys");
+            jumps.push_back(idx);
+            break;
+        }
+        default: error("unknown opcode 0x" + digit2HexStr((int) opcode2UChar(inst->opcode)));
+    }
+}
+
+void CVM::BytecodeVerifier::verify(const Program &program)
+{
+    BytecodeVerifier verifier;
+    for (auto *inst : program.vm_insts)
+    {
+        verifier.visit(inst);
+    }
+    verifier.finish(program.entry, program.entry_end, program.global_var_len);
+}
+
+void CVM::BytecodeVerifier::finish(int entry, int entry_end, int global_var_len)
+{
+    // flush a trailing FUNC header
+    if (cur_func != -1)
+    {
+        auto *func = static_cast<Func *>(insts[cur_func]);
+        if (insts.size() - cur_func - 1 != func->param_count) error("FUNC without body", cur_func);
+    }
+
+    const int size = insts.size();
+    if (global_var_len < 0 || global_var_len > size) error("global data length out of range");
+    if (entry < global_var_len || entry >= size) error("entry out of range");
+    if (entry_end < entry || entry_end >= size) error("entry end out of range");
+    if (insts[entry]->opcode != Opcode::FUNC) error("entry is not a function", entry);
+    // every path has to leave through a jump or a return (or stop at `entry_end`), never by running past the end.
+    if (size > 0 && size - 1 != entry_end &&
+        !inOr(insts.back()->opcode, Opcode::RET, Opcode::JMP, Opcode::JTABLE, Opcode::JLOOKUP))
+        error("instruction stream falls through its end", size - 1);
+
+    for (auto idx : jumps)
+    {
+        if (insts[idx]->opcode == Opcode::JMP)
+        {
+            verifyTarget(static_cast<Jmp *>(insts[idx])->target);
+        }
+        else if (insts[idx]->opcode == Opcode::JIF)
+        {
+            auto *tmp = static_cast<Jif *>(insts[idx]);
+            verifyTarget(tmp->target1);
+            verifyTarget(tmp->target2);
+        }
+        else if (insts[idx]->opcode == Opcode::JTABLE)
+        {
+            auto *tmp = static_cast<JTable *>(insts[idx]);
+            for (auto target : tmp->targets)
+            {
+                verifyTarget(target);
+            }
+            verifyTarget(tmp->default_target);
+        }
+        else
+        {
+            auto *tmp = static_cast<JLookup *>(insts[idx]);
+            for (auto target : tmp->targets)
+            {
+                verifyTarget(target);
+            }
+            verifyTarget(tmp->default_target);
+        }
+    }
+    for (auto idx : calls)
+    {
+        auto *call = static_cast<Call *>(insts[idx]);
+        if (call->target < 0)
+        {
+            // build-in functions use only the first ARG, redundant ones are no-ops.
+            if (buildin_functions_index.find(-call->target) == buildin_functions_index.end())
+                error("unknown build-in function " + std::to_string(-call->target), idx);
+            continue;
+        }
+        if (call->target >= size || insts[call->target]->opcode != Opcode::FUNC)
+            error("call target " + std::to_string(call->target) + " is not a function", idx);
+        auto *func = static_cast<Func *>(insts[call->target]);
+        if (arg_count[idx] != func->param_count)
+            error("function expects " + std::to_string(func->param_count) + " args but got " +
+                      std::to_string(arg_count[idx]),
+                  idx);
+    }
+}
+
+void CVM::BytecodeVerifier::verifyReg(int reg_idx)
+{
+    if (reg_idx < 0 || reg_idx >= REGISTER_COUNT) error("register %" + std::to_string(reg_idx) + " out of range");
+}
+
+void CVM::BytecodeVerifier::verifyName(const std::string &name)
+{
+    if (name.empty()) error("empty symbol name");
+}
+
+void CVM::BytecodeVerifier::verifyArrIdx(const std::vector<ArrIdx> &arr_idx)
+{
+    for (const auto &idx : arr_idx)
+    {
+        if (std::holds_alternative<std::string>(idx))
+            verifyName(std::get<std::string>(idx));
+        else if (std::get<long long>(idx) < 0)
+            error("negative array index " + std::to_string(std::get<long long>(idx)));
+    }
+}
+
+void CVM::BytecodeVerifier::verifyTarget(int target)
+{
+    if (target < 0 || target >= insts.size()) error("jump target " + std::to_string(target) + " out of range");
+}
+
+void CVM::BytecodeVerifier::error(const std::string &msg, int idx)
+{
+    if (idx == -1) idx = insts.size() - 1;
+    THROW("bytecode verify error at #" + std::to_string(idx) + ": " + msg);
+}
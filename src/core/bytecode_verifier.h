@@ -0,0 +1,50 @@
+#ifndef CVM_BYTECODE_VERIFIER_H
+#define CVM_BYTECODE_VERIFIER_H
+
+#include "../common/buildin.hpp"
+#include "../utility/log.h"
+#include "../utility/utility.hpp"
+#include "opcode.hpp"
+#include "program.hpp"
+#include "vm_instruction.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace CVM
+{
+    // Checks bytecode once at load time, so that `VM::run()` can trust it afterwards.
+    // `visit()` is fed every instruction as soon as it is decoded (local checks: registers,
+    // operands, ARG/PARAM sequences), `finish()` resolves the things that need the whole
+    // stream (jump/call targets, argument counts, header positions).
+    class BytecodeVerifier
+    {
+      public:
+        void visit(VMInstruction *inst);
+        void finish(int entry, int entry_end, int global_var_len);
+        // `visit()` every instruction of `program`, then `finish()`
+        static void verify(const Program &program);
+
+      private:
+        void verifyReg(int reg_idx);
+        void verifyName(const std::string &name);
+        void verifyArrIdx(const std::vector<ArrIdx> &arr_idx);
+        void verifyTarget(int target);
+        [[noreturn]] void error(const std::string &msg, int idx = -1);
+
+      private:
+        std::vector<VMInstruction *> insts;
+        // position of the CALL which owns the ARG sequence being read, -1 if none
+        int cur_call{ -1 };
+        // position of the FUNC which owns the PARAM sequence being read, -1 if none
+        int cur_func{ -1 };
+        std::vector<int> arg_count; // arg_count[i]: ARGs following CALL at i
+        std::vector<int> calls;
+        std::vector<int> jumps;
+    };
+} // namespace CVM
+
+#endif // CVM_BYTECODE_VERIFIER_H
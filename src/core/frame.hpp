@@ -3,6 +3,7 @@
 
 #include "../common/value.hpp"
 
+#include <memory_resource>
 #include <unordered_map>
 
 namespace CVM
@@ -10,8 +11,18 @@ namespace CVM
     class Frame
     {
       public:
-        std::unordered_map<std::string, CYX::Value> symbols;
+        Frame() = default;
+        explicit Frame(std::pmr::memory_resource *arena) : symbols(arena)
+        {
+        }
+
+      public:
+        // the nodes come from the arena of the VM
+        std::pmr::unordered_map<std::string, CYX::Value> symbols;
         int pc{ -1 };
+        // a memoized call stores its result under `memo_key` on return
+        int memo_target{ -1 };
+        std::string memo_key;
     };
 } // namespace CVM
 
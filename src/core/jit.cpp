@@ -0,0 +1,317 @@
+#include "jit.h"
+
+#include "vm.hpp"
+
+#include <cstring>
+#include <initializer_list>
+#include <map>
+
+#ifdef CYX_JIT
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+namespace
+{
+    // x86-64 machine code under the System V calling convention
+    class CodeBuffer
+    {
+      public:
+        void bytes(std::initializer_list<uint8_t> list)
+        {
+            code.insert(code.end(), list);
+        }
+        void imm32(int32_t value)
+        {
+            append(&value, sizeof(value));
+        }
+        void imm64(uint64_t value)
+        {
+            append(&value, sizeof(value));
+        }
+        // `at` holds a rel32 which has to reach `target`
+        void patch(size_t at, size_t target)
+        {
+            const auto rel = static_cast<int32_t>(target - (at + 4));
+            std::memcpy(&code[at], &rel, sizeof(rel));
+        }
+        size_t size() const
+        {
+            return code.size();
+        }
+
+      private:
+        void append(const void *data, size_t len)
+        {
+            const auto *begin = static_cast<const uint8_t *>(data);
+            code.insert(code.end(), begin, begin + len);
+        }
+
+      public:
+        std::vector<uint8_t> code;
+    };
+} // namespace
+
+CVM::Jit::Jit(const Program &program) : program(program), func_of(program.vm_insts.size(), -1)
+{
+    const auto &insts = program.vm_insts;
+    for (int i = 0; i < insts.size(); i++)
+    {
+        if (insts[i]->opcode != Opcode::FUNC) continue;
+        if (!funcs.empty()) funcs.back().end = i;
+        funcs.emplace_back();
+        funcs.back().begin = i;
+        funcs.back().end   = insts.size();
+    }
+    for (int f = 0; f < funcs.size(); f++)
+    {
+        // the entry function stops at `entry_end`, the VM does that
+        if (funcs[f].begin == program.entry) funcs[f].end = std::min(funcs[f].end, program.entry_end);
+        bool loops = false;
+        for (int i = funcs[f].begin; i < funcs[f].end; i++)
+        {
+            func_of[i] = f;
+            if (insts[i]->opcode == Opcode::JMP) loops |= static_cast<Jmp *>(insts[i])->target <= i;
+            if (insts[i]->opcode == Opcode::JIF)
+                loops |= std::min(static_cast<Jif *>(insts[i])->target1, static_cast<Jif *>(insts[i])->target2) <= i;
+        }
+        // without a loop every call leaves the native code after a few instructions, which costs more than it saves
+        funcs[f].dropped = !loops;
+    }
+}
+
+CVM::Jit::~Jit()
+{
+    for (auto &func : funcs)
+    {
+        drop(func);
+    }
+}
+
+int CVM::Jit::run(VM &vm, int pc)
+{
+#ifdef CYX_JIT
+    if (pc >= func_of.size() || func_of[pc] < 0) return pc;
+    auto &func = funcs[func_of[pc]];
+    if (func.code == nullptr)
+    {
+        if (func.dropped || ++func.hits < JIT_THRESHOLD) return pc;
+        compile(func);
+    }
+    const auto *target = func.labels[pc - func.begin];
+    if (target == nullptr) return pc;
+    using Entry     = int (*)(VM *, const uint8_t *);
+    const int where = reinterpret_cast<Entry>(func.code)(&vm, target);
+    if (where >= 0) return where;
+    // a guard failed, the VM runs that instruction
+    if (++func.guard_failures >= GUARD_FAILURE_LIMIT) drop(func);
+    return -where - 1;
+#else
+    return pc;
+#endif
+}
+
+void CVM::Jit::compile(Function &func)
+{
+#ifdef CYX_JIT
+    const auto &insts = program.vm_insts;
+    CodeBuffer buf;
+    // int entry(VM *vm, const uint8_t *target), the VM stays in rbx. The push keeps the stack aligned for calls.
+    buf.bytes({ 0x53 });             // push rbx
+    buf.bytes({ 0x48, 0x89, 0xFB }); // mov rbx, rdi
+    buf.bytes({ 0xFF, 0xE6 });       // jmp rsi
+    // returns the pc the VM goes on with in eax
+    const size_t exit = buf.size();
+    buf.bytes({ 0x5B }); // pop rbx
+    buf.bytes({ 0xC3 }); // ret
+
+    auto exitTo = [&buf, exit](int pc)
+    {
+        buf.bytes({ 0xB8 }); // mov eax, pc
+        buf.imm32(pc);
+        buf.bytes({ 0xE9 }); // jmp exit
+        buf.imm32(0);
+        buf.patch(buf.size() - 4, exit);
+    };
+    auto callHandler = [&buf](const void *handler, VMInstruction *inst)
+    {
+        buf.bytes({ 0x48, 0x89, 0xDF }); // mov rdi, rbx
+        buf.bytes({ 0x48, 0xBE });       // mov rsi, inst
+        buf.imm64(reinterpret_cast<uint64_t>(inst));
+        buf.bytes({ 0x48, 0xB8 }); // mov rax, handler
+        buf.imm64(reinterpret_cast<uint64_t>(handler));
+        buf.bytes({ 0xFF, 0xD0 }); // call rax
+    };
+    // the VM runs the instruction when the handler returns false, the sign tells `run()` a guard failed
+    auto callGuarded = [&buf, &callHandler, &exitTo](const void *handler, VMInstruction *inst, int pc)
+    {
+        callHandler(handler, inst);
+        buf.bytes({ 0x84, 0xC0 }); // test al, al
+        buf.bytes({ 0x75, 0x0A }); // jnz over the exit
+        exitTo(-pc - 1);
+    };
+    // rel32 operands of jumps to instructions, patched once every instruction has its code
+    std::vector<std::pair<size_t, int>> jumps;
+    auto jumpTo = [&buf, &jumps](std::initializer_list<uint8_t> opcode, int target)
+    {
+        buf.bytes(opcode);
+        jumps.emplace_back(buf.size(), target);
+        buf.imm32(0);
+    };
+
+    std::vector<size_t> offsets(func.end - func.begin);
+    std::vector<bool> native(func.end - func.begin, true);
+    for (int pc = func.begin; pc < func.end; pc++)
+    {
+        auto *inst               = insts[pc];
+        offsets[pc - func.begin] = buf.size();
+        const void *handler      = nullptr;
+        switch (inst->opcode)
+        {
+            case Opcode::ADD: callGuarded(reinterpret_cast<const void *>(&binaryInt<Opcode::ADD>), inst, pc); break;
+            case Opcode::SUB: callGuarded(reinterpret_cast<const void *>(&binaryInt<Opcode::SUB>), inst, pc); break;
+            case Opcode::MUL: callGuarded(reinterpret_cast<const void *>(&binaryInt<Opcode::MUL>), inst, pc); break;
+            case Opcode::NE: callGuarded(reinterpret_cast<const void *>(&binaryInt<Opcode::NE>), inst, pc); break;
+            case Opcode::EQ: callGuarded(reinterpret_cast<const void *>(&binaryInt<Opcode::EQ>), inst, pc); break;
+            case Opcode::LT: callGuarded(reinterpret_cast<const void *>(&binaryInt<Opcode::LT>), inst, pc); break;
+            case Opcode::LE: callGuarded(reinterpret_cast<const void *>(&binaryInt<Opcode::LE>), inst, pc); break;
+            case Opcode::GT: callGuarded(reinterpret_cast<const void *>(&binaryInt<Opcode::GT>), inst, pc); break;
+            case Opcode::GE: callGuarded(reinterpret_cast<const void *>(&binaryInt<Opcode::GE>), inst, pc); break;
+            case Opcode::DIV:
+            case Opcode::MOD:
+            case Opcode::EXP:
+            case Opcode::BAND:
+            case Opcode::BOR:
+            case Opcode::BXOR:
+            case Opcode::SHL:
+            case Opcode::SHR:
+            case Opcode::LOR:
+            case Opcode::LAND: handler = reinterpret_cast<const void *>(&exec<&VM::binary>); break;
+            case Opcode::ADDI: handler = reinterpret_cast<const void *>(&exec<&VM::addI>); break;
+            case Opcode::BINXX:
+            case Opcode::BINXI: handler = reinterpret_cast<const void *>(&exec<&VM::binaryX>); break;
+            case Opcode::LNOT:
+            case Opcode::BNOT: handler = reinterpret_cast<const void *>(&exec<&VM::unary>); break;
+            case Opcode::LOADI:
+            case Opcode::LOADD:
+            case Opcode::LOADA:
+            case Opcode::LOADS: handler = reinterpret_cast<const void *>(&exec<&VM::load>); break;
+            case Opcode::LOADX: handler = reinterpret_cast<const void *>(&exec<&VM::loadX>); break;
+            case Opcode::LOADXA: handler = reinterpret_cast<const void *>(&exec<&VM::loadXA>); break;
+            case Opcode::LOADXU: handler = reinterpret_cast<const void *>(&exec<&VM::loadXU>); break;
+            case Opcode::STOREI:
+            case Opcode::STORED:
+            case Opcode::STORES:
+            case Opcode::STOREA:
+            case Opcode::STOREAU: handler = reinterpret_cast<const void *>(&exec<&VM::store>); break;
+            case Opcode::STOREX: handler = reinterpret_cast<const void *>(&exec<&VM::storeX>); break;
+            case Opcode::STOREXU: handler = reinterpret_cast<const void *>(&exec<&VM::storeXU>); break;
+            case Opcode::PARAM: handler = reinterpret_cast<const void *>(&exec<&VM::param>); break;
+            case Opcode::FUNC: break;
+            case Opcode::JMP: jumpTo({ 0xE9 }, static_cast<Jmp *>(inst)->target); break; // jmp rel32
+            case Opcode::JIF:
+                callHandler(reinterpret_cast<const void *>(&cond), inst);
+                buf.bytes({ 0x84, 0xC0 });                                   // test al, al
+                jumpTo({ 0x0F, 0x84 }, static_cast<Jif *>(inst)->target2); // jz rel32
+                jumpTo({ 0xE9 }, static_cast<Jif *>(inst)->target1);       // jmp rel32
+                break;
+            default:
+                // calls, returns and switch tables move frames or read the pc, the VM runs them
+                native[pc - func.begin] = false;
+                exitTo(pc);
+        }
+        if (handler != nullptr) callHandler(handler, inst);
+    }
+    // falls through into the next function, or reaches `entry_end`
+    exitTo(func.end);
+    // jumps out of the function leave the native code there
+    std::map<int, size_t> exits;
+    for (const auto &[at, target] : jumps)
+    {
+        if (target >= func.begin && target < func.end) continue;
+        if (exits.count(target) != 0) continue;
+        exits[target] = buf.size();
+        exitTo(target);
+    }
+    for (const auto &[at, target] : jumps)
+    {
+        buf.patch(at, target >= func.begin && target < func.end ? offsets[target - func.begin] : exits[target]);
+    }
+
+    // written first, executable after, never both
+    const size_t page = sysconf(_SC_PAGESIZE);
+    func.size         = (buf.size() + page - 1) / page * page;
+    void *code        = mmap(nullptr, func.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED)
+    {
+        func.dropped = true;
+        return;
+    }
+    std::memcpy(code, buf.code.data(), buf.size());
+    if (mprotect(code, func.size, PROT_READ | PROT_EXEC) != 0)
+    {
+        munmap(code, func.size);
+        func.dropped = true;
+        return;
+    }
+    func.code = static_cast<uint8_t *>(code);
+    func.labels.assign(func.end - func.begin, nullptr);
+    for (int i = 0; i < func.labels.size(); i++)
+    {
+        if (native[i]) func.labels[i] = func.code + offsets[i];
+    }
+#endif
+}
+
+void CVM::Jit::drop(Function &func)
+{
+#ifdef CYX_JIT
+    if (func.code != nullptr) munmap(func.code, func.size);
+#endif
+    func.code    = nullptr;
+    func.dropped = true;
+    func.labels.clear();
+}
+
+template<void (CVM::VM::*handler)()>
+void CVM::Jit::exec(VM *vm, VMInstruction *inst)
+{
+    vm->cur_inst = inst;
+    (vm->*handler)();
+}
+
+template<CVM::Opcode opcode>
+bool CVM::Jit::binaryInt(VM *vm, VMInstruction *inst)
+{
+    auto *binary = static_cast<Binary *>(inst);
+    auto *lhs    = vm->reg[binary->reg_idx1].valuePtr<long long>();
+    auto *rhs    = vm->reg[binary->reg_idx2].valuePtr<long long>();
+    if (lhs == nullptr || rhs == nullptr) return false;
+    // `Value` compares numbers as doubles
+    if constexpr (opcode == Opcode::ADD)
+        *lhs += *rhs;
+    else if constexpr (opcode == Opcode::SUB)
+        *lhs -= *rhs;
+    else if constexpr (opcode == Opcode::MUL)
+        *lhs *= *rhs;
+    else if constexpr (opcode == Opcode::NE)
+        vm->state = static_cast<double>(*lhs) != static_cast<double>(*rhs);
+    else if constexpr (opcode == Opcode::EQ)
+        vm->state = static_cast<double>(*lhs) == static_cast<double>(*rhs);
+    else if constexpr (opcode == Opcode::LT)
+        vm->state = static_cast<double>(*lhs) < static_cast<double>(*rhs);
+    else if constexpr (opcode == Opcode::LE)
+        vm->state = static_cast<double>(*lhs) <= static_cast<double>(*rhs);
+    else if constexpr (opcode == Opcode::GT)
+        vm->state = static_cast<double>(*lhs) > static_cast<double>(*rhs);
+    else if constexpr (opcode == Opcode::GE)
+        vm->state = static_cast<double>(*lhs) >= static_cast<double>(*rhs);
+    return true;
+}
+
+bool CVM::Jit::cond(VM *vm, VMInstruction *inst)
+{
+    const bool taken = static_cast<bool>(vm->state);
+    vm->state        = false;
+    return taken;
+}
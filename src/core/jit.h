@@ -0,0 +1,81 @@
+#ifndef CVM_JIT_H
+#define CVM_JIT_H
+
+#include "opcode.hpp"
+#include "program.hpp"
+#include "vm_instruction.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__linux__)
+    #define CYX_JIT 1
+#endif
+
+namespace CVM
+{
+    class VM;
+
+    // A baseline JIT for x86-64 Linux. Once control enters a function with a loop `JIT_THRESHOLD` times (calls,
+    // returns into it and its jumps), its instructions are compiled by copying a machine code template per opcode
+    // into an executable buffer: most templates call the VM's own handler for the instruction, jumps become native
+    // jumps and int arithmetic and comparisons get a fast path. What the templates don't cover (calls, returns,
+    // switch tables) leaves the native code and the VM runs it.
+    // The int fast paths are guarded, the VM runs the instruction once its operands are something else. A function
+    // whose guards fail `GUARD_FAILURE_LIMIT` times is dropped and stays with the VM.
+    class Jit
+    {
+      public:
+        explicit Jit(const Program &program);
+        Jit(const Jit &) = delete;
+        Jit &operator=(const Jit &) = delete;
+        ~Jit();
+
+        // false on other platforms, `VM::setJit()` does nothing there
+        static constexpr bool supported()
+        {
+#ifdef CYX_JIT
+            return true;
+#else
+            return false;
+#endif
+        }
+        // runs the native code of `pc` if there is some, compiling a function which just got hot, and returns
+        // where the VM goes on
+        int run(VM &vm, int pc);
+
+      private:
+        struct Function
+        {
+            int begin{ 0 }; // FUNC
+            int end{ 0 };   // the next FUNC, or `entry_end` for the entry function
+            int hits{ 0 };
+            int guard_failures{ 0 };
+            bool dropped{ false };
+            uint8_t *code{ nullptr };
+            size_t size{ 0 };
+            // native code of every instruction, nullptr for the ones the VM has to run
+            std::vector<const uint8_t *> labels;
+        };
+
+        void compile(Function &func);
+        void drop(Function &func);
+        // called by the templates with `vm` in rdi and the instruction in rsi
+        template<void (VM::*handler)()>
+        static void exec(VM *vm, VMInstruction *inst);
+        // false if an operand isn't an int
+        template<Opcode opcode>
+        static bool binaryInt(VM *vm, VMInstruction *inst);
+        // takes `state` for a JIF
+        static bool cond(VM *vm, VMInstruction *inst);
+
+      private:
+        static constexpr int JIT_THRESHOLD       = 1000;
+        static constexpr int GUARD_FAILURE_LIMIT = 100;
+        const Program &program;
+        std::vector<Function> funcs;
+        std::vector<int> func_of; // instruction -> index in `funcs`, -1 for the global initialization
+    };
+} // namespace CVM
+
+#endif // CVM_JIT_H
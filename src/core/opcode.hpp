@@ -49,6 +49,17 @@ namespace CVM
         RET,
         JMP, // unconditional jump
         JIF, // conditional jump, depend on `state`
+        // proven loops, see `CFG::inductionVariables()`
+        ADDI,    // integer increment
+        LOADXU,  // LOADX without bounds check
+        STOREXU, // STOREX without bounds check
+        STOREAU, // STOREA without bounds check
+        // superinstructions, see `PeepholeOptimization::fuseSuperinstructions()`
+        BINXX, // LOADX; LOADX; binary; [STOREX]
+        BINXI, // LOADX; LOADI; binary; [STOREX]
+        // switch dispatch, see `BytecodeGenerator::genSwitch()`
+        JTABLE,  // jump through a table indexed by an int
+        JLOOKUP, // jump to the target of a key, binary search for ints and hash for strings
         //
 
         UNKNOWN = 0xff,
@@ -64,6 +75,73 @@ namespace CVM
         return static_cast<Opcode>(x);
     }
 
+    // the bounds checked instruction of an unchecked one
+    static inline constexpr Opcode checkedOpcode(Opcode opcode)
+    {
+        switch (opcode)
+        {
+            case Opcode::LOADXU: return Opcode::LOADX;
+            case Opcode::STOREXU: return Opcode::STOREX;
+            case Opcode::STOREAU: return Opcode::STOREA;
+            default: return opcode;
+        }
+    }
+
+    static inline constexpr const char *opcode2Str(Opcode opcode)
+    {
+        switch (opcode)
+        {
+            case Opcode::ADD: return "ADD";
+            case Opcode::SUB: return "SUB";
+            case Opcode::MUL: return "MUL";
+            case Opcode::DIV: return "DIV";
+            case Opcode::MOD: return "MOD";
+            case Opcode::EXP: return "EXP";
+            case Opcode::BAND: return "BAND";
+            case Opcode::BOR: return "BOR";
+            case Opcode::BXOR: return "BXOR";
+            case Opcode::SHL: return "SHL";
+            case Opcode::SHR: return "SHR";
+            case Opcode::LOR: return "LOR";
+            case Opcode::NE: return "NE";
+            case Opcode::EQ: return "EQ";
+            case Opcode::LT: return "LT";
+            case Opcode::LE: return "LE";
+            case Opcode::GT: return "GT";
+            case Opcode::GE: return "GE";
+            case Opcode::LAND: return "LAND";
+            case Opcode::LNOT: return "LNOT";
+            case Opcode::BNOT: return "BNOT";
+            case Opcode::LOADI: return "LOADI";
+            case Opcode::LOADD: return "LOADD";
+            case Opcode::LOADS: return "LOADS";
+            case Opcode::LOADA: return "LOADA";
+            case Opcode::LOADX: return "LOADX";
+            case Opcode::LOADXA: return "LOADXA";
+            case Opcode::STOREI: return "STOREI";
+            case Opcode::STORED: return "STORED";
+            case Opcode::STORES: return "STORES";
+            case Opcode::STOREA: return "STOREA";
+            case Opcode::STOREX: return "STOREX";
+            case Opcode::CALL: return "CALL";
+            case Opcode::FUNC: return "FUNC";
+            case Opcode::ARG: return "ARG";
+            case Opcode::PARAM: return "PARAM";
+            case Opcode::RET: return "RET";
+            case Opcode::JMP: return "JMP";
+            case Opcode::JIF: return "JIF";
+            case Opcode::ADDI: return "ADDI";
+            case Opcode::LOADXU: return "LOADXU";
+            case Opcode::STOREXU: return "STOREXU";
+            case Opcode::STOREAU: return "STOREAU";
+            case Opcode::BINXX: return "BINXX";
+            case Opcode::BINXI: return "BINXI";
+            case Opcode::JTABLE: return "JTABLE";
+            case Opcode::JLOOKUP: return "JLOOKUP";
+            default: return "UNKNOWN";
+        }
+    }
+
 } // namespace CVM
 
 #endif
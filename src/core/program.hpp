@@ -0,0 +1,63 @@
+#ifndef CVM_PROGRAM_HPP
+#define CVM_PROGRAM_HPP
+
+#include "vm_instruction.hpp"
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace CVM
+{
+    // Verified bytecode, made by `COMPILER::Compiler` or read by `BytecodeReader`, run by `VM::load()`.
+    // The program owns its instructions and a VM only refers to them, so it has to outlive the VMs it is
+    // loaded into. The VM never changes an instruction, one program can be loaded into many VMs at once.
+    class Program
+    {
+      public:
+        Program() = default;
+        Program(const Program &) = delete;
+        Program &operator=(const Program &) = delete;
+        Program(Program &&other) noexcept
+        {
+            *this = std::move(other);
+        }
+        Program &operator=(Program &&other) noexcept
+        {
+            std::swap(vm_insts, other.vm_insts);
+            std::swap(entry, other.entry);
+            std::swap(entry_end, other.entry_end);
+            std::swap(global_var_len, other.global_var_len);
+            std::swap(funcs, other.funcs);
+            return *this;
+        }
+        ~Program()
+        {
+            for (auto *inst : vm_insts)
+            {
+                delete inst;
+            }
+        }
+
+        // fills `funcs`, once `vm_insts` is complete
+        void indexFuncs()
+        {
+            funcs.clear();
+            for (int i = 0; i < vm_insts.size(); i++)
+            {
+                if (vm_insts[i]->opcode == Opcode::FUNC) funcs[static_cast<Func *>(vm_insts[i])->name] = i;
+            }
+        }
+
+      public:
+        std::vector<VMInstruction *> vm_insts;
+        int entry{ 0 };          // main function position
+        int entry_end{ 0 };      // main function end
+        int global_var_len{ 0 }; // global data initialize instruction length
+        // function name -> position of its FUNC
+        std::unordered_map<std::string, int> funcs;
+    };
+} // namespace CVM
+
+#endif // CVM_PROGRAM_HPP
@@ -1,9 +1,134 @@
 #include "vm.hpp"
 
+void CVM::VM::load(const Program &program)
+{
+    this->program       = &program;
+    vm_insts            = program.vm_insts.data();
+    entry               = program.entry;
+    entry_end           = program.entry_end;
+    global_var_init_len = program.global_var_len;
+    jit.reset(jit_enabled ? new Jit(program) : nullptr);
+    reset();
+}
+
+void CVM::VM::reset()
+{
+    reg.fill(CYX::Value());
+    frame.assign(1, Frame(arena));
+    memo_cache.clear();
+    inputs.clear();
+    mode      = Mode::INIT;
+    pc        = 0;
+    ngram_len = 0;
+}
+
+void CVM::VM::setArena(std::pmr::memory_resource *resource)
+{
+    arena = resource;
+}
+
+void CVM::VM::setJit(bool b)
+{
+    jit_enabled = b && Jit::supported();
+    jit.reset(jit_enabled && program != nullptr ? new Jit(*program) : nullptr);
+}
+
+void CVM::VM::setParallelJobs(int jobs)
+{
+    parallel_jobs = std::max(1, jobs);
+}
+
+void CVM::VM::setAwaitInput(bool b)
+{
+    await_input = b;
+}
+
+void CVM::VM::feed(std::string input)
+{
+    inputs.push_back(std::move(input));
+}
+
 void CVM::VM::run()
 {
+    startAt(entry, {});
+    finish();
+}
+
+CYX::Value CVM::VM::call(const std::string &name, const std::vector<CYX::Value> &args)
+{
+    start(name, args);
+    finish();
+    return reg[1];
+}
+
+void CVM::VM::start(const std::string &name, const std::vector<CYX::Value> &args)
+{
+    // functions are named `name#param count`, except the entry function
+    const auto &funcs = program->funcs;
+    auto it           = funcs.find(name + "#" + std::to_string(args.size()));
+    if (it == funcs.end()) it = funcs.find(name);
+    if (it == funcs.end() || static_cast<Func *>(vm_insts[it->second])->param_count != args.size())
+        THROW("no function `" + name + "` takes " + std::to_string(args.size()) + " arguments");
+    startAt(it->second, args);
+}
+
+void CVM::VM::startAt(int func, const std::vector<CYX::Value> &args)
+{
+    // frame[0] holds the globals, any other frame belongs to a suspended call
+    if (frame.size() > 1) THROW("can't start a call while another one is suspended");
+    // optimizations may drop parameters, `func` is whatever FUNC the name was looked up to
+    if (vm_insts[func]->opcode != Opcode::FUNC || static_cast<Func *>(vm_insts[func])->param_count != args.size())
+        THROW("the function at " + std::to_string(func) + " doesn't take " + std::to_string(args.size()) +
+              " arguments");
+    if (mode == Mode::INIT) initGlobals();
+    // the PARAMs right after FUNC take `args` instead of the ARGs of a CALL
+    frame.emplace_back(arena);
+    pc = func + 1;
+    for (const auto &arg : args)
+    {
+        frame.back().symbols[static_cast<Param *>(vm_insts[pc++])->name] = arg;
+    }
+    // returning to frame[0] stops at `entry_end`, the same as the entry function does
+    reg[1] = CYX::Value();
+}
+
+CVM::VM::Status CVM::VM::runFor(long long budget)
+{
+    if (frame.size() == 1) startAt(entry, {});
+    return execute(budget);
+}
+
+CYX::Value CVM::VM::result() const
+{
+    return reg[1];
+}
+
+void CVM::VM::initGlobals()
+{
+    // frame[0] is global var decl table
+    pc = 0;
+    finish();
+    mode = Mode::MAIN;
+}
+
+void CVM::VM::finish()
+{
+    // nobody takes the yielded values here, nor can anyone feed the input while it's running
+    Status status = Status::YIELDED;
+    while (status == Status::YIELDED)
+    {
+        status = execute(std::numeric_limits<long long>::max());
+    }
+    if (status == Status::WAITING) THROW("`read()` waits for input, `feed()` it first or use `runFor()`");
+}
+
+CVM::VM::Status CVM::VM::execute(long long budget)
+{
+    long long steps = 0;
     while (fetch())
     {
+        if (profile) profileOpcode(cur_inst->opcode);
+        const int from = pc;
         switch (cur_inst->opcode)
         {
             case Opcode::ADD:
@@ -25,6 +150,9 @@ void CVM::VM::run()
             case Opcode::GT:
             case Opcode::GE:
             case Opcode::LAND: binary(); break;
+            case Opcode::ADDI: addI(); break;
+            case Opcode::BINXX:
+            case Opcode::BINXI: binaryX(); break;
             case Opcode::LNOT:
             case Opcode::BNOT: unary(); break;
             case Opcode::LOADI:
@@ -33,60 +161,118 @@ void CVM::VM::run()
             case Opcode::LOADS: load(); break;
             case Opcode::LOADX: loadX(); break;
             case Opcode::LOADXA: loadXA(); break;
+            case Opcode::LOADXU: loadXU(); break;
             case Opcode::STOREI:
             case Opcode::STORED:
             case Opcode::STORES:
-            case Opcode::STOREA: store(); break;
+            case Opcode::STOREA:
+            case Opcode::STOREAU: store(); break;
             case Opcode::STOREX: storeX(); break;
-            case Opcode::CALL: call(); break;
+            case Opcode::STOREXU: storeXU(); break;
+            case Opcode::CALL:
+                call();
+                // a buildin suspended the VM, it goes on after `yield` but runs `read()` again
+                if (suspend != Status::FINISHED)
+                {
+                    if (suspend == Status::YIELDED) pc++;
+                    return std::exchange(suspend, Status::FINISHED);
+                }
+                break;
             case Opcode::FUNC: break;
             case Opcode::ARG: arg(); break;
             case Opcode::PARAM: param(); break;
             case Opcode::RET: ret(); break;
             case Opcode::JMP: jmp(); break;
             case Opcode::JIF: jif(); break;
+            case Opcode::JTABLE: jtable(); break;
+            case Opcode::JLOOKUP: jlookup(); break;
             default: UNREACHABLE();
         }
         pc++;
+        // only a backward jump or a call may stop, any other instruction runs at most once in between
+        if (++steps >= budget && (cur_inst->opcode == Opcode::CALL || (pc <= from && isJump(cur_inst->opcode))))
+            return Status::PREEMPTED;
+        // native code is entered where control lands
+        if (jit != nullptr && budget == std::numeric_limits<long long>::max() && mode == Mode::MAIN && !profile &&
+            (isJump(cur_inst->opcode) || inOr(cur_inst->opcode, Opcode::CALL, Opcode::RET)))
+            pc = jit->run(*this, pc);
     }
+    // the entry function stops at `entry_end` without running its RET
+    frame.erase(frame.begin() + 1, frame.end());
+    return Status::FINISHED;
 }
 
-void CVM::VM::setInsts(const std::vector<VMInstruction *> &insts)
+bool CVM::VM::isJump(CVM::Opcode opcode)
 {
-    vm_insts = insts;
+    return inOr(opcode, Opcode::JMP, Opcode::JIF, Opcode::JTABLE, Opcode::JLOOKUP);
 }
 
-void CVM::VM::setEntry(int i)
+void CVM::VM::setProfile(bool b)
 {
-    entry = i;
+    profile = b;
 }
 
-void CVM::VM::setEntryEnd(int i)
+void CVM::VM::profileOpcode(CVM::Opcode opcode)
 {
-    entry_end = i;
+    if (ngram_len == NGRAM_MAX)
+    {
+        std::move(ngram_window.begin() + 1, ngram_window.end(), ngram_window.begin());
+        ngram_len--;
+    }
+    ngram_window[ngram_len++] = opcode;
+    for (int n = 2; n <= ngram_len; n++)
+    {
+        unsigned long long key = n;
+        for (int i = ngram_len - n; i < ngram_len; i++)
+        {
+            key = (key << 8) | opcode2UChar(ngram_window[i]);
+        }
+        ngram_count[key]++;
+    }
+    if (inOr(opcode, Opcode::JMP, Opcode::JIF, Opcode::JTABLE, Opcode::JLOOKUP, Opcode::CALL, Opcode::RET))
+        ngram_len = 0;
 }
 
-void CVM::VM::setGlobalInitLen(int i)
+std::string CVM::VM::profileStr()
 {
-    global_var_init_len = i;
+    // a superinstruction for an n-gram saves n - 1 dispatches each time the sequence runs
+    auto saved = [](const std::pair<unsigned long long, long long> &ngram) {
+        auto key = ngram.first;
+        int n    = 0;
+        while (key > 0xff)
+        {
+            key >>= 8;
+            n++;
+        }
+        return (n - 1) * ngram.second;
+    };
+    std::vector<std::pair<unsigned long long, long long>> ngrams(ngram_count.begin(), ngram_count.end());
+    std::sort(ngrams.begin(), ngrams.end(),
+              [&saved](const auto &lhs, const auto &rhs) { return saved(lhs) > saved(rhs); });
+    if (ngrams.size() > PROFILE_TOP) ngrams.resize(PROFILE_TOP);
+
+    std::string str = "opcode n-grams, by dispatches a superinstruction would save:\n";
+    for (const auto &ngram : ngrams)
+    {
+        std::string seq;
+        for (auto key = ngram.first; key > 0xff; key >>= 8)
+        {
+            seq = std::string(opcode2Str(uchar2Opcode(key & 0xff))) + (seq.empty() ? "" : " ") + seq;
+        }
+        auto count = std::to_string(ngram.second);
+        addSpace(str, 12 - count.size());
+        str += count + "  " + seq + "\n";
+    }
+    return str;
 }
 
 bool CVM::VM::fetch()
 {
-    if (pc == global_var_init_len && mode == Mode::INIT)
-    {
-        pc   = entry;
-        mode = Mode::MAIN;
-        // frame[0] is global var decl table
-        frame.emplace_back();
-    }
-    if (pc == entry_end) return false;
-    if (pc < vm_insts.size())
-    {
-        cur_inst = vm_insts[pc];
-        return true;
-    }
-    return false;
+    // the global initialization ends right before the first function
+    if (pc == entry_end || (pc == global_var_init_len && mode == Mode::INIT)) return false;
+    // verified code never runs past its end, every jump and call target is in range
+    cur_inst = vm_insts[pc];
+    return true;
 }
 
 void CVM::VM::unary()
@@ -101,10 +287,13 @@ void CVM::VM::unary()
 
 void CVM::VM::binary()
 {
-    auto *inst   = static_cast<Binary *>(cur_inst);
-    int reg_idx1 = inst->reg_idx1;
-    int reg_idx2 = inst->reg_idx2;
-    switch (cur_inst->opcode)
+    auto *inst = static_cast<Binary *>(cur_inst);
+    binaryOp(inst->opcode, inst->reg_idx1, inst->reg_idx2);
+}
+
+void CVM::VM::binaryOp(CVM::Opcode opcode, int reg_idx1, int reg_idx2)
+{
+    switch (opcode)
     {
         case Opcode::ADD: reg[reg_idx1] = reg[reg_idx1] + reg[reg_idx2]; break;
         case Opcode::SUB: reg[reg_idx1] = reg[reg_idx1] - reg[reg_idx2]; break;
@@ -129,6 +318,30 @@ void CVM::VM::binary()
     }
 }
 
+void CVM::VM::binaryX()
+{
+    auto *inst          = static_cast<BinaryX *>(cur_inst);
+    reg[inst->reg_idx1] = *findSymbol(inst->lhs);
+    if (inst->opcode == Opcode::BINXX)
+        reg[inst->reg_idx2] = *findSymbol(inst->rhs);
+    else
+        reg[inst->reg_idx2] = inst->val;
+    binaryOp(inst->op, inst->reg_idx1, inst->reg_idx2);
+    if (!inst->dest.empty()) *findSymbol(inst->dest) = reg[inst->resultReg()];
+}
+
+void CVM::VM::addI()
+{
+    auto *inst = static_cast<AddI *>(cur_inst);
+    if (auto *val = reg[inst->reg_idx].valuePtr<long long>(); val != nullptr)
+        *val += inst->val;
+    else
+    {
+        CYX::Value rhs(inst->val);
+        reg[inst->reg_idx] = reg[inst->reg_idx] + rhs;
+    }
+}
+
 void CVM::VM::loadXA()
 {
     auto *inst                      = static_cast<LoadXA *>(cur_inst);
@@ -153,6 +366,12 @@ void CVM::VM::loadX()
     reg[inst->reg_idx] = *target;
 }
 
+void CVM::VM::loadXU()
+{
+    auto *inst         = static_cast<LoadXU *>(cur_inst);
+    reg[inst->reg_idx] = *findElementUnchecked(inst->name, inst->index);
+}
+
 void CVM::VM::load()
 {
     auto op = cur_inst->opcode;
@@ -198,6 +417,12 @@ void CVM::VM::storeX()
     *target = reg[inst->reg_idx];
 }
 
+void CVM::VM::storeXU()
+{
+    auto *inst                                     = static_cast<StoreXU *>(cur_inst);
+    *findElementUnchecked(inst->name, inst->index) = reg[inst->reg_idx];
+}
+
 void CVM::VM::store()
 {
     auto op = cur_inst->opcode;
@@ -232,6 +457,11 @@ void CVM::VM::store()
         }
         *target = inst->value;
     }
+    else if (op == Opcode::STOREAU)
+    {
+        auto *inst                                     = static_cast<StoreAU *>(cur_inst);
+        *findElementUnchecked(inst->name, inst->index) = inst->value;
+    }
     else
         UNREACHABLE();
 }
@@ -249,52 +479,170 @@ void CVM::VM::call()
         callBuildin();
         return;
     }
+    auto *func = static_cast<Func *>(vm_insts[inst->target]);
+    std::string key;
+    if (func->memoize && !memoKey(func->param_count, key)) key.clear();
+    if (!key.empty())
+    {
+        auto &cache = memo_cache[inst->target];
+        if (auto it = cache.find(key); it != cache.end())
+        {
+            reg[1] = it->second;
+            // skip the ARGs
+            pc += func->param_count;
+            return;
+        }
+    }
     frame.back().pc = pc;
-    frame.emplace_back(Frame());
+    frame.emplace_back(arena);
+    if (!key.empty())
+    {
+        frame.back().memo_target = inst->target;
+        frame.back().memo_key    = std::move(key);
+    }
     pc = inst->target - 1;
 }
 
+bool CVM::VM::memoKey(int param_count, std::string &key)
+{
+    for (int i = 1; i <= param_count; i++)
+    {
+        auto *arg = static_cast<Arg *>(vm_insts[pc + i]);
+        if (arg->type == ArgType::RAW)
+        {
+            if (!arg->value.appendKey(key)) return false;
+            continue;
+        }
+        // same lookup as `param()`
+        auto it = frame.back().symbols.find(arg->name);
+        if (!arg->index.empty() || it == frame.back().symbols.end() || !it->second.appendKey(key)) return false;
+    }
+    return true;
+}
+
 void CVM::VM::callBuildin()
 {
     auto *call         = static_cast<Call *>(cur_inst);
     auto *buildin_func = buildin_functions_index.at(-call->target);
-    CYX::Value *retval = nullptr;
-    // TODO: some bugs here...
-    if (vm_insts[pc + 1]->opcode == Opcode::ARG)
+    if (-call->target == BUILDIN_READ && await_input)
     {
-        pc++;
-        auto *arg = static_cast<Arg *>(vm_insts[pc]);
-        if (arg->type == ArgType::MAP)
+        // stays at the CALL until the host feeds something
+        if (inputs.empty())
         {
-            auto target = findSymbol(arg->name);
-            if (!arg->index.empty())
-            {
-                // MAGIC, DO NOT TOUCH...
-                for (auto idx : arg->index)
-                {
-                    if (std::holds_alternative<long long>(idx))
-                        target = &target->asArray()->at(std::get<long long>(idx));
-                    else
-                    {
-                        const auto i = findSymbol(std::get<std::string>(idx))->as<long long>();
-                        target       = &target->asArray()->at(i);
-                    }
-                }
-            }
-            retval = buildin_func(target);
+            suspend = Status::WAITING;
+            return;
         }
-        else if (arg->type == ArgType::RAW)
+        reg[1] = CYX::Value(std::move(inputs.front()));
+        inputs.pop_front();
+        return;
+    }
+    if (-call->target == BUILDIN_PARALLEL_MAP)
+    {
+        CYX::Value *args[2]{};
+        for (int i = 0; i < 2; i++)
         {
-            retval = buildin_func(&arg->value);
+            if (vm_insts[pc + 1]->opcode == Opcode::ARG)
+                args[i] = argTarget(static_cast<Arg *>(vm_insts[++pc]), raw_args[i]);
         }
+        parallelMap(args[0], args[1]);
+        return;
     }
-    else
+    CYX::Value *target = nullptr;
+    // TODO: some bugs here...
+    if (vm_insts[pc + 1]->opcode == Opcode::ARG) target = argTarget(static_cast<Arg *>(vm_insts[++pc]), raw_args[0]);
+    if (-call->target == BUILDIN_YIELD)
     {
-        retval = buildin_func(nullptr);
+        // the host reads the value by `result()`
+        reg[1]  = target != nullptr ? *target : CYX::Value();
+        suspend = Status::YIELDED;
+        return;
     }
+    auto *retval = buildin_func(target);
     if (retval != nullptr) reg[1] = *retval;
 }
 
+CYX::Value *CVM::VM::argTarget(Arg *arg, CYX::Value &scratch)
+{
+    // `int()` and friends convert their argument in place, the instruction itself belongs to a shared program
+    if (arg->type == ArgType::RAW)
+    {
+        scratch = arg->value;
+        return &scratch;
+    }
+    auto *target = findSymbol(arg->name);
+    // MAGIC, DO NOT TOUCH...
+    for (auto idx : arg->index)
+    {
+        if (std::holds_alternative<long long>(idx))
+            target = &target->asArray()->at(std::get<long long>(idx));
+        else
+        {
+            const auto i = findSymbol(std::get<std::string>(idx))->as<long long>();
+            target       = &target->asArray()->at(i);
+        }
+    }
+    return target;
+}
+
+void CVM::VM::parallelMap(CYX::Value *func_name, CYX::Value *arr)
+{
+    if (func_name == nullptr || !func_name->is<std::string>() || arr == nullptr || !arr->isArray())
+        CERR("`parallel_map()` takes a function name and an array");
+    const auto name = func_name->as<std::string>();
+    auto it         = program->funcs.find(name + "#1");
+    if (it == program->funcs.end() || static_cast<Func *>(vm_insts[it->second])->param_count != 1)
+        CERR("no function `" + name + "` takes 1 argument");
+    const int func    = it->second;
+    const bool writes = static_cast<Func *>(vm_insts[func])->writes_globals;
+    if (parallel_pool == nullptr)
+    {
+        parallel_pool = std::make_unique<ThreadPool>(parallel_jobs);
+        for (int i = 0; i < parallel_pool->size(); i++)
+        {
+            children.push_back(std::make_unique<VM>());
+            children.back()->setParallelJobs(1);
+        }
+    }
+    for (auto &child : children)
+    {
+        child->fork(*this);
+        if (!writes) child->frame[0].symbols = frame[0].symbols;
+    }
+    const auto &elements = *arr->asArray();
+    const int n          = elements.size();
+    std::vector<CYX::Value> results(n);
+    // a few chunks per thread, so a thread which is done early can steal some
+    const int chunk = std::max(1, n / (parallel_pool->size() * 8));
+    parallel_pool->parallelFor((n + chunk - 1) / chunk,
+                               [this, func, writes, chunk, n, &elements, &results](int task, int worker)
+                               {
+                                   auto &child = *children[worker];
+                                   for (int i = task * chunk; i < std::min(n, (task + 1) * chunk); i++)
+                                   {
+                                       // every element starts from the globals as they are now, whatever a call
+                                       // changes is thrown away. a function which doesn't change them keeps
+                                       // the copy its worker got
+                                       if (writes) child.frame[0].symbols = frame[0].symbols;
+                                       child.startAt(func, { elements[i] });
+                                       child.finish();
+                                       results[i] = child.reg[1];
+                                   }
+                               });
+    reg[1] = CYX::Value(std::move(results));
+}
+
+void CVM::VM::fork(const VM &parent)
+{
+    program             = parent.program;
+    vm_insts            = parent.vm_insts;
+    entry               = parent.entry;
+    entry_end           = parent.entry_end;
+    global_var_init_len = parent.global_var_init_len;
+    reset();
+    // `parallelMap()` gives it the globals
+    mode = Mode::MAIN;
+}
+
 void CVM::VM::func()
 {
     // pass
@@ -322,8 +670,18 @@ void CVM::VM::param()
 
 void CVM::VM::ret()
 {
+    if (auto &cur = frame.back(); cur.memo_target != -1)
+    {
+        // a full cache starts over, recursion mostly asks for recent arguments again
+        auto &cache = memo_cache[cur.memo_target];
+        if (cache.size() >= MEMO_CACHE_SIZE) cache.clear();
+        cache[std::move(cur.memo_key)] = reg[1];
+    }
     frame.pop_back();
-    if (frame.size() > 1) pc = frame.back().pc;
+    if (frame.size() > 1)
+        pc = frame.back().pc;
+    else // return from entry, stop here instead of running into the next function
+        pc = entry_end - 1;
 }
 
 void CVM::VM::jmp()
@@ -342,9 +700,72 @@ void CVM::VM::jif()
     state = false;
 }
 
+void CVM::VM::jtable()
+{
+    auto *inst  = static_cast<JTable *>(cur_inst);
+    auto &value = reg[inst->reg_idx];
+    int target  = inst->default_target;
+    long long key;
+    if (switchKey(value, key))
+    {
+        // a value below `base` wraps around to a large offset
+        auto offset = static_cast<unsigned long long>(key) - inst->base;
+        if (offset < inst->targets.size()) target = inst->targets[offset];
+    }
+    pc = target - 1;
+}
+
+void CVM::VM::jlookup()
+{
+    auto *inst  = static_cast<JLookup *>(cur_inst);
+    auto &value = reg[inst->reg_idx];
+    int target  = inst->default_target;
+    long long key;
+    if (switchKey(value, key))
+    {
+        auto it = std::lower_bound(inst->int_keys.begin(), inst->int_keys.end(), key);
+        if (it != inst->int_keys.end() && *it == key) target = inst->targets[it - inst->int_keys.begin()];
+    }
+    else if (value.is<std::string>())
+    {
+        auto it = inst->str_index.find(value.value<std::string>());
+        if (it != inst->str_index.end()) target = inst->targets[it->second];
+    }
+    pc = target - 1;
+}
+
+bool CVM::VM::switchKey(CYX::Value &value, long long &key)
+{
+    if (value.is<long long>())
+    {
+        key = value.value<long long>();
+        return true;
+    }
+    // the `==` of a switch compares an int and a double as doubles, 2.0 takes the case (2)
+    if (!value.is<double>()) return false;
+    const double d       = value.value<double>();
+    constexpr double min = static_cast<double>(std::numeric_limits<long long>::min());
+    if (!(d >= min && d < -min) || d != std::trunc(d)) return false;
+    key = static_cast<long long>(d);
+    return true;
+}
+
 CYX::Value *CVM::VM::findSymbol(const std::string &name)
 {
     if (frame.back().symbols.find(name) != frame.back().symbols.end()) return &frame.back().symbols[name];
     if (frame[0].symbols.find(name) == frame[0].symbols.end()) return &frame.back().symbols[name];
     return &frame[0].symbols[name];
 }
+
+CYX::Value *CVM::VM::findElementUnchecked(const std::string &name, const std::vector<ArrIdx> &index)
+{
+    auto target = findSymbol(name);
+    for (const auto &idx : index)
+    {
+        if (std::holds_alternative<long long>(idx))
+            target = &(*target->asArray())[std::get<long long>(idx)];
+        else
+            target = &(*target->asArray())[findSymbol(std::get<std::string>(idx))->as<long long>()];
+    }
+    return target;
+}
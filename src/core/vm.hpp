@@ -3,46 +3,117 @@
 
 #include "../common/buildin.hpp"
 #include "../common/value.hpp"
+#include "../utility/thread_pool.hpp"
+#include "../utility/utility.hpp"
 #include "frame.hpp"
+#include "jit.h"
 #include "opcode.hpp"
+#include "program.hpp"
 #include "vm_instruction.hpp"
 
+#include <algorithm>
 #include <array>
 #include <cmath>
+#include <deque>
 #include <dbg.h>
+#include <limits>
 #include <memory>
+#include <memory_resource>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace CVM
 {
     class VM
     {
+        // the native code calls the handlers of instructions
+        friend class Jit;
+
+      public:
+        enum class Status
+        {
+            FINISHED,
+            PREEMPTED, // the budget is used up
+            YIELDED,   // a `yield` ran, its value is in `result()`
+            WAITING    // `read()` waits for `feed()`
+        };
+
       public:
+        // resets the VM and refers to `program`, nothing is copied. the globals are initialized on the first
+        // `run()` or `call()`. `program` has to be verified, as `Compiler::compile()` and `BytecodeReader` do,
+        // the VM doesn't check its bounds
+        void load(const Program &program);
+        // forgets the globals, frames and memoized results, the program stays loaded
+        void reset();
+        // runs the entry function, yielded values are dropped
         void run();
+        // runs `name` with `args` and returns its return value, the globals keep their values between calls.
+        // `run()`, `call()` and `start()` throw `CYX::Error` if there is no such function or a call is suspended,
+        // `run()` and `call()` if `read()` waits for input. Errors of the script itself still end the process.
+        CYX::Value call(const std::string &name, const std::vector<CYX::Value> &args = {});
+        // `read()` takes the lines given by `feed()` instead of reading stdin, and `runFor()` returns `WAITING`
+        // when there is none left, so a host can run many scripts on one thread while they wait for input
+        void setAwaitInput(bool b);
+        void feed(std::string input);
+        // prepares a call of `name` for `runFor()`, without running it
+        void start(const std::string &name, const std::vector<CYX::Value> &args = {});
+        // runs the started call, or the entry function if there is none, until it returns, `yield`s, waits for input
+        // or uses up `budget` instructions. It only stops for the budget at a backward jump or a call, so a few more
+        // may run. Unless it's `FINISHED` the next `runFor()` goes on where it stopped, `run()`, `call()` and
+        // `start()` have to wait until it is finished.
+        Status runFor(long long budget);
+        // the return value of the call `runFor()` finished, or the value it yielded
+        CYX::Value result() const;
 
       private:
+        void initGlobals();
+        // `func` is the position of a FUNC
+        void startAt(int func, const std::vector<CYX::Value> &args);
+        // runs until it is finished, skipping over `yield`s
+        void finish();
+        Status execute(long long budget);
+        static bool isJump(Opcode opcode);
         bool fetch();
         void unary();
         void binary();
+        void binaryOp(Opcode opcode, int reg_idx1, int reg_idx2);
+        void binaryX();
+        void addI();
         //
         void loadX();
+        void loadXU();
         void loadXA();
         void load();
         //
         void storeX();
+        void storeXU();
         void store();
         //
         void arg();
         void call();
         void callBuildin();
+        // the value an ARG passes, a RAW one is copied into `scratch`
+        CYX::Value *argTarget(Arg *arg, CYX::Value &scratch);
+        void parallelMap(CYX::Value *func_name, CYX::Value *arr);
+        // takes the program of `parent` and starts over, for `parallel_map()`
+        void fork(const VM &parent);
         void func();
         void param();
         void ret();
         void jmp();
         void jif();
+        void jtable();
+        void jlookup();
         //
+        bool memoKey(int param_count, std::string &key);
+        // the key of a JTABLE / JLOOKUP int case, false if `value` doesn't equal one
+        static bool switchKey(CYX::Value &value, long long &key);
+        void profileOpcode(Opcode opcode);
         CYX::Value *findSymbol(const std::string &name);
+        CYX::Value *findElementUnchecked(const std::string &name, const std::vector<ArrIdx> &index);
 
       private:
         enum class Mode
@@ -50,11 +121,16 @@ namespace CVM
             INIT,
             MAIN
         };
-        std::array<CYX::Value, 12> reg;
-        std::vector<CVM::Frame> frame{ Frame() };
+        std::array<CYX::Value, REGISTER_COUNT> reg;
+        // copies of the RAW args of a buildin call
+        std::array<CYX::Value, 2> raw_args;
+        std::pmr::memory_resource *arena{ std::pmr::get_default_resource() }; // the symbol tables of frames
+        std::vector<CVM::Frame> frame{ Frame(arena) };
         //
         CYX::Value &state = reg[0]; // if stmt state
-        std::vector<VMInstruction *> vm_insts;
+        // the loaded program and its instructions
+        const Program *program{ nullptr };
+        VMInstruction *const *vm_insts{ nullptr };
         VMInstruction *cur_inst{ nullptr };
         //
         Mode mode = Mode::INIT;
@@ -62,12 +138,39 @@ namespace CVM
         int entry_end{ 0 };           // main function end
         int pc{ 0 };                  // program counter
         int global_var_init_len{ 0 }; // global data initialize instruction length
+        // set by a buildin which stops `execute()`
+        Status suspend{ Status::FINISHED };
+        bool await_input{ false };
+        std::deque<std::string> inputs;
+        // `parallel_map()` runs on `parallel_jobs` threads, every one of them has a child VM. A child's own
+        // `parallel_map()` runs on its thread.
+        int parallel_jobs{ static_cast<int>(std::max(1u, std::thread::hardware_concurrency())) };
+        std::unique_ptr<ThreadPool> parallel_pool;
+        std::vector<std::unique_ptr<VM>> children;
+        // compiles hot functions of the loaded program, only while nothing limits how far `execute()` may run
+        bool jit_enabled{ false };
+        std::unique_ptr<Jit> jit;
+        // results of memoized functions, keyed by function position and then by argument values
+        static constexpr int MEMO_CACHE_SIZE = 4096;
+        std::unordered_map<int, std::unordered_map<std::string, CYX::Value>> memo_cache;
+        // executed opcode n-grams, a sequence never spans a jump, call or return
+        static constexpr int NGRAM_MAX   = 4;
+        static constexpr int PROFILE_TOP = 24;
+        bool profile{ false };
+        std::array<Opcode, NGRAM_MAX> ngram_window{};
+        int ngram_len{ 0 };
+        std::unordered_map<unsigned long long, long long> ngram_count; // n, then the opcodes, one byte each
 
       public:
-        void setInsts(const std::vector<VMInstruction *> &insts);
-        void setEntry(int i);
-        void setGlobalInitLen(int i);
-        void setEntryEnd(int i);
+        void setProfile(bool b);
+        // used by the frames of the next `load()` or `reset()`, it has to outlive the VM
+        void setArena(std::pmr::memory_resource *resource);
+        // threads of `parallel_map()`, taken on its first call
+        void setParallelJobs(int jobs);
+        // compiles hot functions to x86-64 code, see `Jit`. Does nothing unless `Jit::supported()`, and `runFor()`
+        // and `setProfile(true)` stay with the interpreter.
+        void setJit(bool b);
+        std::string profileStr();
     };
 } // namespace CVM
 
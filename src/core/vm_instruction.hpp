@@ -2,14 +2,20 @@
 #define CVM_VM_INSTRUCTION_HPP
 
 #include "../common/value.hpp"
+#include "../utility/utility.hpp"
 #include "opcode.hpp"
 
 #include <memory>
 #include <sstream>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace CVM
 {
+    // size of the VM register file, %0 is the `state` register
+    constexpr int REGISTER_COUNT = 12;
+
     enum class ArgType
     {
         MAP, // 0
@@ -58,7 +64,8 @@ namespace CVM
         }
         std::string toString() override
         {
-            std::string str = "LOADX %" + std::to_string(reg_idx) + " " + name;
+            std::string str = opcode == Opcode::LOADXU ? "LOADXU %" : "LOADX %";
+            str += std::to_string(reg_idx) + " " + name;
             for (int i = 0; i < index.size(); i++)
             {
                 str += "[";
@@ -74,6 +81,15 @@ namespace CVM
         std::vector<ArrIdx> index;
     };
 
+    // the compiler proved every index in range, see `IRVar::in_bounds`
+    struct LoadXU : LoadX
+    {
+        LoadXU()
+        {
+            opcode = Opcode::LOADXU;
+        }
+    };
+
     struct LoadXA : Load
     {
         LoadXA()
@@ -125,7 +141,7 @@ namespace CVM
         std::vector<CVM::ArrIdx> index;
         std::string toString() override
         {
-            std::string str = "STOREA " + name;
+            std::string str = (opcode == Opcode::STOREAU ? "STOREAU " : "STOREA ") + name;
             for (int i = 0; i < index.size(); i++)
             {
                 str += "[";
@@ -140,6 +156,14 @@ namespace CVM
         CYX::Value value;
     };
 
+    struct StoreAU : StoreA
+    {
+        StoreAU()
+        {
+            opcode = Opcode::STOREAU;
+        }
+    };
+
     struct StoreX : Store
     {
         StoreX()
@@ -148,7 +172,7 @@ namespace CVM
         }
         std::string toString() override
         {
-            std::string str = "STOREX " + name;
+            std::string str = (opcode == Opcode::STOREXU ? "STOREXU " : "STOREX ") + name;
             for (int i = 0; i < index.size(); i++)
             {
                 str += "[";
@@ -164,6 +188,14 @@ namespace CVM
         std::vector<ArrIdx> index;
     };
 
+    struct StoreXU : StoreX
+    {
+        StoreXU()
+        {
+            opcode = Opcode::STOREXU;
+        }
+    };
+
 #define STORE_INST(X, OP, TYPE)                                                                                        \
     struct X : Store                                                                                                   \
     {                                                                                                                  \
@@ -241,11 +273,13 @@ namespace CVM
         }
         std::string toString() override
         {
-            return "FUNC " + name + " PARAM COUNT " + std::to_string(param_count);
+            return "FUNC " + name + " PARAM COUNT " + std::to_string(param_count) + (memoize ? " MEMO" : "");
         }
 
         std::string name;
         int param_count{ 0 };
+        bool memoize{ false };       // pure, results are cached by argument values
+        bool writes_globals{ true }; // a bytecode file doesn't say, see `VM::parallelMap()`
     };
 
     struct Param : VMInstruction
@@ -305,6 +339,69 @@ namespace CVM
         }
     };
 
+    // goes to `targets[value - base]` if register `reg_idx` holds an int in range, else to `default_target`
+    struct JTable : VMInstruction
+    {
+        JTable()
+        {
+            opcode = Opcode::JTABLE;
+        }
+        int reg_idx{ -1 };
+        long long base{ 0 };
+        std::vector<std::string> basic_block_names; // one per value from `base` on
+        std::string default_block_name;
+        std::vector<int> targets;
+        int default_target{ -1 };
+        std::string toString() override
+        {
+            std::string str = "JTABLE %" + std::to_string(reg_idx) + " " + std::to_string(base);
+            for (auto target : targets)
+            {
+                str += " " + std::to_string(target);
+            }
+            return str + " " + std::to_string(default_target);
+        }
+    };
+
+    // goes to `targets[i]` if register `reg_idx` holds `int_keys[i]` (sorted, binary search),
+    // or to `targets[int_keys.size() + i]` if it holds `str_keys[i]` (hashed), else to `default_target`
+    struct JLookup : VMInstruction
+    {
+        JLookup()
+        {
+            opcode = Opcode::JLOOKUP;
+        }
+        int reg_idx{ -1 };
+        std::vector<long long> int_keys;
+        std::vector<std::string> str_keys;
+        std::vector<std::string> basic_block_names; // one per key
+        std::string default_block_name;
+        std::vector<int> targets;
+        int default_target{ -1 };
+        std::unordered_map<std::string, int> str_index; // built by `indexKeys()`
+        void indexKeys()
+        {
+            str_index.clear();
+            for (int i = 0; i < str_keys.size(); i++)
+            {
+                str_index.emplace(str_keys[i], int_keys.size() + i);
+            }
+        }
+        std::string toString() override
+        {
+            std::string str = "JLOOKUP %" + std::to_string(reg_idx);
+            for (int i = 0; i < targets.size(); i++)
+            {
+                if (i < int_keys.size())
+                    str += " " + std::to_string(int_keys[i]);
+                else
+                    str += " \"" + str_keys[i - int_keys.size()] + "\"";
+                str += ":" + std::to_string(targets[i]);
+            }
+            return str + " " + std::to_string(default_target);
+        }
+    };
+
     struct Binary : VMInstruction
     {
         int reg_idx1{ -1 };
@@ -344,6 +441,54 @@ namespace CVM
 
 #undef ARITHMETIC_INST
 
+    // %reg += val, an integer fast path for induction variables
+    struct AddI : VMInstruction
+    {
+        AddI()
+        {
+            opcode = Opcode::ADDI;
+        }
+        std::string toString() override
+        {
+            return "ADDI %" + std::to_string(reg_idx) + " " + std::to_string(val);
+        }
+        int reg_idx{ -1 };
+        long long val{ 0 };
+    };
+
+    // one dispatch for `LOADX %1 lhs; LOADX %2 rhs (or LOADI %2 val); op %1 %2`, optionally followed by
+    // `STOREX dest` of the result register. Every register is left as the unfused sequence leaves it.
+    struct BinaryX : VMInstruction
+    {
+        explicit BinaryX(Opcode opcode)
+        {
+            this->opcode = opcode;
+        }
+        // cmp ops write `state`
+        int resultReg() const
+        {
+            return inOr(op, Opcode::LOR, Opcode::LAND, Opcode::NE, Opcode::EQ, Opcode::LT, Opcode::LE, Opcode::GT,
+                        Opcode::GE)
+                       ? 0
+                       : reg_idx1;
+        }
+        std::string toString() override
+        {
+            std::string str = std::string(opcode == Opcode::BINXX ? "BINXX " : "BINXI ") + opcode2Str(op) + " %" +
+                              std::to_string(reg_idx1) + " " + lhs + " %" + std::to_string(reg_idx2) + " " +
+                              (opcode == Opcode::BINXX ? rhs : std::to_string(val));
+            if (!dest.empty()) str += " => " + dest;
+            return str;
+        }
+        Opcode op{ Opcode::UNKNOWN };
+        int reg_idx1{ -1 };
+        int reg_idx2{ -1 };
+        std::string lhs;
+        std::string rhs;    // BINXX
+        long long val{ 0 }; // BINXI
+        std::string dest;   // empty if the result isn't stored
+    };
+
     struct Cmp : Binary
     {
     };
@@ -375,6 +520,34 @@ namespace CVM
 
 #undef CMP_INST
 
+    // nullptr if `opcode` isn't a binary op
+    static inline Binary *newBinary(Opcode opcode)
+    {
+        switch (opcode)
+        {
+            case Opcode::ADD: return new Add;
+            case Opcode::SUB: return new Sub;
+            case Opcode::MUL: return new Mul;
+            case Opcode::DIV: return new Div;
+            case Opcode::MOD: return new Mod;
+            case Opcode::EXP: return new Exp;
+            case Opcode::BAND: return new Band;
+            case Opcode::BOR: return new Bor;
+            case Opcode::BXOR: return new Bxor;
+            case Opcode::SHL: return new Shl;
+            case Opcode::SHR: return new Shr;
+            case Opcode::LOR: return new Lor;
+            case Opcode::NE: return new Ne;
+            case Opcode::EQ: return new Eq;
+            case Opcode::LT: return new Lt;
+            case Opcode::LE: return new Le;
+            case Opcode::GT: return new Gt;
+            case Opcode::GE: return new Ge;
+            case Opcode::LAND: return new Land;
+            default: return nullptr;
+        }
+    }
+
     struct Unary : VMInstruction
     {
         int reg_idx{ -2 };
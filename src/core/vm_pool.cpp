@@ -0,0 +1,92 @@
+#include "vm_pool.h"
+
+CVM::VMPool::VMPool(int workers, int queue_size) : jobs(queue_size)
+{
+    for (int i = 0; i < std::max(1, workers); i++)
+    {
+        this->workers.push_back(std::make_unique<Worker>());
+        this->workers.back()->vm.setArena(&this->workers.back()->arena);
+    }
+    for (auto &worker : this->workers)
+    {
+        threads.emplace_back([this, &worker] { loop(*worker); });
+    }
+}
+
+CVM::VMPool::~VMPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    wake.notify_all();
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+}
+
+std::future<CYX::Value> CVM::VMPool::submit(const Program &program, const std::string &name,
+                                            std::vector<CYX::Value> args)
+{
+    Job job;
+    job.program = &program;
+    job.name    = name;
+    job.args    = std::move(args);
+    auto result = job.result.get_future();
+    while (!jobs.push(job))
+    {
+        std::this_thread::yield();
+    }
+    // either a worker about to sleep sees the job, or this sees the worker and wakes it up
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (idle.load() > 0)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+        }
+        wake.notify_one();
+    }
+    return result;
+}
+
+int CVM::VMPool::size() const
+{
+    return workers.size();
+}
+
+void CVM::VMPool::loop(Worker &worker)
+{
+    Job job;
+    while (true)
+    {
+        if (jobs.pop(job))
+        {
+            runJob(worker, job);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        idle++;
+        bool got = false;
+        // the queue is drained before stopping
+        wake.wait(lock, [this, &job, &got] { return (got = jobs.pop(job)) || stop; });
+        idle--;
+        if (!got) return;
+        lock.unlock();
+        runJob(worker, job);
+    }
+}
+
+void CVM::VMPool::runJob(Worker &worker, Job &job)
+{
+    // only resets the VM, the program is shared as it is
+    worker.vm.load(*job.program);
+    try
+    {
+        job.result.set_value(worker.vm.call(job.name, job.args));
+    }
+    catch (...)
+    {
+        job.result.set_exception(std::current_exception());
+    }
+}
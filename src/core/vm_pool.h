@@ -0,0 +1,69 @@
+#ifndef CVM_VM_POOL_H
+#define CVM_VM_POOL_H
+
+#include "../common/config.h"
+#include "../common/value.hpp"
+#include "../utility/mpmc_queue.hpp"
+#include "program.hpp"
+#include "vm.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace CVM
+{
+    // Runs independent calls on a fixed set of worker threads. Programs are shared read only, every worker owns a
+    // VM (registers, frames, globals) and an arena for its frames, and a VM is reset before each job, so jobs never
+    // see each other's state. Jobs go through a lock-free queue, a worker only takes the lock to sleep when the
+    // queue is empty.
+    class VMPool
+    {
+      public:
+        explicit VMPool(int workers, int queue_size = 1024);
+        VMPool(const VMPool &) = delete;
+        VMPool &operator=(const VMPool &) = delete;
+        // finishes the queued jobs first
+        ~VMPool();
+
+        // calls `name` of `program` with `args` on the next free worker, `program` has to outlive the job.
+        // blocks while the queue is full. the future rethrows the `CYX::Error` of a call which can't be made
+        std::future<CYX::Value> submit(const Program &program, const std::string &name = ENTRY_FUNC,
+                                       std::vector<CYX::Value> args = {});
+        int size() const;
+
+      private:
+        struct Job
+        {
+            const Program *program{ nullptr };
+            std::string name;
+            std::vector<CYX::Value> args;
+            std::promise<CYX::Value> result;
+        };
+        struct Worker
+        {
+            std::pmr::unsynchronized_pool_resource arena;
+            VM vm;
+        };
+
+        void loop(Worker &worker);
+        static void runJob(Worker &worker, Job &job);
+
+      private:
+        MPMCQueue<Job> jobs;
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::vector<std::thread> threads;
+        std::mutex mutex; // only for sleeping
+        std::condition_variable wake;
+        std::atomic<int> idle{ 0 }; // workers waiting on `wake`
+        bool stop{ false };
+    };
+} // namespace CVM
+
+#endif // CVM_VM_POOL_H
@@ -1,16 +1,13 @@
 #include "common/config.h"
-#include "compiler/ast/ast_visualize.h"
-#include "compiler/bytecode/bytecode_generator.h"
 #include "compiler/bytecode/bytecode_writer.h"
-#include "compiler/bytecode/peephole_optimization.h"
-#include "compiler/ir/basicblock.hpp"
-#include "compiler/ir/cfg.h"
-#include "compiler/ir/ir_generator.h"
-#include "compiler/parser.h"
-#include "compiler/token.hpp"
+#include "compiler/compiler.h"
+#include "compiler/source_file.h"
 #include "core/bytecode_reader.h"
+#include "core/bytecode_verifier.h"
 #include "core/vm.hpp"
 
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <string>
 
@@ -23,13 +20,27 @@ void showHelp()
     str += "cyx2 -i-bytecode <bytecode file>\n";
     const std::vector<std::vector<std::string>> usage = {
         { "-ssa", "enable SSA mode, default is disabled" },                                               //
+        { "-pruned-ssa", "only insert phi nodes for live variables(liveness and SSA based)" },            //
         { "-constant-folding", "enable constant folding(SSA based)" },                                    //
         { "-constant-propagation", "enable constant propagation(constant folding and SSA based)" },       //
+        { "-sccp", "sparse conditional constant propagation, removes constant branches(SSA based)" },     //
+        { "-gvn", "global value numbering, reuses redundant expressions(SSA based)" },                    //
+        { "-licm", "hoist loop invariant code into loop preheaders(SSA based)" },                         //
+        { "-induction-variable", "typed induction variables, drops proven bounds checks(SSA based)" },    //
+        { "-inline", "inline small non-recursive functions(before SSA construction)" },                   //
+        { "-ipcp", "propagate constant arguments into callees, clones small ones(interprocedural)" },     //
+        { "-memoize", "cache results of pure recursive functions in the VM(interprocedural)" },           //
         { "-no-code-simplify", "disable clearing temporary variables(after normal ir construction)" },    //
         { "-no-cfg-simplify", "disable clearing redundant basicblocks(empty and useless basicblocks)" },  //
         { "-remove-unused-code", "remove unused variable definitions, base on normal IR(aggressively)" }, //
         { "-dead-code-elimination", "dead code elimination(SSA based)" },                                 //
+        { "-dead-store-elimination", "remove overwritten array element and global stores(normal IR)" },   //
         { "-peephole", "enable peephole optimization(base on bytecode)" },                                //
+        { "-superinstruction", "fuse common instruction sequences into superinstructions(bytecode)" },    //
+        { "-block-layout", "reorder blocks and rotate loops to save jumps(base on bytecode)" },           //
+        { "-profile-ngrams", "print the most frequent executed opcode sequences to stderr" },             //
+        { "-jit", "compile hot functions to x86-64 code while running(Linux only)" },                     //
+        { "-jobs", "<N> run SSA construction, its optimizations and bytecode emission on N threads" },    //
         { "-dump-cfg", "dump CFG(Graphviz), dump to stdout if `-dump-as-file` is not set" },              //
         { "-dump-ir", "dump IR, dump to stdout if `-dump-as-file` is not set" },                          //
         { "-dump-ast", "dump AST(Graphviz), dump to stdout if `-dump-as-file` is not set" },              //
@@ -54,18 +65,13 @@ void showHelp()
     std::cout << str;
 }
 
-void readBytecode(CVM::BytecodeReader &bytecode_reader)
+void runVM(CVM::VM &vm, const CVM::Program &program, bool profile_ngrams, bool jit)
 {
-    bytecode_reader.readInsts();
-}
-
-void runVM(CVM::VM &vm, const std::vector<CVM::VMInstruction *> &insts, int entry, int entry_end, int global_init_len)
-{
-    vm.setInsts(insts);
-    vm.setEntry(entry);
-    vm.setEntryEnd(entry_end);
-    vm.setGlobalInitLen(global_init_len);
+    vm.setJit(jit);
+    vm.load(program);
+    vm.setProfile(profile_ngrams);
     vm.run();
+    if (profile_ngrams) std::cerr << vm.profileStr();
 }
 
 void writeFile(const std::string &filename, const std::string &content)
@@ -77,7 +83,7 @@ void writeFile(const std::string &filename, const std::string &content)
     out.close();
 }
 
-int main(int argc, char *argv[])
+int run(int argc, char *argv[])
 {
     if (argc <= 1)
     {
@@ -93,24 +99,44 @@ int main(int argc, char *argv[])
     std::string bytecode_input;              // binary
     std::string src_input = args.back();
     //
-    bool dump_as_file = false;
+    CompileOptions options;
+    bool profile_ngrams = false;
+    bool jit            = false;
+    bool dump_ast       = false;
+    bool dump_ir        = false;
+    bool dump_cfg       = false;
+    bool dump_vm_inst   = false;
+    bool dump_as_file   = false;
     //
 
 #define CASE_TRUE(COND, VAR) else if (args[i] == (COND)) VAR = true;
     for (int i = 0; i < args.size() - 1; i++)
     {
-        if (args[i] == "-ssa") NO_SSA = false;
-        CASE_TRUE("-constant-folding", CONSTANT_FOLDING)
-        CASE_TRUE("-constant-propagation", CONSTANT_PROPAGATION)
-        CASE_TRUE("-no-code-simplify", NO_CODE_SIMPLIFY)
-        CASE_TRUE("-no-cfg-simplify", NO_CFG_SIMPLIFY)
-        CASE_TRUE("-remove-unused-code", REMOVE_UNUSED_DEFINE)
-        CASE_TRUE("-dead-code-elimination", DEAD_CODE_ELIMINATION)
-        CASE_TRUE("-peephole", PEEPHOLE)
-        CASE_TRUE("-dump-cfg", DUMP_CFG_STR)
-        CASE_TRUE("-dump-ir", DUMP_IR_STR)
-        CASE_TRUE("-dump-ast", DUMP_AST_STR)
-        CASE_TRUE("-dump-vm-inst", DUMP_VM_INST_STR)
+        if (args[i] == "-ssa") options.ssa = true;
+        CASE_TRUE("-pruned-ssa", options.pruned_ssa)
+        CASE_TRUE("-constant-folding", options.constant_folding)
+        CASE_TRUE("-constant-propagation", options.constant_propagation)
+        CASE_TRUE("-sccp", options.sccp)
+        CASE_TRUE("-gvn", options.gvn)
+        CASE_TRUE("-licm", options.licm)
+        CASE_TRUE("-induction-variable", options.induction_variable)
+        CASE_TRUE("-inline", options.inline_function)
+        CASE_TRUE("-ipcp", options.ipcp)
+        CASE_TRUE("-memoize", options.memoize)
+        CASE_TRUE("-no-code-simplify", options.no_code_simplify)
+        CASE_TRUE("-no-cfg-simplify", options.no_cfg_simplify)
+        CASE_TRUE("-remove-unused-code", options.remove_unused_define)
+        CASE_TRUE("-dead-code-elimination", options.dead_code_elimination)
+        CASE_TRUE("-dead-store-elimination", options.dead_store_elimination)
+        CASE_TRUE("-peephole", options.peephole)
+        CASE_TRUE("-superinstruction", options.superinstruction)
+        CASE_TRUE("-block-layout", options.block_layout)
+        CASE_TRUE("-profile-ngrams", profile_ngrams)
+        CASE_TRUE("-jit", jit)
+        CASE_TRUE("-dump-cfg", dump_cfg)
+        CASE_TRUE("-dump-ir", dump_ir)
+        CASE_TRUE("-dump-ast", dump_ast)
+        CASE_TRUE("-dump-vm-inst", dump_vm_inst)
         CASE_TRUE("-dump-as-file", dump_as_file)
         else if (args[i] == "-o-ast")
         {
@@ -136,6 +162,10 @@ int main(int argc, char *argv[])
         {
             vm_inst_output = args[++i];
         }
+        else if (args[i] == "-jobs")
+        {
+            options.jobs = std::max(1, std::atoi(args[++i].c_str()));
+        }
         else
         {
             std::cerr << "Unsupported option `" + args[i] + "` \n";
@@ -150,91 +180,79 @@ int main(int argc, char *argv[])
     if (!bytecode_input.empty())
     {
         CVM::BytecodeReader bytecode_reader(bytecode_input);
+        bytecode_reader.readInsts();
+        auto program = bytecode_reader.program();
         CVM::VM vm;
-        readBytecode(bytecode_reader);
-        runVM(vm, bytecode_reader.vm_insts, bytecode_reader.entry, bytecode_reader.entry_end,
-              bytecode_reader.global_var_len);
+        runVM(vm, program, profile_ngrams, jit);
         return 0;
     }
 
     // read src
-    std::ifstream in(src_input, std::ios::in);
-    std::string code((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
-    // parse src
-    COMPILER::Parser parser(code);
-    auto *ast = parser.parse();
-    // build ir
-    COMPILER::IRGenerator ir_generator;
-    ir_generator.visitTree(ast);
-
-    // NO_CODE_SIMPLIFY is moved to the end of IRGenerator::visitTree()
-
-    if (REMOVE_UNUSED_DEFINE) ir_generator.removeUnusedVarDef();
-    // cfg, ssa, optimize related.
-    COMPILER::CFG cfg;
-    cfg.funcs = ir_generator.funcs;
-    if (!NO_CFG_SIMPLIFY) cfg.simplifyCFG();
-    if (!NO_SSA) cfg.transformToSSA();
-    // vm instruction builder
-    COMPILER::BytecodeGenerator bytecode_generator;
-    bytecode_generator.funcs       = cfg.funcs;
-    bytecode_generator.global_vars = ir_generator.global_var_decl;
-    bytecode_generator.ir2VmInst();
-    // peephole
-    if (PEEPHOLE)
-    {
-        COMPILER::PeepholeOptimization peephole;
-        peephole.block_list = &bytecode_generator.bytecode_basicblocks;
-        peephole.doPeepholeOptimization();
-    }
-    bytecode_generator.relocation();
+    COMPILER::SourceFile source(src_input);
+    COMPILER::Compiler compiler;
+    compiler.options = options;
+    compiler.build(source.code());
 
     // dump debug str
-    if (DUMP_AST_STR)
+    if (dump_ast)
     {
-        COMPILER::ASTVisualize ast_visualizer;
-        ast_visualizer.visitTree(ast);
         if (!dump_as_file)
-            std::cout << ast_visualizer.astStr();
+            std::cout << compiler.astStr();
         else
-            writeFile(ast_output, ast_visualizer.astStr());
+            writeFile(ast_output, compiler.astStr());
     }
-    if (DUMP_IR_STR)
+    if (dump_ir)
     {
         if (!dump_as_file)
-            std::cout << ir_generator.irStr();
+            std::cout << compiler.irStr();
         else
-            writeFile(ir_output, ir_generator.irStr());
+            writeFile(ir_output, compiler.irStr());
     }
-    if (DUMP_CFG_STR)
+    if (dump_cfg)
     {
         if (!dump_as_file)
-            std::cout << cfg.cfgStr();
+            std::cout << compiler.cfgStr();
         else
-            writeFile(cfg_output, cfg.cfgStr());
+            writeFile(cfg_output, compiler.cfgStr());
     }
-    if (DUMP_VM_INST_STR)
+    if (dump_vm_inst)
     {
         if (!dump_as_file)
-            std::cout << bytecode_generator.vmInstStr();
+            std::cout << compiler.vmInstStr();
         else
-            writeFile(vm_inst_output, bytecode_generator.vmInstStr());
+            writeFile(vm_inst_output, compiler.vmInstStr());
     }
 
+    auto program = compiler.program();
+
     if (!bytecode_output.empty())
     {
         COMPILER::BytecodeWriter bytecode_writer(bytecode_output);
-        bytecode_writer.entry          = bytecode_generator.entry;
-        bytecode_writer.entry_end      = bytecode_generator.entry_end;
-        bytecode_writer.global_var_len = bytecode_generator.global_var_len;
-        bytecode_writer.vm_insts       = bytecode_generator.vm_insts;
+        bytecode_writer.entry          = program.entry;
+        bytecode_writer.entry_end      = program.entry_end;
+        bytecode_writer.global_var_len = program.global_var_len;
+        bytecode_writer.vm_insts       = program.vm_insts;
         bytecode_writer.writeInsts();
         bytecode_writer.writeToFile();
         return 0;
     }
 
+    CVM::BytecodeVerifier::verify(program);
     CVM::VM vm;
-    runVM(vm, bytecode_generator.vm_insts, bytecode_generator.entry, bytecode_generator.entry_end,
-          bytecode_generator.global_var_len);
+    runVM(vm, program, profile_ngrams, jit);
     return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    // the library throws what the command line tool reports and exits for
+    try
+    {
+        return run(argc, argv);
+    }
+    catch (const CYX::Error &error)
+    {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include <dbg.h>
 #include <iostream>
+#include <stdexcept>
 
 #ifdef CYX_DEBUG
     #define LOGD(...) dbg(__VA_ARGS__)
@@ -17,6 +18,19 @@
         } while (false)
 #endif
 
+namespace CYX
+{
+    // what the library reports to its host instead of exiting: a script which doesn't compile, bytecode which
+    // doesn't verify and calls a VM can't make
+    class Error : public std::runtime_error
+    {
+      public:
+        using std::runtime_error::runtime_error;
+    };
+} // namespace CYX
+
+#define THROW(ARG) throw CYX::Error(ARG)
+
 #define UNREACHABLE()                                                                                                  \
     do                                                                                                                 \
     {                                                                                                                  \
@@ -0,0 +1,93 @@
+#ifndef CVM_MPMC_QUEUE_HPP
+#define CVM_MPMC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+// A bounded queue for many producers and many consumers without locks (Dmitry Vyukov's ring buffer).
+// Every cell carries a sequence number which tells whether it is free for the push of round `pos` or holds the
+// value for the pop of round `pos`, so a producer and a consumer only ever race on `tail` / `head` with a CAS.
+template<typename T>
+class MPMCQueue
+{
+  public:
+    // `capacity` is rounded up to a power of two
+    explicit MPMCQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+        mask  = size - 1;
+        cells = std::make_unique<Cell[]>(size);
+        for (size_t i = 0; i < size; i++)
+        {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+    MPMCQueue(const MPMCQueue &) = delete;
+    MPMCQueue &operator=(const MPMCQueue &) = delete;
+
+    // moves `value` in, false if the queue is full
+    bool push(T &value)
+    {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        Cell *cell = nullptr;
+        while (true)
+        {
+            cell      = &cells[pos & mask];
+            auto diff = static_cast<std::ptrdiff_t>(cell->sequence.load(std::memory_order_acquire) - pos);
+            if (diff == 0)
+            {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            }
+            else if (diff < 0) // the cell still holds the value of the previous round
+                return false;
+            else // another producer took this cell
+                pos = tail.load(std::memory_order_relaxed);
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // moves the oldest value out, false if the queue is empty
+    bool pop(T &value)
+    {
+        size_t pos = head.load(std::memory_order_relaxed);
+        Cell *cell = nullptr;
+        while (true)
+        {
+            cell      = &cells[pos & mask];
+            auto diff = static_cast<std::ptrdiff_t>(cell->sequence.load(std::memory_order_acquire) - (pos + 1));
+            if (diff == 0)
+            {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            }
+            else if (diff < 0) // nothing pushed into this cell yet
+                return false;
+            else // another consumer took this cell
+                pos = head.load(std::memory_order_relaxed);
+        }
+        value = std::move(cell->value);
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+  private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence{ 0 };
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask{ 0 };
+    // producers and consumers don't share a cache line
+    alignas(64) std::atomic<size_t> tail{ 0 };
+    alignas(64) std::atomic<size_t> head{ 0 };
+};
+
+#endif // CVM_MPMC_QUEUE_HPP
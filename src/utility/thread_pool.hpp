@@ -0,0 +1,181 @@
+#ifndef CVM_THREAD_POOL_HPP
+#define CVM_THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of workers for `parallelFor()`. Every worker starts with a contiguous share of the tasks in its
+// own queue, takes them from the back and steals from the front of the others' queues once it runs dry.
+class ThreadPool
+{
+  public:
+    explicit ThreadPool(int jobs) : queues(jobs < 1 ? 1 : jobs)
+    {
+        // the calling thread is worker 0
+        for (int i = 1; i < queues.size(); i++)
+        {
+            threads.emplace_back([this, i] { loop(i); });
+        }
+    }
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_all();
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    int size() const
+    {
+        return queues.size();
+    }
+
+    // calls `func(task, worker)` for every task in [0, n) and returns once all of them are done,
+    // `worker` is in [0, size()) and runs one task at a time, so per worker state needs no lock.
+    // if a task throws, the tasks which haven't started are skipped and the first exception is rethrown
+    // once every worker is done with `func`.
+    void parallelFor(int n, const std::function<void(int, int)> &func)
+    {
+        if (n <= 0) return;
+        // published before any task can be taken, a worker which takes a task has seen `job` of this call
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job       = &func;
+            remaining = n;
+            generation++;
+        }
+        for (int i = 0; i < queues.size(); i++)
+        {
+            std::lock_guard<std::mutex> lock(queues[i].mutex);
+            for (int task = n * i / size(); task < n * (i + 1) / size(); task++)
+            {
+                queues[i].tasks.push_back(task);
+            }
+        }
+        wake.notify_all();
+        runTasks(0, func);
+        std::unique_lock<std::mutex> lock(mutex);
+        // a worker still looking for tasks must not see the queues of the next call
+        done.wait(lock, [this] { return remaining == 0 && active == 0; });
+        job          = nullptr;
+        failed       = false;
+        auto pending = std::move(error);
+        error        = nullptr;
+        lock.unlock();
+        if (pending != nullptr) std::rethrow_exception(pending);
+    }
+
+  private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<int> tasks;
+    };
+
+    void loop(int worker)
+    {
+        int seen = 0;
+        while (true)
+        {
+            const std::function<void(int, int)> *func;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this, seen] { return stop || generation != seen; });
+                if (stop) return;
+                seen = generation;
+                func = job;
+                // woke up after the call it was woken for had returned
+                if (func == nullptr) continue;
+                active++;
+            }
+            runTasks(worker, *func);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                active--;
+            }
+            done.notify_all();
+        }
+    }
+
+    void runTasks(int worker, const std::function<void(int, int)> &func)
+    {
+        int task     = 0;
+        int finished = 0;
+        while (pop(worker, task))
+        {
+            finished++;
+            if (failed) continue;
+            try
+            {
+                func(task, worker);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (error == nullptr) error = std::current_exception();
+                failed = true;
+            }
+        }
+        if (finished == 0) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            remaining -= finished;
+        }
+        done.notify_all();
+    }
+
+    bool pop(int worker, int &task)
+    {
+        {
+            auto &own = queues[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty())
+            {
+                task = own.tasks.back();
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+        for (int i = 1; i < queues.size(); i++)
+        {
+            auto &victim = queues[(worker + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty())
+            {
+                task = victim.tasks.front();
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+  private:
+    std::vector<Queue> queues;
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(int, int)> *job{ nullptr };
+    int generation{ 0 };
+    int remaining{ 0 }; // tasks of the current call which aren't finished
+    int active{ 0 };    // workers which took part in the current call and haven't finished
+    bool stop{ false };
+    std::exception_ptr error;          // the first exception of the current call
+    std::atomic<bool> failed{ false }; // the rest of the tasks are only taken off the queues
+};
+
+#endif // CVM_THREAD_POOL_HPP
@@ -1,9 +1,18 @@
+#include "compiler/compiler.h"
+#include "compiler/source_file.h"
+#include "core/bytecode_reader.h"
+#include "core/vm.hpp"
+#include "core/vm_pool.h"
+#include "utility/thread_pool.hpp"
+
+#include <atomic>
 #include <cstdio>
 #include <filesystem>
 #include <fstream>
 #include <gtest/gtest.h>
 #include <iostream>
 #include <string>
+#include <tuple>
 
 #if (defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64))
 #define popen _popen
@@ -35,14 +44,15 @@ class CYXTest
         return res;
     }
 
-    std::string executeBytecode(const std::string &path)
+    std::string executeBytecode(const std::string &path, const std::string &options = "")
     {
         const std::string raw_path      = "/" + path;
         const std::string src_file      = testcase_dir + raw_path + ".cyx";
         const std::string input_file    = test_in_dir + raw_path + ".txt";
         const std::string bytecode_file = test_tmp_dir + raw_path;
         std::string res;
-        const std::string build_cmd = executable_file + " -o-bytecode " + bytecode_file + " " + src_file;
+        const std::string build_cmd =
+            executable_file + " " + options + " -o-bytecode " + bytecode_file + " " + src_file;
         system(build_cmd.c_str());
         const std::string command = executable_file + " -i-bytecode " + bytecode_file +
                                     (fs::is_regular_file(input_file) ? " < " + input_file : "");
@@ -57,12 +67,39 @@ class CYXTest
         return res;
     }
 
+    // the command line tool with `args`, stderr included
+    std::string run(const std::string &args)
+    {
+        std::string res;
+        const std::string command = executable_file + " " + args + " 2>&1";
+        if (auto fp = popen(command.c_str(), "r"); fp != nullptr)
+        {
+            while (fgets(buffer, sizeof(buffer), fp) != nullptr)
+            {
+                res += std::string(buffer);
+            }
+            pclose(fp);
+        }
+        return res;
+    }
+
     std::string readfile(const std::string &file)
     {
         std::ifstream in(test_out_dir + "/" + file + ".txt", std::ios::in);
         return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
     }
 
+    // how often `pattern` occurs in the output of `-dump-ir` / `-dump-vm-inst`
+    static int count(const std::string &dump, const std::string &pattern)
+    {
+        int n = 0;
+        for (auto pos = dump.find(pattern); pos != std::string::npos; pos = dump.find(pattern, pos + pattern.size()))
+        {
+            n++;
+        }
+        return n;
+    }
+
     std::vector<std::string> listDir(const std::string &dir)
     {
         std::vector<std::string> test_files;
@@ -262,8 +299,465 @@ TEST(Overall, buildin)
     EXPECT_EQ(test.executeBytecode(file), test.readfile(file));
 }
 
+TEST(Overall, inline)
+{
+    CYXTest test;
+    const std::string file = "overall/inline";
+    EXPECT_EQ(test.execute(file, "-inline"), test.readfile(file));
+    EXPECT_EQ(test.execute(file, "-inline -ssa"), test.readfile(file));
+    EXPECT_EQ(test.execute(file, "-inline -ssa -sccp -gvn -licm -induction-variable -constant-folding "
+                                 "-constant-propagation -dead-code-elimination -peephole"),
+              test.readfile(file));
+    EXPECT_EQ(test.executeBytecode(file), test.readfile(file));
+}
+
+TEST(Overall, interprocedural)
+{
+    CYXTest test;
+    const std::string file = "overall/interprocedural";
+    EXPECT_EQ(test.execute(file, "-ipcp"), test.readfile(file));
+    EXPECT_EQ(test.execute(file, "-memoize"), test.readfile(file));
+    EXPECT_EQ(test.execute(file, "-ipcp -memoize -ssa"), test.readfile(file));
+    EXPECT_EQ(test.execute(file, "-ipcp -memoize -inline -ssa -sccp -gvn -licm -induction-variable -constant-folding "
+                                 "-constant-propagation -dead-code-elimination -peephole"),
+              test.readfile(file));
+    EXPECT_EQ(test.executeBytecode(file, "-ipcp -memoize"), test.readfile(file));
+}
+
+TEST(Overall, dead_store)
+{
+    CYXTest test;
+    const std::string file = "overall/dead_store";
+    EXPECT_EQ(test.execute(file, "-dead-store-elimination"), test.readfile(file));
+    EXPECT_EQ(test.execute(file, "-dead-store-elimination -inline -ipcp -peephole"), test.readfile(file));
+    EXPECT_EQ(test.executeBytecode(file, "-dead-store-elimination"), test.readfile(file));
+}
+
+TEST(Overall, superinstruction)
+{
+    CYXTest test;
+    const std::string file = "overall/superinstruction";
+    EXPECT_EQ(test.execute(file, ""), test.readfile(file));
+    EXPECT_EQ(test.execute(file, "-superinstruction"), test.readfile(file));
+    EXPECT_EQ(test.execute(file, "-peephole -superinstruction"), test.readfile(file));
+    EXPECT_EQ(test.execute(file, "-peephole -superinstruction -inline -dead-store-elimination"), test.readfile(file));
+    EXPECT_EQ(test.executeBytecode(file, "-peephole -superinstruction"), test.readfile(file));
+}
+
+TEST(Overall, block_layout)
+{
+    CYXTest test;
+    const std::string file = "overall/block_layout";
+    EXPECT_EQ(test.execute(file, "-block-layout"), test.readfile(file));
+    EXPECT_EQ(test.execute(file, "-peephole -superinstruction -block-layout"), test.readfile(file));
+    EXPECT_EQ(test.execute(file, "-ssa -sccp -gvn -licm -induction-variable -peephole -block-layout"),
+              test.readfile(file));
+    EXPECT_EQ(test.executeBytecode(file, "-peephole -block-layout"), test.readfile(file));
+}
+
+TEST(Overall, switch)
+{
+    CYXTest test;
+    const std::string file = "overall/switch";
+    EXPECT_EQ(test.execute(file, ""), test.readfile(file));
+    EXPECT_EQ(test.execute(file, "-ssa"), test.readfile(file));
+    EXPECT_EQ(test.execute(file, "-ssa -sccp -gvn"), test.readfile(file));
+    // constant subjects, the switch is folded at compile time
+    EXPECT_EQ(test.execute(file, "-ipcp -inline -ssa -sccp -constant-propagation"), test.readfile(file));
+    EXPECT_EQ(test.execute(file, "-peephole -superinstruction -block-layout"), test.readfile(file));
+    EXPECT_EQ(test.executeBytecode(file), test.readfile(file));
+    EXPECT_EQ(test.executeBytecode(file, "-peephole -block-layout"), test.readfile(file));
+}
+
+TEST(Overall, tampered_bytecode)
+{
+    CYXTest test;
+    const std::string src_file      = test.test_tmp_dir + "/tampered.cyx";
+    const std::string bytecode_file = test.test_tmp_dir + "/tampered";
+    std::ofstream(src_file) << "def main() {\n    a = [1, 2, 3]\n    b = a[100000]\n    println(b)\n}\n";
+    test.run("-o-bytecode " + bytecode_file + " " + src_file);
+    std::string bytecode;
+    {
+        std::ifstream in(bytecode_file, std::ios::binary);
+        bytecode.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    // LOADX %1 a[...] becomes LOADXU, which would skip the bounds check
+    const std::string operands = std::string("\x01\x01\0\0\0\0\0\0\0", 9) + "a";
+    auto pos = bytecode.find(static_cast<char>(CVM::opcode2UChar(CVM::Opcode::LOADX)) + operands);
+    ASSERT_NE(pos, std::string::npos);
+    bytecode[pos] = static_cast<char>(CVM::opcode2UChar(CVM::Opcode::LOADXU));
+    std::ofstream(bytecode_file, std::ios::binary) << bytecode;
+    EXPECT_NE(test.run("-i-bytecode " + bytecode_file).find("unchecked array access LOADXU"), std::string::npos);
+}
+
+TEST(Overall, short_circuit)
+{
+    CYXTest test;
+    const std::string file = "overall/short_circuit";
+    EXPECT_EQ(test.execute(file, ""), test.readfile(file));
+    EXPECT_EQ(test.execute(file, "-ssa -sccp -gvn"), test.readfile(file));
+    EXPECT_EQ(test.execute(file, "-inline -ipcp"), test.readfile(file));
+    EXPECT_EQ(test.execute(file, "-peephole -superinstruction -block-layout"), test.readfile(file));
+    EXPECT_EQ(test.executeBytecode(file), test.readfile(file));
+}
+
+TEST(Overall, jobs)
+{
+    CYXTest test;
+    for (const std::string file : { "overall/inline", "overall/interprocedural", "overall/switch" })
+    {
+        EXPECT_EQ(test.execute(file, "-jobs 4"), test.readfile(file));
+        EXPECT_EQ(test.execute(file, "-jobs 4 -ssa -sccp -gvn -licm -peephole"), test.readfile(file));
+        EXPECT_EQ(test.executeBytecode(file, "-jobs 3 -ssa -sccp"), test.readfile(file));
+    }
+}
+
+TEST(Library, thread_pool)
+{
+    // back to back calls, a worker which wakes up late must not take the tasks of the next call
+    ThreadPool pool(4);
+    std::atomic<long long> sum{ 0 };
+    const std::function<void(int, int)> add = [&sum](int task, int worker) { sum += task + 1; };
+    for (int i = 0; i < 20000; i++)
+    {
+        pool.parallelFor(2, add);
+    }
+    EXPECT_EQ(sum.load(), 60000);
+    // the first exception comes back to the caller once the other workers are done, the pool goes on
+    const std::function<void(int, int)> fail = [](int task, int worker)
+    {
+        if (task % 7 == 3) throw std::runtime_error("task " + std::to_string(task));
+    };
+    for (int i = 0; i < 100; i++)
+    {
+        EXPECT_THROW(pool.parallelFor(64, fail), std::runtime_error);
+    }
+    sum = 0;
+    pool.parallelFor(100, add);
+    EXPECT_EQ(sum.load(), 5050);
+}
+
+TEST(Library, compile_and_call)
+{
+    const std::string source = "count = 0\n"
+                               "def add(a, b) {\n"
+                               "    count = count + 1\n"
+                               "    return a + b\n"
+                               "}\n"
+                               "def calls() { return count }\n"
+                               "def main() { add(1, 2) }\n";
+    CompileOptions options;
+    options.peephole = true;
+    for (bool layout : { false, true })
+    {
+        options.superinstruction = layout;
+        options.block_layout     = layout;
+        auto program             = COMPILER::Compiler::compile(source, options);
+        CVM::VM vm;
+        vm.load(program);
+        EXPECT_EQ(vm.call("add", { CYX::Value(1), CYX::Value(2) }).as<long long>(), 3);
+        EXPECT_EQ(vm.call("add", { CYX::Value(40), CYX::Value(2) }).as<long long>(), 42);
+        EXPECT_EQ(vm.call("calls").as<long long>(), 2);
+        vm.run();
+        EXPECT_EQ(vm.call("calls").as<long long>(), 3);
+        // a VM starts over on `load()`, the program can be loaded again
+        vm.load(program);
+        EXPECT_EQ(vm.call("calls").as<long long>(), 0);
+    }
+}
+
+TEST(Library, errors)
+{
+    const std::string source = "def add(a, b) { return a + b }\n"
+                               "def squares(n) { for (i = 0; i < n; i++) { yield i * i } }\n"
+                               "def echo() { return read() }\n"
+                               "def main() { add(1, 2) }\n";
+    CompileOptions options;
+    EXPECT_THROW(COMPILER::Compiler::compile("def main() { x = ( }\n", options), CYX::Error);
+    EXPECT_THROW(COMPILER::Compiler::compile("def main() { f(1) }\n", options), CYX::Error);
+    auto program = COMPILER::Compiler::compile(source, options);
+    CVM::VM vm;
+    vm.load(program);
+    EXPECT_THROW(vm.call("nope"), CYX::Error);
+    EXPECT_THROW(vm.call("add", { CYX::Value(1) }), CYX::Error);
+    vm.start("squares", { CYX::Value(3) });
+    EXPECT_EQ(vm.runFor(1000), CVM::VM::Status::YIELDED);
+    EXPECT_THROW(vm.call("add", { CYX::Value(1), CYX::Value(2) }), CYX::Error);
+    // the suspended call is still there
+    EXPECT_EQ(vm.runFor(1000), CVM::VM::Status::YIELDED);
+    EXPECT_EQ(vm.result().as<long long>(), 1);
+    vm.load(program);
+    vm.setAwaitInput(true);
+    EXPECT_THROW(vm.call("echo"), CYX::Error);
+    vm.feed("line");
+    EXPECT_EQ(vm.runFor(1000), CVM::VM::Status::FINISHED);
+    EXPECT_EQ(vm.result().as<std::string>(), "line");
+    // the future of a job gets the error, the worker goes on with the next one
+    CVM::VMPool pool(1);
+    auto failed = pool.submit(program, "nope");
+    auto result = pool.submit(program, "add", { CYX::Value(1), CYX::Value(2) });
+    EXPECT_THROW(failed.get(), CYX::Error);
+    EXPECT_EQ(result.get().as<long long>(), 3);
+}
+
+TEST(Library, run_for)
+{
+    const std::string source = "def sum(n) {\n"
+                               "    s = 0\n"
+                               "    for (i = 0; i < n; i++) { s = s + i }\n"
+                               "    return s\n"
+                               "}\n"
+                               "def fib(n) {\n"
+                               "    if (n <= 1) { return n }\n"
+                               "    return fib(n - 1) + fib(n - 2)\n"
+                               "}\n"
+                               "def main() { sum(3) }\n";
+    CompileOptions options;
+    options.peephole     = true;
+    options.block_layout = true;
+    auto program         = COMPILER::Compiler::compile(source, options);
+    CVM::VM vm;
+    vm.load(program);
+    // a loop stops at its backward jump, recursion at its calls
+    for (const auto &[name, n, expected] : { std::tuple<std::string, int, long long>{ "sum", 1000, 499500 },
+                                             std::tuple<std::string, int, long long>{ "fib", 15, 610 } })
+    {
+        vm.start(name, { CYX::Value(n) });
+        int slices = 1;
+        while (vm.runFor(100) == CVM::VM::Status::PREEMPTED)
+        {
+            slices++;
+        }
+        EXPECT_GT(slices, 10);
+        EXPECT_EQ(vm.result().as<long long>(), expected);
+        EXPECT_EQ(vm.call(name, { CYX::Value(n) }).as<long long>(), expected);
+    }
+    EXPECT_EQ(vm.runFor(1000000), CVM::VM::Status::FINISHED);
+}
+
+TEST(Library, generator)
+{
+    const std::string source = "def squares(n) {\n"
+                               "    for (i = 0; i < n; i++) { yield i * i }\n"
+                               "    return n\n"
+                               "}\n"
+                               "def echo() {\n"
+                               "    a = read()\n"
+                               "    yield a\n"
+                               "    b = read()\n"
+                               "    return a + b\n"
+                               "}\n"
+                               "def main() { squares(2) }\n";
+    CompileOptions options;
+    options.peephole         = true;
+    options.superinstruction = true;
+    auto program             = COMPILER::Compiler::compile(source, options);
+    CVM::VM vm;
+    vm.load(program);
+    vm.start("squares", { CYX::Value(4) });
+    for (long long i = 0; i < 4; i++)
+    {
+        EXPECT_EQ(vm.runFor(1000000), CVM::VM::Status::YIELDED);
+        EXPECT_EQ(vm.result().as<long long>(), i * i);
+    }
+    EXPECT_EQ(vm.runFor(1000000), CVM::VM::Status::FINISHED);
+    EXPECT_EQ(vm.result().as<long long>(), 4);
+    // without a host the yielded values are dropped
+    EXPECT_EQ(vm.call("squares", { CYX::Value(3) }).as<long long>(), 3);
+
+    vm.setAwaitInput(true);
+    vm.start("echo");
+    EXPECT_EQ(vm.runFor(1000000), CVM::VM::Status::WAITING);
+    EXPECT_EQ(vm.runFor(1000000), CVM::VM::Status::WAITING);
+    vm.feed("ab");
+    EXPECT_EQ(vm.runFor(1000000), CVM::VM::Status::YIELDED);
+    EXPECT_EQ(vm.result().as<std::string>(), "ab");
+    EXPECT_EQ(vm.runFor(1000000), CVM::VM::Status::WAITING);
+    vm.feed("cd");
+    EXPECT_EQ(vm.runFor(1000000), CVM::VM::Status::FINISHED);
+    EXPECT_EQ(vm.result().as<std::string>(), "abcd");
+}
+
+TEST(Library, parallel_map)
+{
+    const std::string source = "scale = 3\n"
+                               "def work(x) {\n"
+                               "    scale = scale + 1\n"
+                               "    s = 0\n"
+                               "    for (i = 0; i < x; i++) { s = s + i }\n"
+                               "    return s * scale\n"
+                               "}\n"
+                               "def run(n) {\n"
+                               "    arr = []\n"
+                               "    for (i = 0; i < n; i++) { arr = arr + i }\n"
+                               "    return parallel_map(\"work\", arr)\n"
+                               "}\n"
+                               "def getScale() { return scale }\n"
+                               "def weigh(x) { return x * scale }\n"
+                               "def pick(x) {\n"
+                               "    a = [1, 2, 3]\n"
+                               "    return a[x]\n"
+                               "}\n"
+                               "def each(name, arr) { return parallel_map(name, arr) }\n"
+                               "def main() { run(3) }\n";
+    CompileOptions options;
+    auto program = COMPILER::Compiler::compile(source, options);
+    CVM::VM vm;
+    vm.setParallelJobs(4);
+    vm.load(program);
+    for (int n : { 0, 1, 500 })
+    {
+        auto result = vm.call("run", { CYX::Value(n) });
+        ASSERT_EQ(result.asArray()->size(), n);
+        // every call starts from `scale = 3`
+        for (long long i = 0; i < n; i++)
+        {
+            EXPECT_EQ(result.asArray()->at(i).as<long long>(), i * (i - 1) / 2 * 4);
+        }
+    }
+    EXPECT_EQ(vm.call("getScale").as<long long>(), 3);
+    // `weigh` only reads `scale`
+    std::vector<CYX::Value> arr;
+    for (int i = 0; i < 100; i++)
+    {
+        arr.emplace_back(i);
+    }
+    auto weighed = vm.call("each", { CYX::Value(std::string("weigh")), CYX::Value(arr) });
+    ASSERT_EQ(weighed.asArray()->size(), 100);
+    EXPECT_EQ(weighed.asArray()->at(99).as<long long>(), 297);
+    // an element out of range fails on a pool thread, the call fails as it would without the pool
+    arr.emplace_back(3);
+    const CYX::Value pick(std::string("pick"));
+    EXPECT_THROW(vm.call("each", { pick, CYX::Value(arr) }), std::out_of_range);
+    vm.load(program);
+    auto picked = vm.call("each", { pick, CYX::Value(std::vector<CYX::Value>(3, CYX::Value(2))) });
+    ASSERT_EQ(picked.asArray()->size(), 3);
+    EXPECT_EQ(picked.asArray()->at(2).as<long long>(), 3);
+}
+
+TEST(Library, parallel_map_repeated)
+{
+    const std::string source = "def sq(x) { return x * x }\n"
+                               "def run() { return parallel_map(\"sq\", [1, 2]) }\n"
+                               "def main() { run() }\n";
+    CompileOptions options;
+    auto program = COMPILER::Compiler::compile(source, options);
+    CVM::VM vm;
+    vm.setParallelJobs(4);
+    vm.load(program);
+    // every call hands its elements to the same pool, workers of the last call must not run them
+    for (int i = 0; i < 20000; i++)
+    {
+        auto result = vm.call("run");
+        ASSERT_EQ(result.asArray()->size(), 2);
+        ASSERT_EQ(result.asArray()->at(0).as<long long>(), 1);
+        ASSERT_EQ(result.asArray()->at(1).as<long long>(), 4);
+    }
+}
+
+TEST(Library, jit)
+{
+    const std::string source = "def sum(n, step) {\n"
+                               "    s = 0\n"
+                               "    for (i = 0; i < n; i++) { s = s + step }\n"
+                               "    return s\n"
+                               "}\n"
+                               "def square(x) { return x * x }\n"
+                               "def squares(n) {\n"
+                               "    s = 0\n"
+                               "    for (i = 0; i < n; i++) { s = s + square(i) }\n"
+                               "    return s\n"
+                               "}\n"
+                               "def main() { sum(3, 1) }\n";
+    for (bool superinstruction : { false, true })
+    {
+        CompileOptions options;
+        options.peephole         = superinstruction;
+        options.superinstruction = superinstruction;
+        auto program             = COMPILER::Compiler::compile(source, options);
+        CVM::VM vm;
+        // the interpreter on other platforms
+        vm.setJit(true);
+        vm.load(program);
+        EXPECT_EQ(vm.call("sum", { CYX::Value(5000), CYX::Value(2) }).as<long long>(), 10000);
+        // the int guards fail until the function is dropped
+        EXPECT_EQ(vm.call("sum", { CYX::Value(5000), CYX::Value(0.5) }).as<double>(), 2500.0);
+        EXPECT_EQ(vm.call("sum", { CYX::Value(5000), CYX::Value(2) }).as<long long>(), 10000);
+        // calls leave the native code and come back
+        EXPECT_EQ(vm.call("squares", { CYX::Value(3000) }).as<long long>(), 2999LL * 3000 * 5999 / 6);
+    }
+}
+
+TEST(Library, vm_pool)
+{
+    const std::string source = "count = 0\n"
+                               "def add(a, b) {\n"
+                               "    count = count + 1\n"
+                               "    return a + b + count * 1000\n"
+                               "}\n"
+                               "def main() { add(1, 2) }\n";
+    CompileOptions options;
+    auto program = COMPILER::Compiler::compile(source, options);
+    options.peephole = true;
+    auto optimized   = COMPILER::Compiler::compile(source, options);
+    CVM::VMPool pool(3, 8);
+    std::vector<std::future<CYX::Value>> results;
+    for (int i = 0; i < 200; i++)
+    {
+        results.push_back(pool.submit(i % 2 == 0 ? program : optimized, "add", { CYX::Value(i), CYX::Value(1) }));
+    }
+    // every job starts with fresh globals
+    for (int i = 0; i < 200; i++)
+    {
+        EXPECT_EQ(results[i].get().as<long long>(), i + 1 + 1000);
+    }
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+TEST(Library, bytecode_reader)
+{
+    CYXTest test;
+    const std::string src_file      = test.test_tmp_dir + "/reader.cyx";
+    const std::string bytecode_file = test.test_tmp_dir + "/reader";
+    const std::string broken_file   = test.test_tmp_dir + "/reader_broken";
+    std::ofstream(src_file) << "def main() {\n    a = [1, 2, 3]\n    println(a[1])\n}\n";
+    test.run("-o-bytecode " + bytecode_file + " " + src_file);
+    std::string bytecode;
+    {
+        std::ifstream in(bytecode_file, std::ios::binary);
+        bytecode.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    auto read = [](const std::string &file) {
+        CVM::BytecodeReader reader(file);
+        reader.readInsts();
+        return reader.program();
+    };
+    auto read_broken = [&](const std::string &content) {
+        std::ofstream(broken_file, std::ios::binary | std::ios::trunc) << content;
+        read(broken_file);
+    };
+    EXPECT_NO_THROW(read(bytecode_file));
+    EXPECT_THROW(read(test.test_tmp_dir + "/missing"), CYX::Error);
+    EXPECT_THROW(read_broken(bytecode.substr(0, 5)), CYX::Error);
+    EXPECT_THROW(read_broken(bytecode.substr(0, bytecode.size() - 3)), CYX::Error);
+    EXPECT_THROW(read_broken(bytecode + "\x01"), CYX::Error);
+    // the command line tool reports it instead of running nothing
+    EXPECT_NE(test.run("-i-bytecode " + test.test_tmp_dir + "/missing").find("can't open bytecode file"),
+              std::string::npos);
+}
+
+TEST(Library, source_file)
+{
+    CYXTest test;
+    EXPECT_THROW(COMPILER::SourceFile(test.test_tmp_dir + "/missing.cyx"), CYX::Error);
+    EXPECT_THROW(COMPILER::SourceFile(test.test_tmp_dir), CYX::Error);
+    // the command line tool names the file instead of failing to verify an empty program
+    auto output = test.run(test.test_tmp_dir + "/missing.cyx");
+    EXPECT_NE(output.find("can't open source file"), std::string::npos);
+    EXPECT_NE(output.find("missing.cyx"), std::string::npos);
+}
+
 TEST(SSA, daffodil_number)
 {
     CYXTest test;
@@ -300,6 +794,98 @@ TEST(SSA, constant_folding2)
     EXPECT_EQ(test.executeBytecode(file), test.readfile(file));
 }
 
+TEST(SSA, pruned_ssa)
+{
+    CYXTest test;
+    const std::string file = "ssa/pruned_ssa";
+    EXPECT_EQ(test.execute(file, "-ssa -pruned-ssa"), test.readfile(file));
+    EXPECT_EQ(test.execute(file, "-ssa -pruned-ssa -constant-folding -constant-propagation -dead-code-elimination"),
+              test.readfile(file));
+    EXPECT_EQ(test.execute("ssa/ssa1", "-ssa -pruned-ssa -constant-folding -constant-propagation"),
+              test.readfile("ssa/ssa1"));
+    EXPECT_EQ(test.executeBytecode(file, "-ssa -pruned-ssa"), test.readfile(file));
+    // `t` is dead at the loop header, without a phi there the first `t` of the loop body is version 1
+    EXPECT_EQ(CYXTest::count(test.execute(file, "-ssa -pruned-ssa -dump-ir"), "t1 = i1 * 2(int)"), 1);
+    EXPECT_EQ(CYXTest::count(test.execute(file, "-ssa -dump-ir"), "t1 = i1 * 2(int)"), 0);
+}
+
+TEST(SSA, sccp)
+{
+    CYXTest test;
+    const std::string file = "ssa/sccp";
+    EXPECT_EQ(test.execute(file, "-ssa -sccp"), test.readfile(file));
+    EXPECT_EQ(test.execute(file, "-ssa -sccp -constant-folding -constant-propagation -dead-code-elimination"),
+              test.readfile(file));
+    EXPECT_EQ(test.execute("ssa/ssa1", "-ssa -sccp -dead-code-elimination"), test.readfile("ssa/ssa1"));
+    EXPECT_EQ(test.executeBytecode(file, "-ssa -sccp"), test.readfile(file));
+    // `x != 1` and `debug == 1` are never true, only the loop condition is left
+    EXPECT_EQ(CYXTest::count(test.execute(file, "-ssa -sccp -dump-vm-inst"), "\nJIF "), 1);
+    EXPECT_EQ(CYXTest::count(test.execute(file, "-ssa -dump-vm-inst"), "\nJIF "), 3);
+}
+
+TEST(SSA, gvn)
+{
+    CYXTest test;
+    const std::string file = "ssa/gvn";
+    EXPECT_EQ(test.execute(file, "-ssa -gvn"), test.readfile(file));
+    EXPECT_EQ(test.execute(file, "-ssa -sccp -gvn -constant-folding -constant-propagation -dead-code-elimination"),
+              test.readfile(file));
+    EXPECT_EQ(test.executeBytecode(file, "-ssa -gvn"), test.readfile(file));
+    // `a * b` is computed once, `b * a` and the ones in the loop reuse it, `(i + 1) * (i + 1)` is left.
+    // the same for `w * h` over the params of `area()`
+    EXPECT_EQ(CYXTest::count(test.execute(file, "-ssa -gvn -dump-vm-inst"), "\nMUL "), 3);
+    EXPECT_EQ(CYXTest::count(test.execute(file, "-ssa -dump-vm-inst"), "\nMUL "), 8);
+}
+
+TEST(SSA, licm)
+{
+    CYXTest test;
+    const std::string file = "ssa/licm";
+    EXPECT_EQ(test.execute(file, "-ssa -licm"), test.readfile(file));
+    EXPECT_EQ(test.execute(file, "-ssa -sccp -gvn -licm -constant-folding -constant-propagation -dead-code-elimination"),
+              test.readfile(file));
+    EXPECT_EQ(test.executeBytecode(file, "-ssa -licm"), test.readfile(file));
+    // `step = k * 4` moves in front of the loop header L2
+    const std::string step = "step1 = k0 * 4(int)";
+    auto hoisted           = test.execute(file, "-ssa -licm -dump-ir");
+    auto kept              = test.execute(file, "-ssa -dump-ir");
+    ASSERT_NE(hoisted.find(step), std::string::npos);
+    ASSERT_NE(kept.find(step), std::string::npos);
+    EXPECT_LT(hoisted.find(step), hoisted.find("@L2 "));
+    EXPECT_GT(kept.find(step), kept.find("@L2 "));
+    // the loop test of `sum` computes `n - 1` with the param `n`, it moves in front of the loop as well
+    const std::string bound = "n0 - 1(int)";
+    auto sum                = hoisted.find("@FUNC_sum");
+    ASSERT_NE(hoisted.find(bound, sum), std::string::npos);
+    EXPECT_LT(hoisted.find(bound, sum), hoisted.find("i1 = i.phi1", sum));
+    EXPECT_GT(kept.find(bound, kept.find("@FUNC_sum")), kept.find("i1 = i.phi1", kept.find("@FUNC_sum")));
+}
+
+TEST(SSA, induction_variable)
+{
+    CYXTest test;
+    const std::string file = "ssa/induction_variable";
+    EXPECT_EQ(test.execute(file, "-ssa -induction-variable"), test.readfile(file));
+    EXPECT_EQ(test.execute(file, "-ssa -sccp -gvn -licm -induction-variable -constant-folding -constant-propagation "
+                                 "-dead-code-elimination -peephole"),
+              test.readfile(file));
+    EXPECT_EQ(test.executeBytecode(file, "-ssa -induction-variable"), test.readfile(file));
+    // the ascending loops skip the bounds checks, `b[k] = 7` stores a constant with STOREAU. `b[k]` with `k--`
+    // still checks them
+    auto unchecked = test.execute(file, "-ssa -induction-variable -dump-vm-inst");
+    EXPECT_EQ(CYXTest::count(unchecked, "\nSTOREXU arr0["), 1);
+    EXPECT_EQ(CYXTest::count(unchecked, "\nLOADXU %2 arr0["), 1);
+    EXPECT_EQ(CYXTest::count(unchecked, "\nSTOREAU b0["), 1);
+    EXPECT_EQ(CYXTest::count(unchecked, "\nLOADX %2 b0["), 1);
+    // `a` is a param, `a[j]` starts from `i + 1`
+    EXPECT_EQ(CYXTest::count(unchecked, "\nLOADXU %2 a0[i1]"), 1);
+    EXPECT_EQ(CYXTest::count(unchecked, "\nLOADXU %1 a0[i1]"), 1);
+    EXPECT_EQ(CYXTest::count(unchecked, "\nLOADXU %2 a0[j2]"), 1);
+    auto checked = test.execute(file, "-ssa -dump-vm-inst");
+    EXPECT_EQ(CYXTest::count(checked, "XU "), 0);
+    EXPECT_EQ(CYXTest::count(checked, "AU "), 0);
+}
+
 int main(int argc, char *argv[])
 {
     testing::InitGoogleTest(&argc, argv);